@@ -13,7 +13,7 @@
 
 	#Cyberalaska
 	CYBERALASKA_DIR="src/cyberalaska"
-	CYBERALASKA="${CYBERALASKA_DIR}/bullcolor.cpp ${CYBERALASKA_DIR}/bullseye_keeper.cpp"
+	CYBERALASKA="${CYBERALASKA_DIR}/bullcolor.cpp ${CYBERALASKA_DIR}/bullseye_keeper.cpp ${CYBERALASKA_DIR}/porthread.cpp"
 
 	#Falconer
 	FALCONER_DIR="src/falconer"
@@ -0,0 +1,93 @@
+#!/bin/bash
+
+#Builds bullseye_benchmark, a headless replay of recorded frames through the
+#	bullseye vision pipeline.  Needs only OpenCV (no GL, camera, or drone).
+#	Example: ./bullseye_benchmark frames/ --truth frames/truth.txt --min-fps 30
+#
+#Also builds socket_benchmark, which counts socket system calls per ardrone
+#	control tick over loopback.  Example: ./socket_benchmark 100000
+#
+#And json_benchmark, which times msl's JSON parsers on 1 KB to 10 MB objects.
+#	Example: ./json_benchmark 10000000
+#
+#And uav_binary_benchmark, which times UAV field/sensor exchanges over loopback,
+#	JSON over HTTP against persistent binary frames.  Example: ./uav_binary_benchmark 10000
+#
+#And serial_packet_benchmark, which times A-packet decoding of rover5 serial
+#	captures (or generated traffic).  Example: ./serial_packet_benchmark 100 rover5.cap
+#
+#And neato_map_benchmark, which times building a 20 m x 20 m occupancy grid
+#	from simulated Neato sweeps, and scan matching against it.  Example: ./neato_map_benchmark 3000
+
+#Compiler
+	COMPILER="g++"
+
+#Sources
+	#Cyberalaska
+	CYBERALASKA_DIR="src/cyberalaska"
+	CYBERALASKA="${CYBERALASKA_DIR}/bullcolor.cpp"
+
+	#Benchmark
+	BENCHMARK="src/bullseye_benchmark.cpp"
+
+	#MSL
+	MSL_DIR="src/msl"
+	MSL="${MSL_DIR}/file_util.cpp ${MSL_DIR}/json.cpp ${MSL_DIR}/string_util.cpp"
+
+	#RasterCV
+	RASTERCV_DIR="src/rasterCV"
+	RASTERCV="${RASTERCV_DIR}/bullseye.cpp"
+
+	#Full Source
+	SRC="${BENCHMARK} ${CYBERALASKA} ${MSL} ${RASTERCV}"
+
+#Libraries
+	#OpenCV
+	OPENCV="-lopencv_core -lopencv_highgui -lopencv_imgproc"
+
+	#Full Libraries
+	LIB="${OPENCV}"
+
+#Binary Name
+	BIN="-o bullseye_benchmark"
+
+#Compiler Flags
+	CFLAGS="-O -Wall -Wno-deprecated-declarations"
+
+#Search Directories
+	DIRS="-I./src -I/usr/local/include -L/usr/local/lib"
+
+#Compile
+${COMPILER} ${SRC} ${LIB} ${BIN} ${CFLAGS} ${DIRS}
+
+#Socket Benchmark
+	SOCKET_SRC="src/socket_benchmark.cpp ${MSL_DIR}/socket.cpp ${MSL_DIR}/string_util.cpp ${MSL_DIR}/time_util.cpp"
+	SOCKET_BIN="-o socket_benchmark"
+
+${COMPILER} ${SOCKET_SRC} -lpthread ${SOCKET_BIN} ${CFLAGS} ${DIRS}
+
+#JSON Benchmark
+	JSON_SRC="src/json_benchmark.cpp ${MSL_DIR}/json.cpp ${MSL_DIR}/string_util.cpp ${MSL_DIR}/time_util.cpp"
+	JSON_BIN="-o json_benchmark"
+
+${COMPILER} ${JSON_SRC} ${JSON_BIN} ${CFLAGS} ${DIRS}
+
+#UAV Binary Benchmark
+	UAV_SRC="src/uav_binary_benchmark.cpp ${CYBERALASKA_DIR}/uav_control_binary.cpp ${CYBERALASKA_DIR}/uav_control_JSON.cpp ${CYBERALASKA_DIR}/porthread.cpp"
+	UAV_SRC="${UAV_SRC} src/osl/socket.cpp src/osl/webserver.cpp src/osl/webservice.cpp"
+	UAV_SRC="${UAV_SRC} ${MSL_DIR}/json.cpp ${MSL_DIR}/socket.cpp ${MSL_DIR}/socket_util.cpp ${MSL_DIR}/string_util.cpp ${MSL_DIR}/time_util.cpp"
+	UAV_BIN="-o uav_binary_benchmark"
+
+${COMPILER} ${UAV_SRC} -lpthread ${UAV_BIN} ${CFLAGS} ${DIRS}
+
+#Serial Packet Benchmark
+	SERIAL_PACKET_SRC="src/serial_packet_benchmark.cpp ${MSL_DIR}/string_util.cpp ${MSL_DIR}/time_util.cpp"
+	SERIAL_PACKET_BIN="-o serial_packet_benchmark"
+
+${COMPILER} ${SERIAL_PACKET_SRC} ${SERIAL_PACKET_BIN} ${CFLAGS} ${DIRS}
+
+#Neato Map Benchmark
+	NEATO_MAP_SRC="src/neato_map_benchmark.cpp ${CYBERALASKA_DIR}/neato_map.cpp ${CYBERALASKA_DIR}/scan_matcher.cpp ${MSL_DIR}/string_util.cpp"
+	NEATO_MAP_BIN="-o neato_map_benchmark"
+
+${COMPILER} ${NEATO_MAP_SRC} ${NEATO_MAP_BIN} ${CFLAGS} ${DIRS}
@@ -0,0 +1,422 @@
+//Bullseye Benchmark Source
+//	Replays recorded frames through the bullseye vision pipeline (the same
+//	full-frame path bullseye_keeper uses) without a camera or display, and
+//	reports per-stage timings, fps, and accuracy against ground truth.
+//
+//	Usage: bullseye_benchmark <frame directory or .mjpeg file> [options]
+//		--truth <file>		Ground truth, one line per annotated frame:
+//						<frame number> <x> <y> [<x> <y> ...]
+//						(frame numbers start at 0, '#' starts a comment)
+//		--tolerance <px>	Pixel distance that counts as a match (default 5)
+//		--repeat <n>		Replay the frame set n times (default 1)
+//		--threads <n>		OpenCV thread count (default: OpenCV's choice)
+//		--min-fps <fps>		Fail if the pipeline is slower than this
+//		--min-recall <r>	Fail if fewer than this fraction of truth eyes are found
+//
+//	Before replaying, also checks both detectors against a synthetic frame
+//	holding two bullseyes close enough to share a pyramid refine window.
+//
+//	Each detection is also searched again in a tracking window, the way
+//	bullseye_keeper's tracking mode does (untimed).  Fails if either detector
+//	allocates after its first frame or window, so replay same-size frames.
+//
+//	Exit status is 0 on success, 1 if a check failed, 2 on bad input.
+
+//Bullseye Headers
+#include <rasterCV/bullseye.h>
+#include <cyberalaska/bullcolor.h>
+#include <cyberalaska/bullseye_keeper.hpp>
+
+//C Standard Headers (framespit.h needs these first)
+#include <cstdio>
+#include <ctime>
+
+//MJPEG Frame Splitter Header
+#include <osl/framespit.h>
+
+//MSL Headers
+#include <msl/file_util.hpp>
+#include <msl/string_util.hpp>
+
+//STL Headers
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//Ground Truth Map (frame number to bullseye pixel centers)
+typedef std::map<int,std::vector<cv::Point2f> > truth_t;
+
+//Frame Source (a directory of still images, or one MJPEG stream)
+class frame_source
+{
+	public:
+		frame_source(const std::string& path):_path(path),_next_file(0),_stream(NULL),_splitter(NULL)
+		{
+			if(msl::ends_with(path,".mjpeg")||msl::ends_with(path,".mjpg"))
+			{
+				_stream=new std::ifstream(path.c_str(),std::ios_base::binary);
+				_splitter=new frame_splitter(*_stream);
+			}
+			else
+			{
+				_files=msl::list_directory_files(path);
+				std::sort(_files.begin(),_files.end());
+			}
+		}
+
+		~frame_source()
+		{
+			delete _splitter;
+			delete _stream;
+		}
+
+		bool good() const
+		{
+			if(_stream!=NULL)
+				return _stream->good();
+
+			return _files.size()>0;
+		}
+
+		//Decode the next frame into frame, returns false at the end.
+		bool next(cv::Mat& frame)
+		{
+			if(_splitter!=NULL)
+			{
+				_splitter->next_frame(_jpeg);
+
+				if(_jpeg.size()==0)
+					return false;
+
+				frame=cv::imdecode(_jpeg,1);
+				return !frame.empty();
+			}
+
+			while(_next_file<_files.size())
+			{
+				frame=cv::imread(_path+"/"+_files[_next_file++]);
+
+				//Skip anything that isn't an image
+				if(!frame.empty())
+					return true;
+			}
+
+			return false;
+		}
+
+	private:
+		std::string _path;
+		std::vector<std::string> _files;
+		unsigned int _next_file;
+		std::ifstream* _stream;
+		frame_splitter* _splitter;
+		std::vector<unsigned char> _jpeg;
+};
+
+//Read Ground Truth File (returns false on error)
+bool read_truth(const std::string& filename,truth_t& truth)
+{
+	std::ifstream file(filename.c_str());
+
+	if(!file)
+		return false;
+
+	std::string line;
+
+	while(std::getline(file,line))
+	{
+		line=line.substr(0,line.find('#'));
+		std::istringstream fields(line);
+		int frame;
+
+		if(!(fields>>frame))
+			continue;
+
+		std::vector<cv::Point2f>& eyes=truth[frame];
+		float x;
+		float y;
+
+		while(fields>>x>>y)
+			eyes.push_back(cv::Point2f(x,y));
+	}
+
+	return true;
+}
+
+//Count Matches Function (Truth eyes with a detection within tolerance, each detection used once)
+static unsigned int count_matches(const std::vector<cv::Point2f>& eyes,const bullseyeList& bulls,const double tolerance)
+{
+	std::vector<bool> used(bulls.eyes.size(),false);
+	unsigned int matched=0;
+
+	for(unsigned int ii=0;ii<eyes.size();++ii)
+	{
+		for(unsigned int jj=0;jj<bulls.eyes.size();++jj)
+		{
+			double dx=bulls.eyes[jj].x-eyes[ii].x;
+			double dy=bulls.eyes[jj].y-eyes[ii].y;
+
+			if(!used[jj]&&dx*dx+dy*dy<=tolerance*tolerance)
+			{
+				used[jj]=true;
+				++matched;
+				break;
+			}
+		}
+	}
+
+	return matched;
+}
+
+//Nearby Eyes Check (A strong and a weak bullseye 35 pixels apart, which is
+//	inside one pyramid refine window, must both be found, once each)
+static bool check_nearby_eyes(const double tolerance)
+{
+	cv::Mat gray(240,320,CV_8UC1,cv::Scalar(255));
+	std::vector<cv::Point2f> eyes;
+	eyes.push_back(cv::Point2f(140,120));
+	eyes.push_back(cv::Point2f(175,120));
+
+	cv::circle(gray,cv::Point(140,120),4,cv::Scalar(0),-1);
+	cv::circle(gray,cv::Point(140,120),10,cv::Scalar(0),4);
+	cv::circle(gray,cv::Point(140,120),17,cv::Scalar(0),4);
+	cv::circle(gray,cv::Point(175,120),3,cv::Scalar(0),-1);
+	cv::circle(gray,cv::Point(175,120),8,cv::Scalar(0),3);
+
+	bullseyeList full=findBullseyes(gray);
+	bullseyeList pyramid=findBullseyesPyramid(gray);
+	unsigned int full_matched=count_matches(eyes,full,tolerance);
+	unsigned int pyramid_matched=count_matches(eyes,pyramid,tolerance);
+
+	std::cout<<"Nearby eyes: "<<full_matched<<" of "<<eyes.size()<<" found full frame ("<<full.eyes.size()
+		<<" detections), "<<pyramid_matched<<" of "<<eyes.size()<<" by pyramid ("<<pyramid.eyes.size()
+		<<" detections)"<<std::endl;
+
+	return full_matched==eyes.size()&&pyramid_matched==eyes.size()&&pyramid.eyes.size()==eyes.size();
+}
+
+//Per-stage totals, in seconds
+struct stage_times_t
+{
+	double cvtcolor;
+	double sobel;
+	double vote;
+	double peaks;
+	double bullcolor;
+};
+
+//Seconds Since an Arbitrary Start Time
+static double seconds()
+{
+	return cv::getTickCount()/cv::getTickFrequency();
+}
+
+//Print One Stage's Average
+static void print_stage(const std::string& name,const double total,const unsigned int frames)
+{
+	std::cout<<"\t"<<name<<"\t"<<total*1000.0/frames<<" ms/frame"<<std::endl;
+}
+
+//Main
+int main(int argc,char* argv[])
+{
+	if(argc<2)
+	{
+		std::cout<<"Usage: "<<argv[0]<<" <frame directory or .mjpeg file> [--truth file] [--tolerance px]"
+			" [--repeat n] [--threads n] [--min-fps fps] [--min-recall r]"<<std::endl;
+		return 2;
+	}
+
+	//Parse Command Line Arguments
+	std::string path=argv[1];
+	std::string truth_file="";
+	double tolerance=5;
+	int repeat=1;
+	double min_fps=0;
+	double min_recall=0;
+
+	for(int ii=2;ii<argc;++ii)
+	{
+		std::string arg=argv[ii];
+
+		if(ii+1>=argc)
+		{
+			std::cout<<"Missing value for "<<arg<<"!"<<std::endl;
+			return 2;
+		}
+
+		std::string value=argv[++ii];
+
+		if(arg=="--truth")
+			truth_file=value;
+		else if(arg=="--tolerance")
+			tolerance=msl::to_double(value);
+		else if(arg=="--repeat")
+			repeat=msl::to_int(value);
+		else if(arg=="--threads")
+			cv::setNumThreads(msl::to_int(value));
+		else if(arg=="--min-fps")
+			min_fps=msl::to_double(value);
+		else if(arg=="--min-recall")
+			min_recall=msl::to_double(value);
+		else
+		{
+			std::cout<<"Unrecognized command line argument "<<arg<<"!"<<std::endl;
+			return 2;
+		}
+	}
+
+	truth_t truth;
+
+	if(truth_file!=""&&!read_truth(truth_file,truth))
+	{
+		std::cout<<"Could not read ground truth file "<<truth_file<<"!"<<std::endl;
+		return 2;
+	}
+
+	bool passed=check_nearby_eyes(tolerance);
+
+	if(!passed)
+		std::cout<<"FAIL: nearby eyes were lost or found twice"<<std::endl;
+
+	//Replay Frames
+	bullseyeDetector detector;
+	bullseyeDetector track_detector;
+	cv::Mat frame;
+	cv::Mat gray;
+	cv::Mat track_gray;
+	unsigned long warm_allocations=0;
+	unsigned long warm_track_allocations=0;
+	unsigned int windows=0;
+	stage_times_t times={0,0,0,0,0};
+	unsigned int frames=0;
+	unsigned int detections=0;
+	unsigned int truth_eyes=0;
+	unsigned int matched=0;
+
+	for(int pass=0;pass<repeat;++pass)
+	{
+		frame_source source(path);
+
+		if(!source.good())
+		{
+			std::cout<<"Could not open frames in "<<path<<"!"<<std::endl;
+			return 2;
+		}
+
+		for(int frame_number=0;source.next(frame);++frame_number)
+		{
+			double start=seconds();
+			cv::cvtColor(frame,gray,CV_BGR2GRAY);
+			double converted=seconds();
+
+			const bullseyeList& bulls=detector.find(gray);
+			double found=seconds();
+
+			for(unsigned int ii=0;ii<bulls.eyes.size();++ii)
+				bullcolor bc(bulls.eyes[ii],frame);
+
+			double colored=seconds();
+
+			times.cvtcolor+=converted-start;
+			times.sobel+=detector.timing().sobelSeconds;
+			times.vote+=detector.timing().voteSeconds;
+			times.peaks+=detector.timing().peakSeconds;
+			times.bullcolor+=colored-found;
+			++frames;
+			detections+=bulls.eyes.size();
+
+			if(frames==1)
+				warm_allocations=detector.allocations();
+
+			//Search a Tracking Window Around Each Eye (Fixed size, like bullseye_keeper's)
+			for(unsigned int ii=0;ii<bulls.eyes.size();++ii)
+			{
+				cv::Rect window=bullseyeWindow(bulls.eyes[ii].x,bulls.eyes[ii].y,
+					bullseye_keeper::track_window_size,frame.size());
+
+				if(window.area()==0)
+					continue;
+
+				cv::cvtColor(frame(window),track_gray,CV_BGR2GRAY);
+				track_detector.find(track_gray);
+
+				if(++windows==1)
+					warm_track_allocations=track_detector.allocations();
+			}
+
+			//Score against ground truth (each detection can match one truth eye)
+			truth_t::const_iterator annotated=truth.find(frame_number);
+
+			if(annotated!=truth.end())
+			{
+				truth_eyes+=annotated->second.size();
+				matched+=count_matches(annotated->second,bulls,tolerance);
+			}
+		}
+	}
+
+	if(frames==0)
+	{
+		std::cout<<"No frames found in "<<path<<"!"<<std::endl;
+		return 2;
+	}
+
+	//Report
+	double total=times.cvtcolor+times.sobel+times.vote+times.peaks+times.bullcolor;
+	double fps=frames/total;
+
+	std::cout<<"Frames: "<<frames<<std::endl;
+	print_stage("cvtColor",times.cvtcolor,frames);
+	print_stage("Sobel",times.sobel,frames);
+	print_stage("vote",times.vote,frames);
+	print_stage("NMS",times.peaks,frames);
+	print_stage("bullcolor",times.bullcolor,frames);
+	print_stage("total",total,frames);
+	std::cout<<"FPS: "<<fps<<std::endl;
+	std::cout<<"Detections: "<<detections<<" ("<<detections/(double)frames<<" per frame)"<<std::endl;
+	std::cout<<"Detector allocations: "<<detector.allocations()<<" ("<<warm_allocations<<" on the first frame)"<<std::endl;
+	std::cout<<"Tracking windows: "<<windows<<", allocations: "<<track_detector.allocations()
+		<<" ("<<warm_track_allocations<<" on the first window)"<<std::endl;
+
+	if(detector.allocations()!=warm_allocations)
+	{
+		std::cout<<"FAIL: detector allocated after warming up"<<std::endl;
+		passed=false;
+	}
+
+	if(track_detector.allocations()!=warm_track_allocations)
+	{
+		std::cout<<"FAIL: tracking detector allocated after warming up"<<std::endl;
+		passed=false;
+	}
+
+	if(truth_eyes>0)
+	{
+		double recall=matched/(double)truth_eyes;
+		std::cout<<"Ground truth: "<<matched<<" of "<<truth_eyes<<" found (recall "<<recall<<")"<<std::endl;
+
+		if(recall<min_recall)
+		{
+			std::cout<<"FAIL: recall below "<<min_recall<<std::endl;
+			passed=false;
+		}
+	}
+	else if(min_recall>0)
+	{
+		std::cout<<"FAIL: --min-recall needs annotated frames"<<std::endl;
+		passed=false;
+	}
+
+	if(fps<min_fps)
+	{
+		std::cout<<"FAIL: fps below "<<min_fps<<std::endl;
+		passed=false;
+	}
+
+	return passed?0:1;
+}
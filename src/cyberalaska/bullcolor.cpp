@@ -12,22 +12,33 @@ bullcolor::bullcolor(const bullseyeInfo &bi,cv::Mat &rgbImage)
 	colorbox &= cv::Rect(0,0,rgbImage.cols,rgbImage.rows); // clip to image dimensions
 	cv::Mat colorimg=rgbImage(colorbox);
 
-	// Extract the three channels
+	// Calculate per-channel raw moments straight from the interleaved BGR
+	//   pixels, instead of splitting out channel images for cv::moments.
+	//   Every sum is an exact integer, so this gives the same values as cv::moments.
 	enum {nchan=3}; // number of color channels to convert (B,G,R)
-	cv::Mat channels[nchan];
-	for (int c=0;c<nchan;c++) {
-		channels[c]=cv::Mat(colorimg.rows,colorimg.cols,CV_8U);
+	double m00[nchan]={0,0,0}, m10[nchan]={0,0,0}, m01[nchan]={0,0,0};
+	for (int y=0;y<colorimg.rows;y++) {
+		const unsigned char *row=colorimg.ptr(y);
+		int sum[nchan]={0,0,0}; // this row's moments
+		double xsum[nchan]={0,0,0};
+		for (int x=0;x<colorimg.cols;x++)
+		for (int c=0;c<nchan;c++) {
+			int v=row[x*nchan+c];
+			sum[c]+=v;
+			xsum[c]+=x*v;
+		}
+		for (int c=0;c<nchan;c++) {
+			m00[c]+=sum[c];
+			m10[c]+=xsum[c];
+			m01[c]+=y*(double)sum[c];
+		}
 	}
-	int fromTo[2*nchan]={0,0,1,1,2,2};
-	cv::mixChannels(&colorimg,1,channels,nchan,fromTo,nchan);
 
 	// Calculate centers of mass
-	cv::Moments moments[nchan]; // per-channel moments
 	cv::Point_<float> com[nchan]; // center of mass
 	for (int c=0;c<nchan;c++) {
-		moments[c]=cv::moments(channels[c]);
-		com[c]=cv::Point_<float>(moments[c].m00/moments[c].m10,moments[c].m00/moments[c].m01);
-		color[c]=moments[c].m00/(colorbox.width*colorbox.height);
+		com[c]=cv::Point_<float>(m00[c]/m10[c],m00[c]/m01[c]);
+		color[c]=m00[c]/(colorbox.width*colorbox.height);
 	}
 	color[3]=0.0; // alpha?
 
@@ -10,15 +10,14 @@ Dr. Orion Sky Lawlor, lawlor@alaska.edu, 2013-11-06 (Public Domain)
 
 
 #include "../cyberalaska/porthread.h"
+#include "../cyberalaska/latest_slot.h"
 
 
 class bullseye_camera_backend : public bullseye_camera {
 	cv::VideoCapture *cap;
 
-	/// This lock protects results against multithreaded changes during reads.
-	///   You MUST grab this lock before reading or writing results.
-	porlock results_lock;
-	std::vector<bullcolor> results;
+	/// Newest results, handed from our camera thread to readers.
+	cyberalaska::latest_slot<std::vector<bullcolor> > latest;
 
 	// Dr. Lawlor expects that storing these images out here will improve performance (measure?)
 	cv::Mat frame; ///< Last captured video frame
@@ -47,7 +46,8 @@ public:
 	*/
 	virtual std::vector<bullcolor> extract()
 	{
-		porlock_scoped guard(&results_lock);
+		std::vector<bullcolor> results;
+		latest.peek(results);
 		return results;
 	}
 
@@ -73,10 +73,7 @@ public:
 		}
 
 	// MULTITHREAD: publish results for other threads
-		{
-			porlock_scoped guard(&results_lock);
-			this->results=results;
-		}
+		latest.put(results,capture_time);
 
 	// Mark our new results
 		update_timestamp(capture_time);
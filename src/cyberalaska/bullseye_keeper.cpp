@@ -9,7 +9,9 @@ Orion Lawlor & Mike Moss, 2014-04 (Public Domain)
 #include "cyberalaska/bullcolor.h"
 
 bullseye_keeper::bullseye_keeper(const int camera,const int width,const int height):
-	camsize(width,height), _cap(camera),_width(width),_height(height)
+	camsize(width,height), _cap(camera),_width(width),_height(height),
+	_tracking(false),_keyframe_interval(30),_frames_since_keyframe(0),
+	_full_frames(0),_tracked_frames(0),_running(false)
 {
 	_cap.set(CV_CAP_PROP_FRAME_WIDTH,_width);
 	_cap.set(CV_CAP_PROP_FRAME_HEIGHT,_height);
@@ -33,6 +35,22 @@ bullseye_keeper::bullseye_keeper(const int camera,const int width,const int heig
 
 	camcoords=cyberalaska::coords(offset,view); // 0,0 in bottom left corner
 
+	if(good())
+	{
+		_running=true;
+		_capture_thread=porthread_create(capture_thread,this);
+		_detect_thread=porthread_create(detect_thread,this);
+	}
+}
+
+bullseye_keeper::~bullseye_keeper()
+{
+	if(_running)
+	{
+		_running=false;
+		porthread_wait(_capture_thread);
+		porthread_wait(_detect_thread);
+	}
 }
 
 bullseye_keeper::operator bool() const
@@ -50,40 +68,211 @@ bool bullseye_keeper::good() const
 	return _cap.isOpened();
 }
 
-std::vector<vec3> bullseye_keeper::update()
+void bullseye_keeper::set_tracking(const bool enable,const int keyframe_interval)
 {
-	static int frame_rate=0;
-	std::vector<vec3> locations;
+	porlock_scoped guard(&_tracking_lock);
+	_tracking=enable;
+	_keyframe_interval=keyframe_interval;
+	_tracks.clear();
+}
 
-	cv::Mat frame;
+bool bullseye_keeper::tracking() const
+{
+	return _tracking;
+}
 
-	_cap>>frame;
+double bullseye_keeper::frame_age() const
+{
+	return _locations.age();
+}
 
-	if(!frame.empty())
+unsigned long bullseye_keeper::captured_frames() const
+{
+	return _frames.puts();
+}
+
+unsigned long bullseye_keeper::dropped_frames() const
+{
+	return _frames.drops();
+}
+
+unsigned long bullseye_keeper::allocations() const
+{
+	return _detector.allocations()+_track_detector.allocations();
+}
+
+unsigned int bullseye_keeper::full_frames() const
+{
+	return _full_frames;
+}
+
+unsigned int bullseye_keeper::tracked_frames() const
+{
+	return _tracked_frames;
+}
+
+//Search only the predicted windows around our tracked bullseyes, into _bulls.
+//  Returns false if a full-frame search is needed.
+bool bullseye_keeper::track_bullseyes(const cv::Mat& frame)
+{
+	if(!_tracking||_tracks.size()==0||_frames_since_keyframe>=_keyframe_interval)
+		return false;
+
+	std::vector<bullseyeInfo>& found=_bulls.eyes;
+	found.clear();
+
+	for(unsigned int ii=0;ii<_tracks.size();++ii)
 	{
-		++frame_rate;
+		//Constant-velocity prediction of where this bullseye is now
+		double px=_tracks[ii].x+_tracks[ii].vx;
+		double py=_tracks[ii].y+_tracks[ii].vy;
 
-		//if(frame_rate%2)
+		//Always the same size, so _track_gray and _track_detector never reallocate
+		cv::Rect window=bullseyeWindow(px,py,track_window_size,frame.size());
+
+		if(window.area()==0)
+			return false;
+
+		cv::cvtColor(frame(window),_track_gray,CV_BGR2GRAY);
+		const bullseyeList& near=_track_detector.find(_track_gray);
+
+		//Lost it, fall back to the full frame
+		if(near.eyes.size()==0)
+			return false;
+
+		for(unsigned int jj=0;jj<near.eyes.size();++jj)
 		{
-			cv::Mat gray;
-			cv::cvtColor(frame,gray,CV_BGR2GRAY);
+			bullseyeInfo eye=near.eyes[jj];
+			eye.x+=window.x;
+			eye.y+=window.y;
 
-			bullseyeList bulls=findBullseyes(gray);
+			//Windows can overlap, so skip bullseyes another window already found
+			bool duplicate=false;
 
-			locations.clear();
+			for(unsigned int kk=0;kk<found.size()&&!duplicate;++kk)
+				duplicate=fabs(found[kk].x-eye.x)<1.0&&fabs(found[kk].y-eye.y)<1.0;
 
-			for(unsigned int ii=0;ii<bulls.eyes.size();++ii)
-			{
-				bullcolor bc(bulls.eyes[ii],frame);
+			if(!duplicate)
+				found.push_back(eye);
+		}
+	}
+
+	std::sort(found.begin(),found.end());
+	return true;
+}
+
+//Match this frame's bullseyes to last frame's tracks (nearest neighbor),
+//  estimating each one's per-frame pixel velocity.
+void bullseye_keeper::update_tracks(const bullseyeList& bulls)
+{
+	std::vector<track_t>& tracks=_new_tracks;
+	tracks.clear();
+
+	for(unsigned int ii=0;ii<bulls.eyes.size();++ii)
+	{
+		track_t track;
+		track.x=bulls.eyes[ii].x;
+		track.y=bulls.eyes[ii].y;
+		track.vx=0;
+		track.vy=0;
 
-				//double x=bulls.eyes[ii].x-_width/2.0;
-				//double y=bulls.eyes[ii].y-_height/2.0;
-				vec3 xyz=camcoords.world_from_pixel(vec3(bulls.eyes[ii].x,bulls.eyes[ii].y,0.0),camsize);
-				xyz.z=-bc.angle*M_PI/180.0; // angle in radians (Y is flipped)
+		double best=track_motion_pixels*track_motion_pixels;
 
-				locations.push_back(xyz);
+		for(unsigned int jj=0;jj<_tracks.size();++jj)
+		{
+			double dx=track.x-_tracks[jj].x;
+			double dy=track.y-_tracks[jj].y;
+
+			if(dx*dx+dy*dy<best)
+			{
+				best=dx*dx+dy*dy;
+				track.vx=dx;
+				track.vy=dy;
 			}
 		}
+
+		tracks.push_back(track);
+	}
+
+	_tracks.swap(tracks);
+}
+
+//Camera thread: grab frames as fast as the camera delivers them.
+void bullseye_keeper::capture_thread(void* keeper)
+{
+	bullseye_keeper* self=(bullseye_keeper*)keeper;
+
+	cv::Mat frame; // swapped with the detector's old frames, so never reallocated
+
+	while(self->_running)
+	{
+		if(self->_cap.read(frame)&&!frame.empty())
+			self->_frames.put_swap(frame,cyberalaska::time());
+		else
+			porthread_yield(10);
+	}
+}
+
+//Detection thread: always work on the newest frame, skipping any that
+//  arrived while we were busy.
+void bullseye_keeper::detect_thread(void* keeper)
+{
+	bullseye_keeper* self=(bullseye_keeper*)keeper;
+	cv::Mat frame;
+	double capture_time;
+
+	while(self->_running)
+	{
+		if(self->_frames.take_swap(frame,&capture_time))
+			self->_locations.put(self->detect(frame),capture_time);
+		else
+			porthread_yield(1);
+	}
+}
+
+std::vector<vec3> bullseye_keeper::update()
+{
+	std::vector<vec3> locations;
+	_locations.peek(locations);
+	return locations;
+}
+
+//Find the bullseyes in this frame.  Everything here works in our member
+//  buffers, so once warmed up this doesn't touch the heap.
+const std::vector<vec3>& bullseye_keeper::detect(cv::Mat& frame)
+{
+	std::vector<vec3>& locations=_detected;
+	const bullseyeList& bulls=_bulls;
+	porlock_scoped guard(&_tracking_lock);
+	locations.clear();
+
+	if(track_bullseyes(frame))
+	{
+		++_frames_since_keyframe;
+		++_tracked_frames;
+	}
+	else
+	{
+		cv::cvtColor(frame,_gray,CV_BGR2GRAY);
+
+		_bulls.eyes=_detector.find(_gray).eyes;
+		_frames_since_keyframe=0;
+		++_full_frames;
+	}
+
+	if(_tracking)
+		update_tracks(bulls);
+
+	for(unsigned int ii=0;ii<bulls.eyes.size();++ii)
+	{
+		bullcolor bc(bulls.eyes[ii],frame);
+
+		//double x=bulls.eyes[ii].x-_width/2.0;
+		//double y=bulls.eyes[ii].y-_height/2.0;
+		vec3 xyz=camcoords.world_from_pixel(vec3(bulls.eyes[ii].x,bulls.eyes[ii].y,0.0),camsize);
+		xyz.z=-bc.angle*M_PI/180.0; // angle in radians (Y is flipped)
+
+		locations.push_back(xyz);
 	}
 
 	return locations;
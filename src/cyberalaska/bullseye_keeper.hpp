@@ -15,23 +15,98 @@ using cyberalaska::vec3;
 #include <algorithm>
 #include "osl/vec2.h"
 #include "cyberalaska/coords.h" /* for scaling to real world coordinates */
+#include "rasterCV/bullseye.h"
+#include "cyberalaska/latest_slot.h"
 
 class bullseye_keeper
 {
 	public:
 		bullseye_keeper(const int camera,const int width=640,const int height=480);
+		~bullseye_keeper();
 		operator bool() const;
 		bool operator!() const;
 		bool good() const;
 
+		//Returns the newest detected locations without blocking: capture and
+		//  detection each run on their own thread, and this just reads the
+		//  last finished result.
 		std::vector<vec3> update();
 
+		//Seconds since the camera captured the frame behind update()'s result.
+		double frame_age() const;
+
+		//Frames captured, and frames skipped because a newer one arrived
+		//  before the detector got to them.
+		unsigned long captured_frames() const;
+		unsigned long dropped_frames() const;
+
+		//Tracking mode: between keyframes, only search small windows around
+		//  where the last frame's bullseyes are predicted to be.  A full-frame
+		//  search runs every keyframe_interval frames, or whenever a tracked
+		//  bullseye goes missing from its window.
+		void set_tracking(const bool enable,const int keyframe_interval=30);
+		bool tracking() const;
+
+		//Number of full-frame searches and windowed (tracked) frames so far.
+		unsigned int full_frames() const;
+		unsigned int tracked_frames() const;
+
+		//Number of times the detectors had to allocate a scratch buffer.
+		//  Stops climbing once both have warmed up: the full-frame one on its
+		//  first frame, the tracking one on its first window.
+		unsigned long allocations() const;
+
+		//Tracking windows are track_window_size pixels square, slid to fit
+		//  inside the frame: the vote lines reach 20 pixels (findBullseyes'
+		//  gradientVotePixels) from the eye's edges, plus room for the eye to
+		//  move past our prediction.
+		enum {track_motion_pixels=16,track_window_size=2*(2*20+track_motion_pixels)};
+
 	private:
+		//A bullseye being tracked from frame to frame (pixel coordinates).
+		struct track_t
+		{
+			double x;
+			double y;
+			double vx;
+			double vy;
+		};
+
+		static void capture_thread(void* keeper);
+		static void detect_thread(void* keeper);
+		const std::vector<vec3>& detect(cv::Mat& frame);
+		bool track_bullseyes(const cv::Mat& frame);
+		void update_tracks(const bullseyeList& bulls);
+
 		cyberalaska::coords camcoords; // convert pixels to centimeters
 		cyberalaska::image_size camsize;
 		cv::VideoCapture _cap;
 		int _width;
 		int _height;
+
+		bool _tracking;
+		int _keyframe_interval;
+		int _frames_since_keyframe;
+		std::vector<track_t> _tracks;
+		std::vector<track_t> _new_tracks;
+		unsigned int _full_frames;
+		unsigned int _tracked_frames;
+		porlock _tracking_lock;
+
+		//Detection thread's scratch space, reused every frame.  Windows get
+		//  their own detector, so neither one's buffers change shape.
+		bullseyeDetector _detector;
+		cv::Mat _gray;
+		bullseyeDetector _track_detector;
+		cv::Mat _track_gray;
+		bullseyeList _bulls;
+		std::vector<vec3> _detected;
+
+		volatile bool _running;
+		porthread_t _capture_thread;
+		porthread_t _detect_thread;
+		cyberalaska::latest_slot<cv::Mat> _frames;
+		cyberalaska::latest_slot<std::vector<vec3> > _locations;
 };
 
 #endif
@@ -1,15 +1,27 @@
 #include "graph.hpp"
 
-graph::graph(const unsigned int size,const float default_value):_size(size)
-{
-	for(unsigned int ii=0;ii<_size;++ii)
-		_data.push_back(default_value);
-}
+//Algorithm Header
+#include <algorithm>
+
+//OpenGL Headers
+#ifndef __APPLE__
+	#include <GL/glew.h>
+	#include <GL/glut.h>
+#else
+	#include <GLEW/glew.h>
+	#include <GLUT/glut.h>
+#endif
+
+graph::graph(const unsigned int size,const float default_value):_data(size,default_value),_size(size),_newest(0)
+{}
 
 void graph::add(const float& element)
 {
-	_data.insert(_data.begin(),element);
-	_data.resize(_size);
+	if(_size==0)
+		return;
+
+	_newest=(_newest+_size-1)%_size;
+	_data[_newest]=element;
 }
 
 unsigned int graph::size() const
@@ -17,8 +29,69 @@ unsigned int graph::size() const
 	return _size;
 }
 
-void graph::draw(const double x,const double y,const msl::color& line_color) const
+float graph::get(const unsigned int index) const
+{
+	unsigned int ring=_newest+index;
+
+	if(ring>=_size)
+		ring-=_size;
+
+	return _data[ring];
+}
+
+void graph::draw(const double x,const double y,const msl::color& line_color,const unsigned int width) const
 {
-	for(unsigned int ii=0;ii<_data.size()-1;++ii)
-		msl::draw_line(x+ii,y+_data[ii],x+ii+1,y+_data[ii+1],line_color);
+	if(_size<2)
+		return;
+
+	_vertices.clear();
+
+	//One Vertex per Sample
+	if(width==0||width>=_size)
+	{
+		for(unsigned int ii=0;ii<_size;++ii)
+		{
+			_vertices.push_back(x+ii);
+			_vertices.push_back(y+get(ii));
+		}
+	}
+
+	//Min and Max per Pixel Column
+	else
+	{
+		unsigned int index=0;
+
+		for(unsigned int column=0;column<width;++column)
+		{
+			unsigned int end=(unsigned int)((unsigned long long)(column+1)*_size/width);
+			float low=get(index);
+			float high=low;
+
+			for(++index;index<end;++index)
+			{
+				float value=get(index);
+				low=std::min(low,value);
+				high=std::max(high,value);
+			}
+
+			_vertices.push_back(x+column);
+			_vertices.push_back(y+low);
+			_vertices.push_back(x+column);
+			_vertices.push_back(y+high);
+		}
+	}
+
+	//Enable Transparency
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+
+	//Draw Line Strip
+	glColor4d(line_color.r,line_color.g,line_color.b,line_color.a);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2,GL_FLOAT,0,&_vertices[0]);
+	glDrawArrays(GL_LINE_STRIP,0,_vertices.size()/2);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	//Disable Transparency
+	glDisable(GL_BLEND);
 }
\ No newline at end of file
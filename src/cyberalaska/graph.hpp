@@ -1,3 +1,7 @@
+//Graph Header
+//	Scrolling line graph of the newest samples, kept in a fixed-size ring
+//	buffer so adding a sample is constant time.
+
 #ifndef GRAPH_HPP
 #define GRAPH_HPP
 
@@ -7,14 +11,28 @@
 class graph
 {
 	public:
+		//Constructor (Holds size samples, all starting at default_value)
 		graph(const unsigned int size,const float default_value=0.0);
+
+		//Add Function (Newest sample, drops the oldest)
 		void add(const float& element);
+
+		//Size Function (Number of samples held)
 		unsigned int size() const;
-		void draw(const double x,const double y,const msl::color& line_color) const;
 
-	//private:
+		//Get Function (Sample index, 0 is the newest)
+		float get(const unsigned int index) const;
+
+		//Draw Function (Newest sample at x, older samples to the right, one pixel each)
+		//	If width is less than size, each pixel column draws the min and max of
+		//	the samples that fall in it, so spikes still show.  Draws in one call.
+		void draw(const double x,const double y,const msl::color& line_color,const unsigned int width=0) const;
+
+	private:
 		std::vector<float> _data;
 		unsigned int _size;
+		unsigned int _newest;
+		mutable std::vector<float> _vertices;
 };
 
 #endif
\ No newline at end of file
@@ -93,10 +93,17 @@ void hindenburg::update()
 	std::string packet=serial_pack_maneuver(flags,pitch,roll,throttle_send,yaw);
 	serial.write(packet.c_str(),packet.size());
 
-	uint8_t b;
+	//Newest altitude byte wins
+	while(serial.fill()>0)
+	{
+		const uint8_t* bytes;
+		unsigned int size=serial.peek(bytes);
+
+		if(size>0)
+			altitude=bytes[size-1];
 
-	while(serial.available()>0&&serial.read(&b,1)==1)
-		altitude=b;
+		serial.consume(size);
+	}
 
 	if(altitude>altitude_limit)
 		altitude=altitude_limit;
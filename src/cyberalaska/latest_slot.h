@@ -0,0 +1,112 @@
+/**
+Single-slot "latest value" handoff between threads: the producer never
+waits, and consumers always see the newest value.
+
+Public Domain
+*/
+#ifndef __CYBERALASKA_LATEST_SLOT_H
+#define __CYBERALASKA_LATEST_SLOT_H
+
+#include "../cyberalaska/porthread.h"
+#include "../cyberalaska/time.h"
+#include <algorithm> /* for std::swap */
+
+namespace cyberalaska {
+
+/**
+ Holds the most recent T put by a producer thread.
+ A put that replaces a value nobody has taken yet counts as a drop,
+ so a slow consumer shows up as a climbing drops() count rather than
+ as a growing backlog of stale frames.
+
+ T is copied under a lock, so it should be cheap to copy
+ (e.g., a reference-counted cv::Mat, or a short std::vector).
+*/
+template <class T>
+class latest_slot {
+	mutable porlock lock; ///< protects everything below
+	T value;
+	bool fresh; ///< value has not been taken yet
+	double stamp; ///< cyberalaska::time() of value's capture
+	unsigned long sequence; ///< number of puts so far
+	unsigned long dropped; ///< puts overwritten before anybody took them
+public:
+	latest_slot() :fresh(false), stamp(0.0), sequence(0), dropped(0) {}
+
+	/** Replace the current value, captured at this cyberalaska::time(). */
+	void put(const T &v,double time_stamp) {
+		porlock_scoped guard(&lock);
+		if (fresh) dropped++;
+		value=v;
+		fresh=true;
+		stamp=time_stamp;
+		sequence++;
+	}
+
+	/** Take the value if it's new since the last take.
+	  Returns false (and leaves v alone) if there's nothing new. */
+	bool take(T &v,double *time_stamp=0) {
+		porlock_scoped guard(&lock);
+		if (!fresh) return false;
+		v=value;
+		fresh=false;
+		if (time_stamp) *time_stamp=stamp;
+		return true;
+	}
+
+	/** Like put, but swaps v with the slot's old value instead of copying.
+	  v comes back holding either an unread (dropped) value, or whatever
+	  the consumer swapped in with take_swap.  Passing big buffers back and
+	  forth like this lets producer and consumer reuse them forever. */
+	void put_swap(T &v,double time_stamp) {
+		porlock_scoped guard(&lock);
+		if (fresh) dropped++;
+		std::swap(value,v);
+		fresh=true;
+		stamp=time_stamp;
+		sequence++;
+	}
+
+	/** Like take, but swaps v into the slot instead of copying out,
+	  handing v's old contents back to the producer for reuse. */
+	bool take_swap(T &v,double *time_stamp=0) {
+		porlock_scoped guard(&lock);
+		if (!fresh) return false;
+		std::swap(value,v);
+		fresh=false;
+		if (time_stamp) *time_stamp=stamp;
+		return true;
+	}
+
+	/** Copy out the newest value, new or not.
+	  Returns false if nothing has ever been put. */
+	bool peek(T &v,double *time_stamp=0) const {
+		porlock_scoped guard(&lock);
+		if (sequence==0) return false;
+		v=value;
+		if (time_stamp) *time_stamp=stamp;
+		return true;
+	}
+
+	/** Seconds since the newest value was captured. */
+	double age() const {
+		porlock_scoped guard(&lock);
+		return cyberalaska::time()-stamp;
+	}
+
+	/** Number of values ever put. */
+	unsigned long puts() const {
+		porlock_scoped guard(&lock);
+		return sequence;
+	}
+
+	/** Number of values overwritten before anybody took them. */
+	unsigned long drops() const {
+		porlock_scoped guard(&lock);
+		return dropped;
+	}
+};
+
+};
+
+#endif
@@ -0,0 +1,159 @@
+/**
+Turns Neato laser sweeps into world geometry: a point per direction in
+world coordinates, and a log-odds occupancy grid built up from those points.
+
+Public Domain
+*/
+#include "../cyberalaska/neato_map.h"
+#include <math.h>
+#include <string.h> /* for memset */
+
+#if defined(__SSE__)
+#include <xmmintrin.h> /* 4-wide float point transform */
+#endif
+
+namespace cyberalaska {
+
+/** cos and sin of every whole degree, so a sweep needs no trig per direction. */
+class neato_trig_table {
+public:
+	float c[neato_scan_t::ndir], s[neato_scan_t::ndir];
+	neato_trig_table() {
+		for (int d=0;d<neato_scan_t::ndir;d++) {
+			double rad=d*M_PI/180.0;
+			c[d]=cos(rad); s[d]=sin(rad);
+		}
+	}
+};
+static const neato_trig_table neato_trig;
+
+void neato_world_points(const neato_scan_t &scan,const robot &r,const sensor_t &neato,
+	neato_points_t &points,int spin)
+{
+	neato_world_points(scan,r.location,r.angle,neato,points,spin);
+}
+
+void neato_world_points(const neato_scan_t &scan,const vec3 &robot_location,double robot_angle,
+	const sensor_t &neato,neato_points_t &points,int spin)
+{
+	enum {ndir=neato_scan_t::ndir};
+
+	// Where the sensor is in the world, and which way its 0 degrees points
+	double robot_rad=robot_angle*M_PI/180.0;
+	double rc=cos(robot_rad), rs=sin(robot_rad);
+	points.origin_x=robot_location.x+rc*neato.location.x-rs*neato.location.y;
+	points.origin_y=robot_location.y+rs*neato.location.x+rc*neato.location.y;
+	double sensor_rad=robot_rad;
+	if (neato.direction.x!=0 || neato.direction.y!=0)
+		sensor_rad+=atan2(neato.direction.y,neato.direction.x);
+
+	// Direction d points along (cos(sensor+spin*d), sin(sensor+spin*d)),
+	//   which we expand into table lookups times these four constants.
+	float a=cos(sensor_rad), b=-spin*sin(sensor_rad);
+	float c=sin(sensor_rad), e=spin*cos(sensor_rad);
+
+	for (int d=0;d<ndir;d++) points.range[d]=scan.dir[d].distance*0.1f; // mm to cm
+
+	const float *ct=neato_trig.c, *st=neato_trig.s;
+	int d=0;
+#if defined(__SSE__)
+	__m128 A=_mm_set1_ps(a), B=_mm_set1_ps(b), C=_mm_set1_ps(c), E=_mm_set1_ps(e);
+	__m128 OX=_mm_set1_ps(points.origin_x), OY=_mm_set1_ps(points.origin_y);
+	for (;d+4<=ndir;d+=4) {
+		__m128 range=_mm_loadu_ps(points.range+d);
+		__m128 cd=_mm_loadu_ps(ct+d), sd=_mm_loadu_ps(st+d);
+		__m128 x=_mm_add_ps(_mm_mul_ps(cd,A),_mm_mul_ps(sd,B));
+		__m128 y=_mm_add_ps(_mm_mul_ps(cd,C),_mm_mul_ps(sd,E));
+		_mm_storeu_ps(points.x+d,_mm_add_ps(OX,_mm_mul_ps(range,x)));
+		_mm_storeu_ps(points.y+d,_mm_add_ps(OY,_mm_mul_ps(range,y)));
+	}
+#endif
+	for (;d<ndir;d++) 
+	{ /* scalar fallback, and any leftover directions at the end */
+		points.x[d]=points.origin_x+points.range[d]*(ct[d]*a+st[d]*b);
+		points.y[d]=points.origin_y+points.range[d]*(ct[d]*c+st[d]*e);
+	}
+}
+
+
+occupancy_grid::occupancy_grid(const vec3 &corner_,double width,double height,double cell_size_)
+	:corner(corner_), cell_size(cell_size_), inv_cell_size(1.0/cell_size_)
+{
+	cells_wide=(int)ceil(width*inv_cell_size);
+	cells_high=(int)ceil(height*inv_cell_size);
+	tiles_wide=(cells_wide+tile_size-1)>>tile_bits;
+	tiles_high=(cells_high+tile_size-1)>>tile_bits;
+	tiles.resize(tiles_wide*tiles_high,NULL);
+}
+occupancy_grid::~occupancy_grid() {
+	for (unsigned int t=0;t<tiles.size();t++) delete tiles[t];
+}
+
+void occupancy_grid::clear(void) {
+	for (unsigned int t=0;t<tiles.size();t++) if (tiles[t]) {
+		memset(tiles[t]->cells,0,sizeof(tiles[t]->cells));
+		tiles[t]->version++;
+	}
+}
+
+occupancy_grid::tile_t *occupancy_grid::new_tile(void) {
+	tile_t *t=new tile_t;
+	memset(t->cells,0,sizeof(t->cells));
+	t->version=0;
+	return t;
+}
+
+occupancy_grid::tile_t *occupancy_grid::tile_for(int cx,int cy) {
+	tile_t *&t=tiles[(cy>>tile_bits)*tiles_wide+(cx>>tile_bits)];
+	if (t==NULL) t=new_tile();
+	return t;
+}
+
+/// Add this much log-odds to this cell, stopping at +-log_max.
+static inline void occupancy_add(occupancy_grid::cell_t &cell,int delta) {
+	int v=cell+delta;
+	if (v>occupancy_grid::log_max) v=occupancy_grid::log_max;
+	if (v<-occupancy_grid::log_max) v=-occupancy_grid::log_max;
+	cell=v;
+}
+
+void occupancy_grid::add_points(const neato_points_t &points) {
+	for (int d=0;d<neato_points_t::ndir;d++)
+		if (points.range[d]>0) // no return means no evidence either way
+			add_ray(points.origin_x,points.origin_y,points.x[d],points.y[d],true);
+}
+
+void occupancy_grid::add_ray(float x0,float y0,float x1,float y1,bool hit) {
+	// Bresenham's line walk, from the sensor's cell to the hit's cell
+	int cx=cell_x(x0), cy=cell_y(y0);
+	int ex=cell_x(x1), ey=cell_y(y1);
+	int dx=abs(ex-cx), dy=-abs(ey-cy);
+	int sx=(cx<ex)?1:-1, sy=(cy<ey)?1:-1;
+	int err=dx+dy;
+
+	tile_t *t=NULL;
+	int tx=-1, ty=-1; // tile t is for (only look up tiles when we cross into a new one)
+	while (true) {
+		bool last=(cx==ex && cy==ey);
+		if (cx>=0 && cy>=0 && cx<cells_wide && cy<cells_high) {
+			if ((cx>>tile_bits)!=tx || (cy>>tile_bits)!=ty) {
+				tx=cx>>tile_bits; ty=cy>>tile_bits;
+				t=tile_for(cx,cy);
+				t->version++;
+			}
+			cell_t &cell=t->cells[((cy&(tile_size-1))<<tile_bits)+(cx&(tile_size-1))];
+			occupancy_add(cell,(last && hit)?log_hit:log_miss);
+		}
+		if (last) break;
+		int e2=2*err;
+		if (e2>=dy) { err+=dy; cx+=sx; }
+		if (e2<=dx) { err+=dx; cy+=sy; }
+	}
+}
+
+double occupancy_grid::probability(const vec3 &world) const {
+	double log_odds=cell(cell_x(world.x),cell_y(world.y))*0.1;
+	return 1.0/(1.0+exp(-log_odds));
+}
+
+};
@@ -0,0 +1,126 @@
+/**
+Turns Neato laser sweeps into world geometry: a point per direction in
+world coordinates, and a log-odds occupancy grid built up from those points.
+World coordinates are centimeters, like the robot's location.
+
+Public Domain
+*/
+#ifndef __CYBERALASKA_NEATO_MAP_H
+#define __CYBERALASKA_NEATO_MAP_H
+
+#include "../cyberalaska/neato_sensor.h"
+#include "../cyberalaska/robot.h"
+#include <vector>
+
+namespace cyberalaska {
+
+/**
+ One sweep's points in world coordinates.  These are stored as separate
+ arrays (not an array of vec3) so the transform can do 4 directions at
+ once with SSE instructions.
+*/
+class neato_points_t {
+public:
+	enum {ndir=neato_scan_t::ndir};
+	float x[ndir], y[ndir]; ///< world coordinates of each direction's hit
+	float range[ndir]; ///< centimeters from the sensor to the hit, or 0 for no hit
+	float origin_x, origin_y; ///< world coordinates of the sensor itself
+};
+
+/**
+ Convert a sweep to world coordinates, for this Neato sensor on this robot.
+ The sensor's location and direction are in robot coordinates, and the
+ robot's location and angle are in world coordinates; see robot.h.
+ Neato degrees normally count counterclockwise seen from above, like the
+ robot's angle; pass spin=-1 if the sensor is mounted upside down.
+*/
+void neato_world_points(const neato_scan_t &scan,const robot &r,const sensor_t &neato,
+	neato_points_t &points,int spin=+1);
+
+/** Same as above, for a robot at this location (centimeters) and angle (degrees). */
+void neato_world_points(const neato_scan_t &scan,const vec3 &robot_location,double robot_angle,
+	const sensor_t &neato,neato_points_t &points,int spin=+1);
+
+
+/**
+ A 2D map of how likely each patch of floor is to be blocked.
+ Each cell holds the log-odds of being occupied, so adding evidence is
+ just adding a number.  Cells are grouped into square tiles that are only
+ allocated once something is seen there, and each tile counts its changes
+ so a display can redraw only the tiles that changed.
+*/
+class occupancy_grid {
+public:
+	/// Log-odds of a cell being occupied, in tenths: 0 is unknown,
+	///   positive is probably blocked, negative is probably open.
+	typedef signed char cell_t;
+	enum {
+		log_hit=+8, ///< a ray ended here (p=0.7)
+		log_miss=-4, ///< a ray passed through here (p=0.4)
+		log_max=100 ///< cells stop changing at +-this (p=0.99995)
+	};
+	enum {tile_bits=5, tile_size=1<<tile_bits}; ///< tiles are 32x32 cells
+
+	/** Make an empty grid covering this rectangle of the world:
+	  corner is the low x and y corner, and sizes are in centimeters. */
+	occupancy_grid(const vec3 &corner,double width,double height,double cell_size=5.0);
+	~occupancy_grid();
+
+	/** Forget everything (keeps the tiles for reuse). */
+	void clear(void);
+
+	/** Add evidence from a sweep's points: cells between the sensor and
+	  each hit get log_miss, and the hit's own cell gets log_hit. */
+	void add_points(const neato_points_t &points);
+
+	/** Add evidence from one ray, in world coordinates.
+	  If hit is false, the ray ran out without hitting anything. */
+	void add_ray(float x0,float y0,float x1,float y1,bool hit);
+
+	/** Return the log-odds of this cell (0 if outside the grid). */
+	cell_t cell(int cx,int cy) const {
+		if (cx<0 || cy<0 || cx>=cells_wide || cy>=cells_high) return 0;
+		const tile_t *t=tiles[(cy>>tile_bits)*tiles_wide+(cx>>tile_bits)];
+		if (t==NULL) return 0;
+		return t->cells[((cy&(tile_size-1))<<tile_bits)+(cx&(tile_size-1))];
+	}
+
+	/** Return the probability that this world location is blocked (0.5 if unknown). */
+	double probability(const vec3 &world) const;
+
+	/** Cell containing this world location (may be outside the grid). */
+	int cell_x(double world_x) const { return (int)floor((world_x-corner.x)*inv_cell_size); }
+	int cell_y(double world_y) const { return (int)floor((world_y-corner.y)*inv_cell_size); }
+
+	/** Counts changes to this tile, or 0 if nothing has been seen there. */
+	unsigned long tile_version(int tx,int ty) const {
+		const tile_t *t=tiles[ty*tiles_wide+tx];
+		return t?t->version:0;
+	}
+
+	vec3 corner; ///< world coordinates of cell 0,0's low corner
+	double cell_size; ///< centimeters across each cell
+	int cells_wide, cells_high; ///< size of the grid, in cells
+	int tiles_wide, tiles_high; ///< size of the grid, in tiles
+
+private:
+	class tile_t {
+	public:
+		cell_t cells[tile_size*tile_size];
+		unsigned long version;
+	};
+	std::vector<tile_t *> tiles; ///< tiles_wide*tiles_high, NULL until used
+	double inv_cell_size;
+
+	/// Return the tile holding cell cx,cy (which must be inside the grid), making it if needed.
+	tile_t *tile_for(int cx,int cy);
+	tile_t *new_tile(void);
+
+	// Do not copy or assign grids.
+	occupancy_grid(const occupancy_grid &g);
+	void operator=(const occupancy_grid &g);
+};
+
+};
+
+#endif
@@ -8,18 +8,111 @@
 #define __CYBERALASKA__NEATO_SENSOR__H
 
 #include "../cyberalaska/neato_serial.h"
+#include "../cyberalaska/porthread.h"
+#include "../cyberalaska/sensor.h"
 
 namespace cyberalaska {
-	class neato_sensor_t : public sensor_t {
+	/** One 360-degree sweep of the Neato, assembled from NeatoLDSbatch reports. */
+	class neato_scan_t {
 	public:
 		/// 360-degree list of direction reports:
 		enum {ndir=360};
 		NeatoLDSdir dir[ndir];
-		
+
+		/// cyberalaska::time() each direction was measured, or 0 if never.
+		double stamp[ndir];
+
+		/// Number of times the sweep has wrapped around past 0 degrees.
+		unsigned long revolution;
+
+		/// Number of batches added so far (this scan's version number).
+		unsigned long sequence;
+
+		neato_scan_t() { clear(); }
+		void clear(void) {
+			for (int i=0;i<ndir;i++) { dir[i].clear(); stamp[i]=0.0; }
+			revolution=0; sequence=0; last_index=-1;
+		}
+
+		/** Add this batch to the sweep.  batch_time is when the batch's last
+		   direction was measured; earlier directions are stamped back from
+		   there using the batch's spin speed. */
+		void add(const NeatoLDSbatch &b,double batch_time) {
+			if (b.index<last_index) revolution++; // wrapped past 0 degrees
+			last_index=b.index;
+			double rpm=b.speed64*(1.0/64);
+			double per_degree=(rpm>0)?60.0/(rpm*ndir):0.0; // seconds
+			for (int i=0;i<NeatoLDSbatch::size;i++) {
+				int d=i+b.index;
+				if (d>=0 && d<ndir) {
+					dir[d]=b.dir[i];
+					stamp[d]=batch_time-(NeatoLDSbatch::size-1-i)*per_degree;
+				}
+			}
+			sequence++;
+		}
+	private:
+		int last_index; ///< start index of the last batch added
+	};
+
+	/**
+	  Hands neato_scan_t sweeps from the serial thread (producer) to one
+	  consumer thread without locks, using three scans: the producer fills
+	  one, the consumer reads another, and the third holds the newest sweep
+	  not yet taken.  Handing a sweep over either way is one atomic exchange
+	  of a buffer index, so neither side ever waits, and the consumer never
+	  sees a sweep the producer is still writing.
+	*/
+	class neato_scan_buffer {
+	public:
+		neato_scan_buffer() :back(0), front(2), middle(1) {}
+
+		/** Producer: add this batch to the sweep and publish the result. */
+		void put(const NeatoLDSbatch &b,double batch_time) {
+			building.add(b,batch_time);
+			scans[back]=building; // the spare scan may be several batches old
+			back=porthread_exchange(&middle,back|fresh)&index_mask;
+		}
+
+		/** Consumer: point scan at the newest sweep.  Returns false if there's
+		   been nothing new since the last call (scan is still the newest).
+		   The sweep stays put until this consumer's next call. */
+		bool take(const neato_scan_t *&scan) {
+			bool is_new=false;
+			if (middle&fresh) {
+				front=porthread_exchange(&middle,front)&index_mask;
+				is_new=true;
+			}
+			scan=&scans[front];
+			return is_new;
+		}
+
+		/** Consumer: the newest sweep, good until this consumer's next call. */
+		const neato_scan_t &latest(void) {
+			const neato_scan_t *scan;
+			take(scan);
+			return *scan;
+		}
+	private:
+		enum {index_mask=3, fresh=4}; ///< bits of middle
+		neato_scan_t scans[3];
+		neato_scan_t building; ///< producer's sweep, always up to date
+		long back, front; ///< scans owned by the producer and consumer
+		volatile long middle; ///< index of the spare scan, plus fresh if it's newer than front
+
+		neato_scan_buffer(const neato_scan_buffer &); // don't copy
+		void operator=(const neato_scan_buffer &);
+	};
+
+	class neato_sensor_t : public sensor_t {
+	public:
+		/// Full sweeps from the Neato, written by the robot's serial thread.
+		///   Read them with scans.take() or scans.latest(), from one thread.
+		neato_scan_buffer scans;
+
 		neato_sensor_t(const metadata_sensor &metadata_) 
 			:sensor_t(metadata_) 
 		{
-			for (int i=0;i<ndir;i++) dir[i].clear();
 		}
 	};
 
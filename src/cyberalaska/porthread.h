@@ -52,6 +52,12 @@ public:
 	inline void unlock()	{ LeaveCriticalSection(&critsec); }
 };
 
+/** Store v in *p and return what was there, as one atomic step.
+   Also a full memory barrier: writes before it are seen before it. */
+inline long porthread_exchange(volatile long *p,long v) {
+	return InterlockedExchange(p,v);
+}
+
 
 #else /* Portable UNIX pthread version */
 #include <pthread.h>
@@ -67,6 +73,13 @@ public:
 	inline void unlock()	{ pthread_mutex_unlock(&mtx); }
 };
 
+/** Store v in *p and return what was there, as one atomic step.
+   Also a full memory barrier: writes before it are seen before it. */
+inline long porthread_exchange(volatile long *p,long v) {
+	__sync_synchronize(); /* test_and_set alone is only an acquire barrier */
+	return __sync_lock_test_and_set(p,v);
+}
+
 #endif
 
 /**
@@ -13,6 +13,7 @@ Dr. Orion Sky Lawlor, lawlor@alaska.edu, 2013-11-06 (Public Domain)
 
 #include "../cyberalaska/porthread.cpp"
 #include "../msl/serial.cpp"
+#include "../msl/serial_thread.cpp"
 #include "../msl/time_util.cpp"
 
 void show_help() {
@@ -15,16 +15,27 @@
 
 #define SERIAL_USE_MSL 1    /* 1 for MSL serial, 0 for OSL serial */
 
+#if SENSORS_ULTRASONIC && SERIAL_USE_MSL
+/* The ultrasonic replies are raw bytes, not A-packets, and MSL serial's io
+   thread owns the port, so its decoder would eat them. */
+#  error "SENSORS_ULTRASONIC needs OSL serial (SERIAL_USE_MSL 0)"
+#endif
+
 #if SERIAL_USE_MSL
 #  include "../msl/serial.hpp"
+#  include "../msl/serial_thread.hpp"
 #  include "../msl/time_util.hpp"
 #else
 #  include "../osl/serial.h"
 #  include "../osl/serial.cpp"
 #endif
+#include <deque>
 using namespace cyberalaska;
 
 #include "../cyberalaska/serial_packet.h"
+#if SERIAL_USE_MSL
+#  include "../cyberalaska/serial_packet_decoder.h"
+#endif
 
 
 
@@ -45,7 +56,10 @@ public:
  	int serial_timeout;
 #if SERIAL_USE_MSL /* MSL serial */
 	msl::serial comm;
-	A_packet_formatter<rover5> pkt;
+	A_packet_formatter<rover5> pkt; // outgoing packets
+	A_packet_decoder decoder; // incoming packets, decoded on io's thread
+	msl::serial_thread io; // waits in poll for bytes, queues whole packets
+	msl::serial_packet response; // last popped packet (memory is reused)
 
 	int available() { return comm.available(); }
 	void write(unsigned char command) {
@@ -56,24 +70,16 @@ public:
 			//length, (int)data[0],(int)data[length-1]);
 		comm.write(data,length);
 	}
-	int read() {
-		unsigned char ret;
-		unsigned long timer=msl::millis()+serial_timeout;
-		 while (comm.available()<1&&msl::millis()<timer)
-			porthread_yield(1);
-
-		if (comm.read(&ret,1)!=1) return -1;
-		else return ret;
-	}
 
 	bool comm_good;
 
 	rover5(const metadata_general &meta,const std::string &port)
-		:robot(meta), serial_timeout(1000), comm(port,57600), pkt(*this), comm_good(false)
+		:robot(meta), serial_timeout(1000), comm(port,57600), pkt(*this), io(comm,decoder), comm_good(false)
 	{
 		comm.connect();
 
 		if (!comm.good()) status="error opening port";
+		else if (!io.start()) status="error starting serial thread";
 		else ping(); // check if we've got connectivity
 	}
 #else /* OSL serial (seems to run just the same) */
@@ -106,24 +112,39 @@ public:
 		else ping(); // check if we've got connectivity
 	}
 #endif
-	/// Read serial data until we have the next entire packet,
-	///  and handle the packet
-	void read_until_packet(const char *from_code) {
+	/// Wait for the next entire packet from the rover.
+	///  Returns false (and resets the receiver) after 0.7 seconds without one.
+	bool next_packet(A_packet &p) {
+#if SERIAL_USE_MSL /* sleep until the io thread has a whole packet */
+		if (io.pop(response,700)) {
+			p=A_packet_decoder::to_A_packet(response);
+			return true;
+		}
+		// getting here means a timeout occurred--reset receiver
+		io.reset();
+#else
 		double start_time=cyberalaska::time();
-		A_packet p;
 		p.valid=0;
 		while (start_time+0.7>cyberalaska::time() ) {
 			int r=pkt.read_packet(p);
 			if (r==-1) continue; // more data coming--keep looping
 			if (r==0) { porthread_yield(0); } // waiting for data
 			else { /* r==1: have a whole packet now */
-				handle_packet(p,from_code);
-				return;
+				return true;
 			}
 		}
 		// getting here means a timeout occurred--reset receiver
 		pkt.reset();
-		//printf("Rover5 PC-side timeout from %s\n",from_code);
+#endif
+		return false;
+	}
+
+	/// Read serial data until we have the next entire packet,
+	///  and handle the packet
+	void read_until_packet(const char *from_code) {
+		A_packet p;
+		if (next_packet(p)) handle_packet(p,from_code);
+		//else printf("Rover5 PC-side timeout from %s\n",from_code);
 	}
 
 	/// Handle this serial data packet arriving from the rover
@@ -232,33 +253,138 @@ public:
 		last_batch_index=b.index;
 		if (b.errors>0) return "serial errors detected on Arduino side";
 
-		// write to our directions
-		for (int i=0;i<NeatoLDSbatch::size;i++) {
-			int d=i+b.index;
-			if (d>=0 && d<neato_sensor_t::ndir) neato->dir[d]=b.dir[i];
-		}
-		neato->update_timestamp(neato_timestamp); // fixme: per-direction timestamps?
+		// add to the sweep, which hands it to readers without tearing
+		neato->scans.put(b,neato_timestamp);
+		neato->update_timestamp(neato_timestamp);
 		//printf("Neato roundtrip: %.1f ms\n",1000.0*(cyberalaska::time()-neato_timestamp));
 
 		return NULL; // OK
 	}
 #endif
 
+/* Pipelined request scheduler.
+   Instead of lock-step (send, wait, send, wait), we keep up to "window"
+   requests in flight.  The Arduino answers in order, so each response is
+   matched to the oldest in-flight request with the same command code
+   (older unmatched requests lost their response).  Because answers come
+   back in order, a motor command waits behind every request sent before
+   it, so we alternate: at most neato_per_motor Neato requests go out
+   between motor commands, and a second motor command may be in flight.
+   The window is small (3), since a deeper pipe only makes each motor
+   command staler by the time the Arduino applies it.
+   The window grows while round trips stay near the best we've seen for
+   that command, shrinks when they stretch out (bytes queueing in the
+   link), and drops back on a timeout.
+*/
+	struct request_t {
+		int command; // A-packet command code
+		double sent; // cyberalaska::time() when we sent it
+	};
+	std::deque<request_t> in_flight; // oldest first
+	enum {min_window=2, max_window=3};
+	int window; // requests allowed in flight right now
+	double rtt_best[16]; // best round trip seen per command (seconds)
+	int lost_responses; // requests that never got an answer
+	bool ping_due; // send a ping when there's room
+	enum {max_motor_in_flight=2, neato_per_motor=1};
+	int neato_since_motor; // Neato requests sent since the last motor request
+
+	/// Send this request, and remember it's in flight.
+	void send_request(int command) {
+		if (command==0x3) { request_motors(); neato_since_motor=0; }
+#if SENSORS_NEATO
+		else if (command==0xD) { request_neato(); neato_since_motor++; }
+#endif
+		else pkt.write_packet(command,0,0);
+		request_t r;
+		r.command=command;
+		r.sent=cyberalaska::time();
+		in_flight.push_back(r);
+	}
+
+	/// Count our in-flight requests with this command code.
+	int count_in_flight(int command) const {
+		int n=0;
+		for (unsigned int i=0;i<in_flight.size();i++)
+			if (in_flight[i].command==command) n++;
+		return n;
+	}
+
+	/// Send requests until the window is full, in priority order.
+	void fill_window() {
+		while ((int)in_flight.size()<window) {
+			if (neato_since_motor>=neato_per_motor) { // motors' turn
+				if (count_in_flight(0x3)<max_motor_in_flight) send_request(0x3);
+				else break; // wait for a motor reply
+			}
+			else if (ping_due && count_in_flight(0x0)==0) { send_request(0x0); ping_due=false; }
+#if SENSORS_NEATO
+			else send_request(0xD);
+#else
+			else neato_since_motor=neato_per_motor; // nothing else to send
+#endif
+		}
+	}
+
+	/// Wait for one response, match it to its request, and handle it.
+	void receive_response() {
+		A_packet p;
+		if (!next_packet(p)) { /* timeout: everything in flight is lost */
+			lost_responses+=in_flight.size();
+			in_flight.clear();
+			window=min_window;
+			return;
+		}
+
+		// Find the request this answers (corrupt packets answer the oldest)
+		unsigned int match=0;
+		if (p.valid) {
+			while (match<in_flight.size() && in_flight[match].command!=p.command) match++;
+		}
+		if (match>=in_flight.size()) { /* nothing asked for this */
+			handle_packet(p,"unrequested");
+			return;
+		}
+		request_t r=in_flight[match];
+		lost_responses+=match;
+		in_flight.erase(in_flight.begin(),in_flight.begin()+match+1);
+
+		// Adapt window to round trip time
+		double rtt=cyberalaska::time()-r.sent;
+		double &best=rtt_best[r.command&0xf];
+		if (rtt<best) best=rtt;
+		if (rtt<1.5*best+0.002) { if (window<max_window) window++; }
+		else if (rtt>3.0*best) { if (window>min_window) window--; }
+
+		if (r.command==0x3) motor_timestamp=r.sent;
+#if SENSORS_NEATO
+		if (r.command==0xD) neato_timestamp=r.sent;
+#endif
+		handle_packet(p,"pipeline");
+	}
+
+	/// Wait until nothing is in flight.
+	void drain() {
+		while (!in_flight.empty()) receive_response();
+	}
+
 	/* Run this rover's communication thread, forever. */
 	void comm_thread() {
 		int comm_count=0;
+		window=min_window;
+		for (int c=0;c<16;c++) rtt_best[c]=1.0e3;
+		lost_responses=0;
+		ping_due=false;
+		neato_since_motor=neato_per_motor;
 		while (1) {
-			if ((comm_count%100)==0)
-			{ /* periodically resynchronize */
-				ping();
-			}
-
-			// Command left and right motors
-			request_motors();
-			read_until_packet("motors");
+			/* keep the pipe full; periodically resynchronize with a ping */
+			if ((comm_count%100)==0) ping_due=true;
+			fill_window();
+			receive_response();
 
 #if SENSORS_ULTRASONIC
-			// Read ultrasonic sensors
+			// Read ultrasonic sensors (raw bytes, so nothing else can be in flight)
+			drain();
 			int n_sense=2;
 			for (int s=0;s<n_sense;s++) {
 				write(0x90+s);
@@ -274,11 +400,6 @@ public:
 			}
 #endif
 
-#if SENSORS_NEATO
-			request_neato();
-			read_until_packet("neato");
-#endif
-
 			comm_count++;
 		}
 	}
@@ -0,0 +1,198 @@
+/**
+Estimates the robot's pose between camera frames by lining up each Neato
+sweep with the occupancy map, and folds in bullseye camera fixes.
+
+Public Domain
+*/
+#include "../cyberalaska/scan_matcher.h"
+#include "../cyberalaska/time.h"
+#include <algorithm> /* for std::sort and std::max */
+#include <math.h>
+
+namespace cyberalaska {
+
+void scan_match_table::build(const occupancy_grid &grid) {
+	// A border of empty cells, so blocks starting just off the map's low
+	//   edges still see the map cells they cover.
+	enum {border=coarse_step};
+	wide=grid.cells_wide+2*border; high=grid.cells_high+2*border;
+	cell_size=grid.cell_size;
+	corner=grid.corner-vec3(border*cell_size,border*cell_size,0);
+	int n=wide*high;
+	fine.resize(n); coarse.resize(n);
+
+	// Score blocked cells by confidence (coarse is scratch space for now)
+	std::vector<unsigned char> &base=coarse;
+	for (int y=0;y<high;y++)
+	for (int x=0;x<wide;x++) {
+		int v=grid.cell(x-border,y-border);
+		base[y*wide+x]=(v>0)?v*255/occupancy_grid::log_max:0;
+	}
+
+	// Half credit for landing next to a blocked cell
+	for (int y=0;y<high;y++)
+	for (int x=0;x<wide;x++) {
+		int best=base[y*wide+x];
+		for (int ny=std::max(y-1,0);ny<=std::min(y+1,high-1);ny++)
+		for (int nx=std::max(x-1,0);nx<=std::min(x+1,wide-1);nx++)
+			best=std::max(best,base[ny*wide+nx]/2);
+		fine[y*wide+x]=best;
+	}
+
+	// Coarse: max over the block starting at each cell, one axis at a time
+	std::vector<unsigned char> rows(n);
+	for (int y=0;y<high;y++)
+	for (int x=0;x<wide;x++) {
+		int best=0;
+		for (int i=0;i<coarse_step && x+i<wide;i++) best=std::max(best,(int)fine[y*wide+x+i]);
+		rows[y*wide+x]=best;
+	}
+	for (int y=0;y<high;y++)
+	for (int x=0;x<wide;x++) {
+		int best=0;
+		for (int i=0;i<coarse_step && y+i<high;i++) best=std::max(best,(int)rows[(y+i)*wide+x]);
+		coarse[y*wide+x]=best;
+	}
+}
+
+
+void scan_matcher::set_map(const occupancy_grid &grid) {
+	double start=cyberalaska::time();
+	table.build(grid);
+	stats.table_seconds=cyberalaska::time()-start;
+}
+
+int scan_matcher::score(const unsigned char *t,const int *cell,int n,int dx,int dy) const {
+	int total=0;
+	for (int i=0;i<n;i++) {
+		int x=cell[2*i]+dx, y=cell[2*i+1]+dy;
+		if ((unsigned int)x<(unsigned int)table.wide && (unsigned int)y<(unsigned int)table.high)
+			total+=t[y*table.wide+x];
+	}
+	return total;
+}
+
+/// Wrap an angle in degrees into -180 to +180.
+static double wrap_degrees(double angle) {
+	angle=fmod(angle+180.0,360.0);
+	if (angle<0) angle+=360.0;
+	return angle-180.0;
+}
+
+bool scan_matcher::match(const neato_scan_t &scan,const sensor_t &neato,const pose2d &guess,pose2d &result) {
+	enum {ndir=neato_scan_t::ndir, step=scan_match_table::coarse_step};
+	double start=cyberalaska::time();
+	stats.matches++;
+	stats.coarse_scores=stats.fine_scores=0;
+	stats.last_score=0;
+	bool ok=false;
+
+	int half=(int)floor(search_angle/angle_step+0.5);
+	int n_angles=2*half+1;
+	int reach=(int)ceil(search_distance/table.cell_size);
+	double inv_cell=1.0/table.cell_size;
+
+	// Put the sweep in table cells once per angle (translations just offset these)
+	cells.resize(n_angles*ndir*2);
+	int n=0;
+	for (int a=0;a<n_angles;a++) {
+		neato_world_points(scan,vec3(guess.x,guess.y,0),guess.angle+(a-half)*angle_step,neato,points);
+		int *cell=&cells[a*ndir*2];
+		n=0;
+		for (int d=0;d<ndir;d++) if (points.range[d]>0) {
+			cell[2*n]=(int)floor((points.x[d]-table.corner.x)*inv_cell);
+			cell[2*n+1]=(int)floor((points.y[d]-table.corner.y)*inv_cell);
+			n++;
+		}
+	}
+
+	if (n>=min_points && table.wide>0) {
+		// Coarse pass: one score per block, per angle
+		candidates.clear();
+		for (int a=0;a<n_angles;a++)
+		for (int dy=-reach;dy<=reach;dy+=step)
+		for (int dx=-reach;dx<=reach;dx+=step) {
+			candidate_t c;
+			c.score=score(&table.coarse[0],&cells[a*ndir*2],n,dx,dy);
+			c.angle=a; c.dx=dx; c.dy=dy;
+			candidates.push_back(c);
+			stats.coarse_scores++;
+		}
+		std::sort(candidates.begin(),candidates.end());
+
+		// Fine pass: best blocks first, until no block can beat what we've got
+		int best=-1, best_angle=half, best_dx=0, best_dy=0;
+		for (unsigned int i=0;i<candidates.size();i++) {
+			const candidate_t &c=candidates[i];
+			if (c.score<=best) break;
+			for (int fy=c.dy;fy<c.dy+step && fy<=reach;fy++)
+			for (int fx=c.dx;fx<c.dx+step && fx<=reach;fx++) {
+				int s=score(&table.fine[0],&cells[c.angle*ndir*2],n,fx,fy);
+				stats.fine_scores++;
+				if (s>best) { best=s; best_angle=c.angle; best_dx=fx; best_dy=fy; }
+			}
+		}
+
+		stats.last_score=best/(255.0*n);
+		if (stats.last_score>=min_score) {
+			result.x=guess.x+best_dx*table.cell_size;
+			result.y=guess.y+best_dy*table.cell_size;
+			result.angle=wrap_degrees(guess.angle+(best_angle-half)*angle_step);
+			ok=true;
+		}
+	}
+
+	stats.last_seconds=cyberalaska::time()-start;
+	stats.total_seconds+=stats.last_seconds;
+	stats.max_seconds=std::max(stats.max_seconds,stats.last_seconds);
+	return ok;
+}
+
+
+void pose_estimator::remember(void) {
+	history[history_next]=pose;
+	history_time[history_next]=pose_time;
+	history_next=(history_next+1)%history_size;
+	if (history_count<history_size) history_count++;
+}
+
+bool pose_estimator::scan_update(scan_matcher &matcher,const neato_scan_t &scan,const sensor_t &neato,double scan_time) {
+	pose2d matched;
+	bool ok=matcher.match(scan,neato,pose,matched);
+	if (ok) { pose=matched; scan_updates++; }
+	else scan_rejects++;
+	pose_time=scan_time;
+	remember();
+	return ok;
+}
+
+void pose_estimator::camera_fix(const vec3 &fix,double capture_time) {
+	camera_fixes++;
+	double fix_angle=fix.z*180.0/M_PI;
+	if (pose_time==0.0) { // first fix: nothing to fuse with yet
+		pose=pose2d(fix.x,fix.y,wrap_degrees(fix_angle));
+		pose_time=capture_time;
+		remember();
+		return;
+	}
+
+	// Find where we thought we were when the camera's frame was captured
+	pose2d then=pose;
+	for (int i=1;i<=history_count;i++) {
+		int h=(history_next-i+history_size)%history_size;
+		then=history[h];
+		if (history_time[h]<=capture_time) break;
+	}
+
+	// Move now (and our memory of then) by part of the difference
+	double dx=camera_gain*(fix.x-then.x);
+	double dy=camera_gain*(fix.y-then.y);
+	double da=camera_gain*wrap_degrees(fix_angle-then.angle);
+	pose.x+=dx; pose.y+=dy; pose.angle=wrap_degrees(pose.angle+da);
+	for (int i=0;i<history_count;i++) {
+		history[i].x+=dx; history[i].y+=dy;
+		history[i].angle=wrap_degrees(history[i].angle+da);
+	}
+}
+
+};
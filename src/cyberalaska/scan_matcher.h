@@ -0,0 +1,163 @@
+/**
+Estimates the robot's pose between camera frames by lining up each Neato
+sweep with the occupancy map, and folds in bullseye camera fixes whenever
+they show up.
+
+Typical use, on the thread that reads the Neato:
+	const neato_scan_t *scan;
+	if (neato->scans.take(scan)) {
+		estimator.scan_update(matcher,*scan,*neato,cyberalaska::time());
+		estimator.apply(robot);
+		neato_world_points(*scan,robot,*neato,points);
+		grid.add_points(points);
+		if (++sweeps%10==0) matcher.set_map(grid); // tables lag the map a little
+	}
+	if (camera has a new bullseye) estimator.camera_fix(fix,capture_time);
+
+Nothing calls this yet.  rover5 only puts sweeps in neato->scans, and scans
+has one reader, which should be the program that owns the map rather than
+the rover's comm thread.  bullseye_camera reports pixels with no floor
+calibration, so today camera_fix needs bullseye_keeper's centimeter output.
+
+Public Domain
+*/
+#ifndef __CYBERALASKA_SCAN_MATCHER_H
+#define __CYBERALASKA_SCAN_MATCHER_H
+
+#include "../cyberalaska/neato_map.h"
+#include <vector>
+
+namespace cyberalaska {
+
+/** Where a robot is on the floor: centimeters and degrees, like robot::location and robot::angle. */
+class pose2d {
+public:
+	double x, y; ///< world coordinates, centimeters
+	double angle; ///< degrees counterclockwise from the +x axis, -180 to +180
+	pose2d(double x_=0.0,double y_=0.0,double angle_=0.0)
+		:x(x_), y(y_), angle(angle_) {}
+};
+
+/**
+ Score tables for matching sweeps against an occupancy_grid.
+ fine scores each cell by how sure the map is that it's blocked (with
+ a little credit for being next to a blocked cell).  coarse holds, for
+ each cell, the best fine score in the coarse_step x coarse_step block
+ starting there, so a sweep's coarse score is never less than its fine
+ score anywhere in that block.  Both tables have a few empty cells of
+ border around the map.
+*/
+class scan_match_table {
+public:
+	enum {coarse_step=4}; ///< fine cells per side of a coarse block
+	std::vector<unsigned char> fine, coarse; ///< wide*high scores, 0-255
+	int wide, high; ///< size of the tables, in cells
+	vec3 corner; ///< world coordinates of cell 0,0's low corner
+	double cell_size; ///< centimeters across each cell
+
+	scan_match_table() :wide(0), high(0), cell_size(1.0) {}
+
+	/** Rebuild both tables from this map. */
+	void build(const occupancy_grid &grid);
+};
+
+/**
+ Correlative scan matcher: tries every angle and offset in a window around
+ a guessed pose, and keeps the one where the sweep's points land on the
+ most blocked map cells.  Each angle is scored on the coarse table first,
+ and only blocks whose coarse score beats the best fine score so far are
+ searched cell by cell, best first, so most of the window is never scored
+ at full resolution.
+*/
+class scan_matcher {
+public:
+	double search_distance; ///< centimeters either way from the guess (default 50)
+	double search_angle; ///< degrees either way from the guess (default 10)
+	double angle_step; ///< degrees between angles tried (default 1)
+	double min_score; ///< reject matches scoring below this (0-1, default 0.2)
+	int min_points; ///< reject sweeps with fewer hits than this (default 60)
+
+	/// Timing and search statistics, updated by every match.
+	class stats_t {
+	public:
+		unsigned long matches; ///< calls to match
+		double last_seconds; ///< time spent in the last match
+		double total_seconds, max_seconds; ///< over all matches
+		unsigned long coarse_scores, fine_scores; ///< sweep placements scored in the last match
+		double last_score; ///< 0-1, fraction of the best possible score
+		double table_seconds; ///< time spent in the last set_map
+		stats_t() :matches(0), last_seconds(0), total_seconds(0), max_seconds(0),
+			coarse_scores(0), fine_scores(0), last_score(0), table_seconds(0) {}
+	} stats;
+
+	scan_matcher()
+		:search_distance(50.0), search_angle(10.0), angle_step(1.0), min_score(0.2), min_points(60) {}
+
+	/** Rebuild the score tables from this map.  Call this every few sweeps. */
+	void set_map(const occupancy_grid &grid);
+
+	/** Find the pose near guess where this sweep best lines up with the map.
+	  Returns false (and leaves result alone) if the match is too weak to trust. */
+	bool match(const neato_scan_t &scan,const sensor_t &neato,const pose2d &guess,pose2d &result);
+
+private:
+	scan_match_table table;
+	neato_points_t points; ///< scratch: sweep at the current angle
+	std::vector<int> cells; ///< scratch: table index of each point, for each angle
+	class candidate_t {
+	public:
+		int score; ///< coarse score
+		int angle, dx, dy; ///< angle number and cell offset of the block
+		bool operator<(const candidate_t &c) const { return score>c.score; } // best first
+	};
+	std::vector<candidate_t> candidates; ///< scratch: coarse blocks worth a closer look
+
+	/// Score a sweep's cells (n of them) in this table, offset by dx,dy cells.
+	int score(const unsigned char *t,const int *cell,int n,int dx,int dy) const;
+};
+
+/**
+ Fuses scan matches (fast, but they drift as the map drifts) with bullseye
+ camera fixes (slow, late, and sometimes missing, but absolute).  Each scan
+ match moves the pose directly; each camera fix pulls the pose toward the
+ camera by camera_gain of the difference, measured against where we thought
+ we were when the camera's frame was captured, so a late fix still lands right.
+*/
+class pose_estimator {
+public:
+	pose2d pose; ///< best estimate
+	double pose_time; ///< cyberalaska::time() of the last update, or 0 if never
+	double camera_gain; ///< fraction of each camera fix's correction to apply (default 0.5)
+	unsigned long scan_updates, scan_rejects, camera_fixes;
+
+	pose_estimator()
+		:pose_time(0.0), camera_gain(0.5), scan_updates(0), scan_rejects(0), camera_fixes(0),
+		 history_next(0), history_count(0) {}
+
+	/** Match this sweep against the map near our current pose.
+	  Returns false if the match was rejected (the pose stays put). */
+	bool scan_update(scan_matcher &matcher,const neato_scan_t &scan,const sensor_t &neato,double scan_time);
+
+	/** Add a camera fix, in bullseye_keeper's format: x and y in centimeters,
+	  z in radians counterclockwise; capture_time is when its frame was taken.
+	  The first fix sets the pose outright. */
+	void camera_fix(const vec3 &fix,double capture_time);
+
+	/** Copy our pose into this robot (and stamp it). */
+	void apply(robot &r) const {
+		r.location.x=pose.x; r.location.y=pose.y;
+		r.angle=pose.angle;
+		r.update_timestamp(pose_time);
+	}
+
+private:
+	enum {history_size=32}; ///< 6 seconds of sweeps at 5 Hz
+	pose2d history[history_size]; ///< recent poses, for late camera fixes
+	double history_time[history_size];
+	int history_next, history_count;
+	void remember(void);
+};
+
+};
+
+#endif
@@ -19,6 +19,15 @@ Packet structure:
 	- 4-bit checksum: equal to low 4 bits of (real_length+command_code+sumpay+(sumpay>>4)),
 		where sumpay is the 8-bit arithmetic sum of the bytes in the payload.
 
+Receiving:
+	- Bytes can come one at a time (Arduino) or as a whole span (PC), through
+	  the same state machine.
+	- Packets that arrive whole inside a span are handed back in place, with
+	  no copy; the rest are assembled in one receive arena that only grows.
+	- On a bad checksum, the bytes after the bad start byte are scanned again,
+	  so a noise byte that looked like a start code doesn't eat the packets
+	  behind it.
+
 Current robot command codes:
 	0xE: Error, sent from robot to PC (for firmware debugging)
 	0xD: Depth data request/response, for Neato laser distance sensor
@@ -37,7 +46,7 @@ Current robot command codes:
 #define __CYBERALASKA_SERIAL_APACKET__H
 
 #include <stdlib.h> /* for realloc and free */
-#include <string.h> /* for memcpy */
+#include <string.h> /* for memcpy and memmove */
 
 /** Abstract representation for on-the-wire serial port. 
   Obvious implementations 
@@ -99,15 +108,16 @@ public:
 	A_packet_formatter(serial_port &serial_) 
 		:serial(serial_) 
 	{
+		read_raw=NULL; read_raw_size=0;
 		reset();
-		read_data_long=read_data=NULL;
 	}
 	/// Reset packet receive state to start-of-packet
 	void reset() {
 		read_state=0; read_length=0; read_index=0; read_sumpay=0;
+		replay_index=replay_end=0; resyncing=0;
 	}
 	~A_packet_formatter() {
-		if (read_data_long) { free(read_data_long); read_data_long=NULL; }
+		if (read_raw) { free(read_raw); read_raw=NULL; }
 	}
 	
 /* Packet send */
@@ -142,7 +152,8 @@ public:
 	   This function processes serial bytes and reassembles packets.
 	 Returns 0 if no data is available to read right now.
 	 Returns -1 if data was readable, but no packet is ready yet (call again).
-	 Fills out the packet and returns +1 if we received a correctly formatted packet.
+	 Fills out the packet and returns +1 if we received a packet; p.valid
+	 is 0 if it failed its checksum, and p.data is only good until the next call.
 	 
 	 Idiomatic call code:
 	 	A_packet p;
@@ -151,9 +162,84 @@ public:
 	 	}
 	*/
 	int read_packet(A_packet &p) {
+		if (replay_index<replay_end) return read_byte(read_raw[replay_index++],p);
 		if (!serial.available()) return 0; // no data to read
 		int c=serial.read(); // else read next byte
 		if (c==-1) return 0; // (hmmm, why did available return true then?)
+		return read_byte(c,p);
+	}
+	
+	/**
+	   Same as above, but takes bytes already in memory (like a buffered
+	 serial port's peek span) instead of reading the port one byte at a time.
+	 Advances data past the bytes it used; stops right after a packet's end byte.
+	 Returns 0 if data==end, -1 if all the bytes went into a partial packet,
+	 or +1 if p was filled out (call again for any bytes after it).
+	 
+	 A packet that arrived whole inside the span is not copied: p.data points
+	 into the span itself, so keep the span's bytes until you're done with p.
+	 
+	 Idiomatic call code:
+	 	const unsigned char *data=..., *end=data+length;
+	 	while (data<end) {
+	 		if (+1==apak.read_packet(p,data,end)) handle(p);
+	 	}
+	*/
+	int read_packet(A_packet &p,const unsigned char *&data,const unsigned char *end) {
+		if (data>=end && replay_index>=replay_end) return 0;
+		while (true) {
+			while (replay_index<replay_end) // bytes left over from a resync go first
+				if (+1==read_byte(read_raw[replay_index++],p)) return +1;
+			if (data>=end) return -1;
+			if (read_state==0 && +1==read_in_place(p,data,end)) return +1;
+			if (+1==read_byte(*data++,p)) return +1;
+		}
+	}
+	
+private:
+	/// Zero-copy path: if a whole, correct packet starts right at data,
+	///   point p at its payload in place, advance data past it, and return +1.
+	///   Otherwise return 0 and leave data alone (read_byte sorts it out).
+	int read_in_place(A_packet &p,const unsigned char *&data,const unsigned char *end) {
+		const unsigned char *start=data;
+		if ((start[0]&0xf0) != 0xa0) return 0;
+		int length=start[0]&0x0f, head=1;
+		if (length>=max_short_length) {
+			if (end-start<2) return 0;
+			length=start[1]; head=2;
+		}
+		if (end-start<head+length+1) return 0; // packet continues past the span
+		const unsigned char *payload=start+head;
+		int sumpay=0;
+		for (int i=0;i<length;i++) sumpay+=payload[i];
+		int c=payload[length];
+		int command=c>>4;
+		if ((0xf&c)!=(0xf&(length+command+sumpay+(sumpay>>4)))) return 0;
+		p.valid=1;
+		p.command=command;
+		p.length=length;
+		p.data=payload;
+		data=payload+length+1;
+		resyncing=0;
+		return +1;
+	}
+	
+	/// Make sure the receive arena holds at least this many bytes.
+	///   It only ever grows, so steady traffic never reallocates.
+	bool read_raw_reserve(int size) {
+		if (size<=read_raw_size) return true;
+		unsigned char *bigger=(unsigned char *)realloc(read_raw,size);
+		if (bigger==NULL) return false;
+		read_raw=bigger; read_raw_size=size;
+		return true;
+	}
+	
+	/// Run one received byte through the packet state machine.
+	///   Returns +1 if that byte finished a packet, -1 if not.
+	///   Everything after the start byte is kept in the arena (length byte,
+	///   payload, end byte), so if the checksum fails we can scan those bytes
+	///   again for the real start of the next packet instead of losing it.
+	int read_byte(int c,A_packet &p) {
 		p.valid=0;
 		
 		enum {
@@ -169,44 +255,62 @@ public:
 				read_index=0;
 				read_sumpay=0;
 				read_length=c&0x0f;
+				read_payload=0;
 				if (read_length>=max_short_length)
 				{
 					read_state=STATE_LENGTH; // need real length byte
+					read_payload=1;
 				}
 				else if (read_length>0) {
 					read_state=STATE_PAYLOAD; // short payload data
-					read_data=&read_data_short[0];
 				} else { // length==0, no payload
 					read_state=STATE_END;
 				}
+				if (!read_raw_reserve(read_payload+read_length+1))
+					read_state=STATE_START; // out of memory--drop this packet
 			}
 			break;
 		case STATE_LENGTH: /* (optional) length byte */
 			read_length=c;
-			read_data_long=(unsigned char *)realloc(read_data_long,read_length);
-			read_data=read_data_long;
-			read_state=STATE_PAYLOAD;
+			if (!read_raw_reserve(read_payload+read_length+1)) {
+				read_state=STATE_START; // out of memory--drop this packet
+				break;
+			}
+			read_raw[read_index++]=c;
+			read_state=(read_length>0)?STATE_PAYLOAD:STATE_END;
 			break;
 		case STATE_PAYLOAD: /* payload data */
 			read_sumpay+=c;
-			read_data[read_index]=c;
-			read_index++;
-			if (read_index>=read_length) { // that was last byte of payload!
+			read_raw[read_index++]=c;
+			if (read_index>=read_payload+read_length) { // that was last byte of payload!
 				read_state=STATE_END;
 			}
 			break;
 		case STATE_END: /* end byte */
 			{
 			read_state=STATE_START;
+			read_raw[read_index++]=c;
 			p.command=c>>4;
 			int checksum=0xf&(read_length+p.command+read_sumpay+(read_sumpay>>4));
 			int checkread=0xf&(c);
 			if (checkread==checksum) { /* checksum match--valid packet! */
 				p.valid=1;
 				p.length=read_length;
-				p.data=(const unsigned char *)read_data;
+				p.data=(const unsigned char *)read_raw+read_payload;
+				resyncing=0;
+				return +1;
 			}
-			return +1; // let receiver know packet arrived (even if it's bad)
+			/* Bad checksum: the start byte was noise, or bytes got dropped.
+			   Scan the bytes after it again (ahead of any bytes still waiting
+			   from an earlier resync).  Writes into the arena never pass the
+			   replay position, so this can all happen in place. */
+			if (replay_index<replay_end)
+				memmove(read_raw+read_index,read_raw+replay_index,replay_end-replay_index);
+			replay_end=read_index+(replay_end-replay_index);
+			replay_index=0;
+			if (resyncing) return -1; // already told them about this mess
+			resyncing=1;
+			return +1; // let receiver know a bad packet arrived
 			}
 			break;
 		default: /* only way to get here is memory corruption!  Reset. */ 
@@ -214,18 +318,20 @@ public:
 		};
 		return -1; // no packet was received
 	}
-private:
+	
 	// Private send buffers:
 	unsigned char write_data[max_short_length+2]; // short outgoing packets are assembled here
 	
 	// Private receiver state:
 	unsigned char read_state; // part of message we next expect
 	int read_length; // length of payload bytes we expect
-	int read_index; // location in payload to next receive
+	int read_payload; // arena index where the payload starts (1 if there's a length byte)
+	int read_index; // arena index to next receive into
 	int read_sumpay; // sum of payload bytes so far
-	unsigned char read_data_short[max_short_length]; ///< Short packets go here
-	unsigned char *read_data_long; ///< malloc'd long packets, or NULL
-	unsigned char *read_data; ///< current target for read data
+	unsigned char resyncing; // 1 if we've reported a bad packet and haven't seen a good one since
+	unsigned char *read_raw; ///< malloc'd receive arena: bytes after the start byte
+	int read_raw_size; ///< bytes allocated for read_raw
+	int replay_index, replay_end; ///< arena bytes still to be scanned again after a bad checksum
 };
 
 
@@ -0,0 +1,48 @@
+/**
+ Frames A-packets (see serial_packet.h) for an msl::serial_thread, so a PC-side
+ robot can have its serial bytes decoded on an I/O thread.  This lives apart
+ from serial_packet.h because that file is shared with the Arduino firmware.
+
+ Public Domain
+*/
+#ifndef __CYBERALASKA_SERIAL_PACKET_DECODER__H
+#define __CYBERALASKA_SERIAL_PACKET_DECODER__H
+
+#include "msl/serial_thread.hpp"
+#include "cyberalaska/serial_packet.h"
+
+class A_packet_decoder : public msl::serial_decoder {
+public:
+	A_packet_decoder() :formatter(port) {}
+
+	/// Decode the next packet out of these bytes (corrupt packets come out with valid false)
+	bool decode(const uint8_t *&data,const uint8_t *end,msl::serial_packet &packet) {
+		A_packet p;
+		if (+1!=formatter.read_packet(p,data,end)) return false;
+		packet.command=p.command;
+		packet.valid=p.valid;
+		if (p.valid) packet.data.assign((const char *)p.data,p.length);
+		else packet.data.clear();
+		return true;
+	}
+
+	void reset() { formatter.reset(); }
+
+	/// View a decoded packet as an A_packet (pointing into packet's data)
+	static A_packet to_A_packet(const msl::serial_packet &packet) {
+		A_packet p;
+		p.valid=packet.valid;
+		p.command=packet.command;
+		p.length=packet.data.size();
+		p.data=(const unsigned char *)packet.data.data();
+		return p;
+	}
+
+private:
+	/// We only ever hand the formatter bytes, so it never touches its port.
+	class no_port {};
+	no_port port;
+	A_packet_formatter<no_port> formatter;
+};
+
+#endif
@@ -6,6 +6,7 @@
 #include "cyberalaska/uav_field_drawing.h"
 #include "cyberalaska/uav_control.h"
 #include "cyberalaska/uav_control_JSON.h"
+#include "cyberalaska/uav_control_binary.h"
 #include "osl/webservice.h"
 #include "msl/time_util.hpp"
 #include <iostream>
@@ -110,13 +111,21 @@ int throw_on_skt_abort(int errCode,const char *msg)
      'S': simulate only (default)
      'L': talk with local server
      'W': talk with web server
+     'B': talk with local server's binary port (one persistent connection)
 */
+// Field JSON buffer, reused across exchanges (delta encoding needs 
+//  a server that applies it with AK_uav_field_apply_JSON, so it's off)
+static AK_uav_field_JSON_writer field_writer;
+
+// Persistent binary connection, or 0 if we need to (re)connect
+static AK_uav_binary_client *binary_client=0;
+const int binary_port=8081;
+
 void AK_uav_server(char serverMode)
 {
 	if (serverMode=='S') { simulator_mode=true; return; } // nothing to do
 	simulator_mode=false;
 
-	osl::network_progress p;
 	std::string host="localhost";
 	int port=8080;
 	if (serverMode=='W') host="powerwall5.cs.uaf.edu";
@@ -125,18 +134,32 @@ void AK_uav_server(char serverMode)
 
 	skt_set_abort(throw_on_skt_abort);
 	try {
-		osl::http_connection net(host,p,port);
-
-		// Send piloting command to server
-		std::string req_prefix="/uav/0/pilot?cmd=";
-		std::string req_suffix=url_escape(JSON_from_AK_uav_field(control_output));
-		net.send_get(req_prefix+req_suffix);
-		std::string response=net.receive();
-
 		// Get sensor data back from the server.
 		//  Save local stuff like mouse position (what's it doing in there anyway?)
 		AK_uav_control_sensors bak=sim.sensors;
-		sim.sensors=AK_uav_control_sensors_from_JSON(response);
+
+		if (serverMode=='B') { // persistent binary frames
+			try {
+				if (!binary_client) binary_client=new AK_uav_binary_client(host,binary_port);
+				binary_client->exchange(control_output,sim.sensors);
+			} catch (...) { // reconnect next time
+				delete binary_client; binary_client=0;
+				throw;
+			}
+		}
+		else { // one HTTP request per exchange
+			osl::network_progress p;
+			osl::http_connection net(host,p,port);
+
+			// Send piloting command to server
+			std::string req_prefix="/uav/0/pilot?cmd=";
+			std::string req_suffix=url_escape(field_writer.write(control_output));
+			net.send_get(req_prefix+req_suffix);
+			std::string response=net.receive();
+
+			sim.sensors=AK_uav_control_sensors_from_JSON(response);
+			field_writer.ack(); // server has this field now
+		}
 
 		if (sim.sensors.state!="mission") // sanitize sensor values
 			for (int dir=0;dir<4;dir++)
@@ -152,7 +175,7 @@ void AK_uav_server(char serverMode)
 		}
 
 		if (control_output.state=="setup") { // zero out any stored locations
-			control_output.hikers=control_output.obstacles=std::vector<vec2>();
+			control_output.clear_lists();
 		}
 		skt_error_count=0; // it worked!
 	}
@@ -58,6 +58,8 @@ void AK_uav_land();
      'S': simulate only (default)
      'L': talk with local server
      'N': talk with network server
+     'B': talk with local server over the persistent binary channel
+          (see uav_control_binary.h)
 */
 void AK_uav_server(char serverMode);
 
@@ -5,43 +5,41 @@
 */
 #include <stdexcept>
 #include "cyberalaska/uav_control_JSON.h"
-#include "json/json.h"
+#include "msl/json.hpp"
 
 
+/**** JSON input: one pass msl::json_document parse, then read straight out of its DOM *****/
 
-Json::Value parse_JSON(const std::string &jsonString)
+void parse_JSON(const std::string &jsonString,msl::json_document &doc)
 {
-	Json::Value root;
-	Json::Reader reader;
-	if (!reader.parse(jsonString,root)) throw std::runtime_error("Error parsing JSON: "+reader.getFormattedErrorMessages());
-	return root;
+	if (!doc.parse(jsonString)) throw std::runtime_error("Error parsing JSON: "+doc.error()+" at byte "+msl::to_string(doc.error_position()));
 }
 
 
-void from_JSON(Json::Value &node,std::string &v) {
-	v=node.asString();
+void from_JSON(const msl::json_value &node,std::string &v) {
+	v=node.as_string();
 }
-void from_JSON(Json::Value &node,float &v) {
-	v=node.asFloat();
+void from_JSON(const msl::json_value &node,float &v) {
+	v=node.as_number();
 }
-void from_JSON(Json::Value &node,const char *name,float &v) {
-	v=node.get(name,-999).asFloat();
+void from_JSON(const msl::json_value &node,const char *name,float &v) {
+	v=node[name].as_number(-999);
 }
 
-void from_JSON(Json::Value &node,vec2 &v) {
+void from_JSON(const msl::json_value &node,vec2 &v) {
 	from_JSON(node,"x",v.x);
 	from_JSON(node,"y",v.y);
 }
 
 template <class T>
-void from_JSON(Json::Value &node,std::vector<T> &v) {
-	if (!node.isArray()) return;
+void from_JSON(const msl::json_value &node,std::vector<T> &v) {
+	if (!node.is_array()) return;
 	v.resize(node.size());
-	for (int i=0;i<node.size();i++)
+	for (unsigned int i=0;i<node.size();i++)
 		from_JSON(node[i],v[i]);
 }
 
-void from_JSON(Json::Value &root,AK_uav_field &v) {
+void from_JSON(const msl::json_value &root,AK_uav_field &v) {
 	from_JSON(root["state"],v.state); 
 	from_JSON(root["uav"],v.uav);
 	from_JSON(root["obstacles"],v.obstacles);
@@ -51,75 +49,154 @@ void from_JSON(Json::Value &root,AK_uav_field &v) {
 AK_uav_field AK_uav_field_from_JSON(const std::string &jsonString)
 {
 	AK_uav_field out;
-	Json::Value root=parse_JSON(jsonString);
-	from_JSON(root,out);
+	msl::json_document doc;
+	parse_JSON(jsonString,doc);
+	from_JSON(doc.root(),out);
 	return out;
 }
 
-void from_JSON(Json::Value &root,AK_uav_control_sensors &uav) {
+void from_JSON(const msl::json_value &root,AK_uav_control_sensors &uav) {
 	from_JSON(root["state"],uav.state); 
 	from_JSON(root["x"],uav.x); 
 	from_JSON(root["y"],uav.y);
+	msl::json_value obstacle=root["obstacle"], hiker=root["hiker"];
 	for (int dir=0;dir<n_directions;dir++) {
-		from_JSON(root["obstacle"][dir],uav.obstacle[dir]);
-		from_JSON(root["hiker"][dir],uav.hiker[dir]);
+		from_JSON(obstacle[dir],uav.obstacle[dir]);
+		from_JSON(hiker[dir],uav.hiker[dir]);
 	}
 }
 AK_uav_control_sensors  AK_uav_control_sensors_from_JSON (const std::string &jsonString)
 {
 	AK_uav_control_sensors uav;
-	Json::Value root=parse_JSON(jsonString);
-	from_JSON(root,uav);
+	msl::json_document doc;
+	parse_JSON(jsonString,doc);
+	from_JSON(doc.root(),uav);
 	return uav;
 }
 
-/**** JSON output *****/
+/**** JSON output: appended straight into an msl::json_writer *****/
 
-Json::Value make_JSON(const std::string &v) {
-	return v;
+void make_JSON(msl::json_writer &w,const vec2 &v) {
+	w.start_object();
+	w.key("x"); w.value(v.x);
+	w.key("y"); w.value(v.y);
+	w.end_object();
 }
-Json::Value make_JSON(const vec2 &v) {
-	Json::Value ret;
-	ret["x"]=v.x; ret["y"]=v.y;
-	return ret;
-}
-template <class T>
-Json::Value make_JSON(const std::vector<T> &v) {
-	Json::Value ret;
-	for (unsigned int i=0;i<v.size();i++) {
-		ret[i]=make_JSON(v[i]);
-	}
-	return ret;
+void make_JSON(msl::json_writer &w,const vec2 *v,unsigned int n) {
+	w.start_array();
+	for (unsigned int i=0;i<n;i++)
+		make_JSON(w,v[i]);
+	w.end_array();
 }
 
-Json::Value make_JSON(const AK_uav_field &out) {
-	Json::Value ret;
-	ret["state"]=make_JSON(out.state);
-	ret["uav"]=make_JSON(out.uav);
-	ret["obstacles"]=make_JSON(out.obstacles);
-	ret["hikers"]=make_JSON(out.hikers);
-	return ret;
+void JSON_from_AK_uav_field(const AK_uav_field &out,msl::json_writer &w)
+{
+	w.start_object();
+	w.key("state"); w.value(out.state);
+	w.key("uav"); make_JSON(w,out.uav);
+	w.key("obstacles"); make_JSON(w,out.obstacles.empty()?0:&out.obstacles[0],out.obstacles.size());
+	w.key("hikers"); make_JSON(w,out.hikers.empty()?0:&out.hikers[0],out.hikers.size());
+	w.end_object();
 }
 
 std::string JSON_from_AK_uav_field(const AK_uav_field &out)
 {
-	Json::Value root=make_JSON(out);
-	return Json::FastWriter().write(root);
+	msl::json_writer w;
+	JSON_from_AK_uav_field(out,w);
+	return w.str();
+}
+
+void JSON_from_AK_uav_control_sensors(const AK_uav_control_sensors &uav,msl::json_writer &w)
+{
+	w.start_object();
+	w.key("state"); w.value(uav.state);
+	w.key("x"); w.value(uav.x);
+	w.key("y"); w.value(uav.y);
+	w.key("obstacle"); w.start_array();
+	for (int dir=0;dir<n_directions;dir++) w.value(uav.obstacle[dir]);
+	w.end_array();
+	w.key("hiker"); w.start_array();
+	for (int dir=0;dir<n_directions;dir++) w.value(uav.hiker[dir]);
+	w.end_array();
+	w.end_object();
 }
 
 std::string JSON_from_AK_uav_control_sensors (const AK_uav_control_sensors &uav)
 {
-	Json::Value root;
-	root["state"]=uav.state;
-	root["x"]=uav.x; root["y"]=uav.y;
-	for (int dir=0;dir<n_directions;dir++) {
-		root["obstacle"][dir]=uav.obstacle[dir];
-		root["hiker"][dir]=uav.hiker[dir];
+	msl::json_writer w;
+	JSON_from_AK_uav_control_sensors(uav,w);
+	return w.str();
+}
+
+
+/**** Delta encoded field writer *****/
+
+void AK_uav_field_JSON_writer::write_list(const char *name,const char *from_name,const std::vector<vec2> &list,unsigned int edits,const list_mark &acked)
+{
+	unsigned int from=0;
+	// Only appended to since the ack: the receiver still has our first acked.size entries
+	if (delta && acked.valid && acked.edits==edits && list.size()>=acked.size) from=acked.size;
+	
+	writer.key(name);
+	make_JSON(writer,list.empty()?0:&list[0]+from,list.size()-from);
+	if (delta) {
+		writer.key(from_name); writer.value((int)from);
+	}
+}
+
+const std::string &AK_uav_field_JSON_writer::write(const AK_uav_field &out)
+{
+	writer.clear();
+	writer.start_object();
+	writer.key("state"); writer.value(out.state);
+	writer.key("uav"); make_JSON(writer,out.uav);
+	write_list("obstacles","obstacles_from",out.obstacles,out.obstacles_edits,acked_obstacles);
+	write_list("hikers","hikers_from",out.hikers,out.hikers_edits,acked_hikers);
+	writer.end_object();
+	
+	if (delta) { // remember what this write described, for ack()
+		sent_obstacles=list_mark(out.obstacles.size(),out.obstacles_edits);
+		sent_hikers=list_mark(out.hikers.size(),out.hikers_edits);
 	}
-	return Json::FastWriter().write(root);
+	return writer.str();
 }
 
+void AK_uav_field_JSON_writer::ack()
+{
+	acked_obstacles=sent_obstacles;
+	acked_hikers=sent_hikers;
+}
 
+void AK_uav_field_JSON_writer::reset()
+{
+	acked_obstacles=list_mark();
+	acked_hikers=list_mark();
+}
 
 
+/**** Delta encoded field reader *****/
 
+static void apply_list(const msl::json_value &root,const char *name,std::vector<vec2> &list,unsigned int &edits)
+{
+	msl::json_value entries=root[name];
+	if (!entries.is_array()) return;
+	
+	unsigned int from=(unsigned int)root[std::string(name)+"_from"].as_number(0);
+	if (from>list.size()) throw std::runtime_error("JSON delta for "+std::string(name)+" starts past the end of our list");
+	
+	if (from<list.size()) edits++; // overwriting entries we had
+	list.resize(from+entries.size());
+	for (unsigned int i=0;i<entries.size();i++)
+		from_JSON(entries[i],list[from+i]);
+}
+
+void AK_uav_field_apply_JSON(const std::string &jsonString,AK_uav_field &field)
+{
+	msl::json_document doc;
+	parse_JSON(jsonString,doc);
+	msl::json_value root=doc.root();
+	from_JSON(root["state"],field.state);
+	from_JSON(root["uav"],field.uav);
+	apply_list(root,"obstacles",field.obstacles,field.obstacles_edits);
+	apply_list(root,"hikers",field.hikers,field.hikers_edits);
+}
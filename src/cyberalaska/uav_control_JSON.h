@@ -8,6 +8,8 @@
 
 #include "uav_field.h"
 
+#include "msl/json.hpp"
+
 /** Convert structures to/from JSON */
 
 AK_uav_field  AK_uav_field_from_JSON (const std::string &jsonString);
@@ -16,6 +18,59 @@ AK_uav_control_sensors AK_uav_control_sensors_from_JSON(const std::string &jsonS
 std::string JSON_from_AK_uav_field (const AK_uav_field  &out);
 std::string JSON_from_AK_uav_control_sensors(const AK_uav_control_sensors &uav);
 
+/** Append JSON to a reusable writer instead of building a new string */
+void JSON_from_AK_uav_field(const AK_uav_field &out,msl::json_writer &writer);
+void JSON_from_AK_uav_control_sensors(const AK_uav_control_sensors &uav,msl::json_writer &writer);
+
+/**
+  Update field from JSON written by an AK_uav_field_JSON_writer, 
+  including delta encoded obstacle and hiker lists.
+*/
+void AK_uav_field_apply_JSON(const std::string &jsonString,AK_uav_field &field);
+
+/**
+  Writes AK_uav_field JSON into one buffer kept between calls, 
+  so a writer reused every control tick doesn't allocate.
+
+  With delta encoding on, the obstacle and hiker lists only carry 
+  entries added since the last ack(), and "obstacles_from" and 
+  "hikers_from" give the list index of the first entry sent.  If a 
+  list was edited other than by appending since (its obstacles_edits 
+  or hikers_edits count moved), that whole list goes out again from 0.
+  Either way only the entries sent are touched, so a tick costs the 
+  size of the delta, not of the lists.  The receiver needs to use 
+  AK_uav_field_apply_JSON, so delta encoding is off by default.
+*/
+class AK_uav_field_JSON_writer {
+public:
+	AK_uav_field_JSON_writer(bool delta_=false) :delta(delta_) {}
+	
+	/// Return JSON for this field, valid until the next write.
+	const std::string &write(const AK_uav_field &out);
+	
+	/// The receiver got the last write: later deltas start from there.
+	void ack();
+	
+	/// The receiver lost track: the next write sends everything.
+	void reset();
+	
+private:
+	/// A list's length and edit count, as of some write.
+	struct list_mark {
+		unsigned int size, edits;
+		bool valid; // false until the receiver has something
+		list_mark() :size(0), edits(0), valid(false) {}
+		list_mark(unsigned int size_,unsigned int edits_) :size(size_), edits(edits_), valid(true) {}
+	};
+	
+	msl::json_writer writer;
+	bool delta;
+	list_mark acked_obstacles, acked_hikers; // what the receiver has
+	list_mark sent_obstacles, sent_hikers; // what the last write described
+	
+	void write_list(const char *name,const char *from_name,const std::vector<vec2> &list,unsigned int edits,const list_mark &acked);
+};
+
 
 
 #endif
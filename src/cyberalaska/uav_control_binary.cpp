@@ -0,0 +1,180 @@
+/**
+  UAV control, binary framing for the client/server exchange.
+
+  Public Domain
+*/
+#include <stdexcept>
+#include "cyberalaska/uav_control_binary.h"
+#if defined(_WIN32)
+#  include <winsock.h> /* for TCP_NODELAY */
+#else
+#  include <netinet/tcp.h> /* for TCP_NODELAY */
+#endif
+
+/** Field state strings, in AK_uav_state_code order */
+static const char *AK_uav_state_names[]={"setup","prep","ready","mission","done"};
+static const int AK_uav_state_count=sizeof(AK_uav_state_names)/sizeof(AK_uav_state_names[0]);
+
+unsigned char AK_uav_state_code(const std::string &state) {
+	for (int i=0;i<AK_uav_state_count;i++)
+		if (state==AK_uav_state_names[i]) return i;
+	return AK_uav_state_unknown;
+}
+std::string AK_uav_state_name(unsigned char code) {
+	if (code<AK_uav_state_count) return AK_uav_state_names[code];
+	return ""; // unknown state
+}
+
+
+/** Size frame for a header plus this many payload bytes, fill in the header,
+    and return a pointer to the start of the payload. */
+static byte *AK_uav_frame_start(std::vector<byte> &frame,int type,unsigned int length) {
+	frame.resize(sizeof(AK_uav_frame_header)+length);
+	AK_uav_frame_header *h=(AK_uav_frame_header *)&frame[0];
+	h->magic=AK_uav_frame_magic;
+	h->version=AK_uav_frame_version;
+	h->type=type;
+	h->length=length;
+	return &frame[sizeof(AK_uav_frame_header)];
+}
+
+static void AK_uav_vec2_to_binary(const vec2 &v,AK_uav_vec2_v1 &b) {
+	b.x=(float)v.x; b.y=(float)v.y;
+}
+
+void AK_uav_frame_from_field(const AK_uav_field &field,std::vector<byte> &frame) {
+	unsigned int n_points=field.obstacles.size()+field.hikers.size();
+	byte *payload=AK_uav_frame_start(frame,AK_uav_frame_field,
+		sizeof(AK_uav_field_v1)+n_points*sizeof(AK_uav_vec2_v1));
+
+	memset(payload,0,sizeof(AK_uav_field_v1)); // zero padding
+	AK_uav_field_v1 *f=(AK_uav_field_v1 *)payload;
+	f->state=AK_uav_state_code(field.state);
+	AK_uav_vec2_to_binary(field.uav,f->uav);
+	f->n_obstacles=field.obstacles.size();
+	f->n_hikers=field.hikers.size();
+
+	AK_uav_vec2_v1 *points=(AK_uav_vec2_v1 *)(payload+sizeof(AK_uav_field_v1));
+	for (unsigned int i=0;i<field.obstacles.size();i++)
+		AK_uav_vec2_to_binary(field.obstacles[i],*points++);
+	for (unsigned int i=0;i<field.hikers.size();i++)
+		AK_uav_vec2_to_binary(field.hikers[i],*points++);
+}
+
+void AK_uav_frame_from_sensors(const AK_uav_control_sensors &sensors,std::vector<byte> &frame) {
+	byte *payload=AK_uav_frame_start(frame,AK_uav_frame_sensors,sizeof(AK_uav_sensors_v1));
+	memset(payload,0,sizeof(AK_uav_sensors_v1)); // zero padding
+	AK_uav_sensors_v1 *s=(AK_uav_sensors_v1 *)payload;
+	s->state=AK_uav_state_code(sensors.state);
+	s->x=sensors.x; s->y=sensors.y;
+	for (int dir=0;dir<n_directions;dir++) {
+		s->obstacle[dir]=sensors.obstacle[dir];
+		s->hiker[dir]=sensors.hiker[dir];
+	}
+}
+
+
+void AK_uav_field_from_payload(const std::vector<byte> &payload,AK_uav_field &field) {
+	if (payload.size()<sizeof(AK_uav_field_v1))
+		throw std::runtime_error("UAV binary field payload too short");
+	const AK_uav_field_v1 *f=(const AK_uav_field_v1 *)&payload[0];
+	unsigned int n_obstacles=f->n_obstacles, n_hikers=f->n_hikers;
+	if (n_obstacles>payload.size() || n_hikers>payload.size()
+	 || payload.size()<sizeof(AK_uav_field_v1)+(n_obstacles+n_hikers)*sizeof(AK_uav_vec2_v1))
+		throw std::runtime_error("UAV binary field payload too short for its lists");
+
+	field.state=AK_uav_state_name(f->state);
+	field.uav=vec2(f->uav.x,f->uav.y);
+
+	const AK_uav_vec2_v1 *points=(const AK_uav_vec2_v1 *)(&payload[0]+sizeof(AK_uav_field_v1));
+	field.obstacles_edits++; field.hikers_edits++; // overwritten in place
+	field.obstacles.resize(n_obstacles);
+	for (unsigned int i=0;i<n_obstacles;i++,points++)
+		field.obstacles[i]=vec2(points->x,points->y);
+	field.hikers.resize(n_hikers);
+	for (unsigned int i=0;i<n_hikers;i++,points++)
+		field.hikers[i]=vec2(points->x,points->y);
+}
+
+void AK_uav_sensors_from_payload(const std::vector<byte> &payload,AK_uav_control_sensors &sensors) {
+	if (payload.size()<sizeof(AK_uav_sensors_v1))
+		throw std::runtime_error("UAV binary sensor payload too short");
+	const AK_uav_sensors_v1 *s=(const AK_uav_sensors_v1 *)&payload[0];
+	sensors.state=AK_uav_state_name(s->state);
+	sensors.x=s->x; sensors.y=s->y;
+	for (int dir=0;dir<n_directions;dir++) {
+		sensors.obstacle[dir]=s->obstacle[dir];
+		sensors.hiker[dir]=s->hiker[dir];
+	}
+}
+
+
+int AK_uav_frame_recv(SOCKET s,std::vector<byte> &payload) {
+	AK_uav_frame_header h;
+	if (skt_recvN(s,&h,sizeof(h))!=0)
+		throw std::runtime_error("UAV binary connection closed");
+	if ((unsigned int)h.magic!=(unsigned int)AK_uav_frame_magic)
+		throw std::runtime_error("UAV binary frame has bad magic number");
+	if ((unsigned int)h.version<1)
+		throw std::runtime_error("UAV binary frame has bad version");
+	unsigned int length=h.length;
+	if (length>(unsigned int)AK_uav_frame_max_length)
+		throw std::runtime_error("UAV binary frame too long");
+
+	payload.resize(length);
+	if (length>0 && skt_recvN(s,&payload[0],length)!=0)
+		throw std::runtime_error("UAV binary connection closed mid-frame");
+	return h.type;
+}
+
+void AK_uav_frame_send(SOCKET s,const std::vector<byte> &frame) {
+	if (skt_sendN(s,&frame[0],frame.size())!=0)
+		throw std::runtime_error("UAV binary send failed");
+}
+
+void AK_uav_socket_nodelay(SOCKET s) {
+	int flag=1;
+	setsockopt(s,IPPROTO_TCP,TCP_NODELAY,(const char *)&flag,sizeof(flag));
+}
+
+
+AK_uav_binary_client::AK_uav_binary_client(const std::string &host,int port,int timeout_seconds)
+{
+	skt_init();
+	s=skt_connect(skt_lookup_ip(host.c_str()),port,timeout_seconds);
+	if (s==INVALID_SOCKET) throw std::runtime_error("Can't connect to UAV binary server "+host);
+	AK_uav_socket_nodelay(s);
+}
+AK_uav_binary_client::~AK_uav_binary_client() {
+	skt_close(s);
+}
+
+void AK_uav_binary_client::exchange(const AK_uav_field &out,AK_uav_control_sensors &in) {
+	AK_uav_frame_from_field(out,frame);
+	AK_uav_frame_send(s,frame);
+	if (AK_uav_frame_recv(s,payload)!=AK_uav_frame_sensors)
+		throw std::runtime_error("UAV binary server sent an unexpected frame type");
+	AK_uav_sensors_from_payload(payload,in);
+}
+
+
+AK_uav_binary_connection::AK_uav_binary_connection(SOCKET s_)
+	:s(s_)
+{
+	AK_uav_socket_nodelay(s);
+}
+AK_uav_binary_connection::~AK_uav_binary_connection() {
+	skt_close(s);
+}
+
+void AK_uav_binary_connection::receive(AK_uav_field &in) {
+	if (AK_uav_frame_recv(s,payload)!=AK_uav_frame_field)
+		throw std::runtime_error("UAV binary client sent an unexpected frame type");
+	AK_uav_field_from_payload(payload,in);
+}
+
+void AK_uav_binary_connection::send(const AK_uav_control_sensors &out) {
+	AK_uav_frame_from_sensors(out,frame);
+	AK_uav_frame_send(s,frame);
+}
+
@@ -0,0 +1,154 @@
+/**
+  UAV control, binary framing for the client/server exchange.
+
+  The JSON-over-HTTP exchange (uav_control_JSON.h) costs a TCP connect,
+  HTTP headers, and text parsing per round trip.  This is an optional
+  persistent alternative: one TCP connection carrying length-prefixed
+  frames, each a fixed-layout, versioned struct in network byte order.
+  The client sends an AK_uav_field frame, the server answers with an
+  AK_uav_control_sensors frame.  JSON stays for browsers.
+
+  Frame on the wire:
+  	AK_uav_frame_header (12 bytes)
+  	payload (header.length bytes)
+
+  Versions only ever append to a payload, so a reader takes the prefix
+  it knows and skips the rest; a payload shorter than the reader's
+  version needs is an error.
+
+  Public Domain
+*/
+#ifndef __CYBERALASKA_UAV_CONTROL_BINARY_H
+#define __CYBERALASKA_UAV_CONTROL_BINARY_H
+
+#include <vector>
+#include <string>
+#include <string.h> /* for memcpy */
+#include "cyberalaska/uav_field.h"
+#include "osl/socket.h"
+
+enum {
+	AK_uav_frame_magic=0x414B5556, // "AKUV"
+	AK_uav_frame_version=1, // what we write
+	AK_uav_frame_max_length=16*1024*1024, // anything longer is garbage
+
+	AK_uav_frame_field=1, // client to server: AK_uav_field_v1
+	AK_uav_frame_sensors=2 // server to client: AK_uav_sensors_v1
+};
+
+/** Network byte order float (IEEE bits in a Big32) */
+class BigFloat {
+	Big32 bits;
+public:
+	BigFloat() {}
+	BigFloat(float f) { set(f); }
+	operator float () const { unsigned int i=bits; float f; memcpy(&f,&i,sizeof(f)); return f; }
+	void set(float f) { unsigned int i; memcpy(&i,&f,sizeof(i)); bits=i; }
+};
+
+struct AK_uav_frame_header {
+	Big32 magic; // AK_uav_frame_magic
+	Big16 version; // AK_uav_frame_version of the sender
+	Big16 type; // AK_uav_frame_field or AK_uav_frame_sensors
+	Big32 length; // payload bytes after this header
+};
+
+/** Field state strings, as one byte (unknown states go as AK_uav_state_unknown) */
+enum {
+	AK_uav_state_setup=0,
+	AK_uav_state_prep=1,
+	AK_uav_state_ready=2,
+	AK_uav_state_mission=3,
+	AK_uav_state_done=4,
+	AK_uav_state_unknown=255
+};
+unsigned char AK_uav_state_code(const std::string &state);
+std::string AK_uav_state_name(unsigned char code);
+
+struct AK_uav_vec2_v1 {
+	BigFloat x, y;
+};
+
+/** AK_uav_field payload: this, then n_obstacles and n_hikers AK_uav_vec2_v1's */
+struct AK_uav_field_v1 {
+	byte state; // AK_uav_state_code
+	byte pad[3];
+	AK_uav_vec2_v1 uav;
+	Big32 n_obstacles;
+	Big32 n_hikers;
+};
+
+/** AK_uav_control_sensors payload (the mouse stays local, so it isn't sent) */
+struct AK_uav_sensors_v1 {
+	byte state; // AK_uav_state_code
+	byte pad[3];
+	BigFloat x, y;
+	BigFloat obstacle[n_directions];
+	BigFloat hiker[n_directions];
+};
+
+
+/** Replace frame with one whole frame (header and payload) for this value.
+    Reusing the same frame vector every tick reuses its memory. */
+void AK_uav_frame_from_field(const AK_uav_field &field,std::vector<byte> &frame);
+void AK_uav_frame_from_sensors(const AK_uav_control_sensors &sensors,std::vector<byte> &frame);
+
+/** Decode a payload.  Throws std::runtime_error if it's too short. */
+void AK_uav_field_from_payload(const std::vector<byte> &payload,AK_uav_field &field);
+void AK_uav_sensors_from_payload(const std::vector<byte> &payload,AK_uav_control_sensors &sensors);
+
+/** Block until one whole frame arrives on s, leaving its payload in payload.
+    Returns the frame type; throws std::runtime_error on a bad header or
+    a closed connection. */
+int AK_uav_frame_recv(SOCKET s,std::vector<byte> &payload);
+
+/** Send one whole frame, throws std::runtime_error on errors. */
+void AK_uav_frame_send(SOCKET s,const std::vector<byte> &frame);
+
+/** Turn off Nagle's algorithm, so small frames go out immediately. */
+void AK_uav_socket_nodelay(SOCKET s);
+
+
+/**
+  Client end of a persistent binary connection.
+  Network errors throw; make a new client to reconnect.
+*/
+class AK_uav_binary_client {
+public:
+	AK_uav_binary_client(const std::string &host,int port,int timeout_seconds=10);
+	~AK_uav_binary_client();
+
+	/// Send our field, and wait for the server's sensor values.
+	void exchange(const AK_uav_field &out,AK_uav_control_sensors &in);
+
+private:
+	SOCKET s;
+	std::vector<byte> frame, payload;
+	AK_uav_binary_client(const AK_uav_binary_client &copy); // not copyable
+	void operator=(const AK_uav_binary_client &copy);
+};
+
+/**
+  Server end of one accepted binary connection (the server owns the
+  listening socket and decides which thread services which connection).
+*/
+class AK_uav_binary_connection {
+public:
+	/// Takes ownership of s, from skt_accept.
+	AK_uav_binary_connection(SOCKET s);
+	~AK_uav_binary_connection();
+
+	/// Wait for the client's next field.  Throws when the client goes away.
+	void receive(AK_uav_field &in);
+
+	/// Answer with our sensor values.
+	void send(const AK_uav_control_sensors &out);
+
+private:
+	SOCKET s;
+	std::vector<byte> frame, payload;
+	AK_uav_binary_connection(const AK_uav_binary_connection &copy); // not copyable
+	void operator=(const AK_uav_binary_connection &copy);
+};
+
+#endif
@@ -85,7 +85,8 @@ void AK_uav_land()
     Obstacles closer than one grid cell apart are merged. */
 void AK_add_obstacle(float x,float y)
 {
-	merge_into_list(vec2(x,y),control_output.obstacles);
+	if (merge_into_list(vec2(x,y),control_output.obstacles))
+		control_output.obstacles_edits++; // moved (or deleted) old entries
 }
 
 
@@ -93,7 +94,8 @@ void AK_add_obstacle(float x,float y)
     Hikers closer than one grid cell apart are merged. */
 void AK_add_hiker(float x,float y)
 {
-	merge_into_list(vec2(x,y),control_output.hikers);
+	if (merge_into_list(vec2(x,y),control_output.hikers))
+		control_output.hikers_edits++;
 }
 
 
@@ -122,7 +124,7 @@ void AK_uav_create_field(AK_uav_field &field,int sim_seed_ID)
 	srand(sim_seed_ID);
 	field.state="setup";
 	field.uav=vec2(0.0,0.0); // takeoff position
-	field.hikers=field.obstacles=std::vector<vec2>(); // clear lists
+	field.clear_lists();
 
 	int nobs=2;
 	for (int o=0;o<nobs;o++) // obstacles
@@ -31,10 +31,19 @@ struct AK_uav_field {
 	std::vector<vec2> obstacles; // detected obstacles (nearby obstacles are merged before entering this list)
 	std::vector<vec2> hikers; // detected hikers
 	
-	AK_uav_field() { empty(); }
+	/* Count changes to each list other than appending (merges, clears, overwrites),
+	   so a delta writer can tell its acked prefix is still there without rereading it.
+	   Anything that edits a list in place must bump its count. */
+	unsigned int obstacles_edits, hikers_edits;
+	
+	AK_uav_field() :obstacles_edits(0), hikers_edits(0) { empty(); }
 	void empty() {
 		state="setup"; uav=vec2(0,0); 
+		clear_lists();
+	}
+	void clear_lists() {
 		obstacles=hikers=std::vector<vec2>(); // empty lists
+		obstacles_edits++; hikers_edits++;
 	}
 };
 
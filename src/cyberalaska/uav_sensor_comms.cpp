@@ -11,21 +11,19 @@
 
 UAV_sensor_comms::UAV_sensor_comms(const std::string &portName,int baud)
 	:msl::serial(portName,baud),
-	state(HEADER),
-	crc(0),filtered_data{0,0,0,0},filter_timer(msl::millis()+filter_update_time)
+	filtered_data{0,0,0,0},filter_timer(msl::millis()+filter_update_time)
 {
 	for(unsigned int ii=0;ii<num_sensors();++ii)
 		unfiltered_data.push_back({});
 }
 
 
-void UAV_sensor_comms::update()
+bool UAV_sensor_decoder::decode(const uint8_t *&data,const uint8_t *end,msl::serial_packet &packet)
 {
-	msl::serial &port=*this; // silly hack; port should maybe be a member
-	uint8_t temp;
-
-	while(port.available()>0&&port.read(&temp,1)==1)
+	while(data<end)
 	{
+		uint8_t temp=*data++;
+
 		if(state==HEADER&&temp=='m')
 		{
 			crc=0x00;
@@ -37,24 +35,45 @@ void UAV_sensor_comms::update()
 			buffer+=temp;
 			crc^=temp;
 
-			if(buffer.size()>=4)
+			if(buffer.size()>=UAV_SENSOR_COMMS_NUM_SENSORS)
 				state=CRC;
 		}
 		else if(state==CRC)
 		{
-			if(crc==temp) // crc matches!
+			packet.command='m';
+			packet.valid=(crc==temp); // crc matches!
+			packet.data=buffer;
+
+			state=HEADER;
+			buffer="";
+			crc=0x00;
+			return true;
+		}
+	}
+	return false;
+}
+
+void UAV_sensor_comms::update()
+{
+	msl::serial &port=*this; // silly hack; port should maybe be a member
+
+	while(port.fill()>0) // one read per batch of bytes, not one per byte
+	{
+		const uint8_t *start;
+		unsigned int size=port.peek(start);
+		const uint8_t *data=start;
+		while(decoder.decode(data,start+size,packet))
+		{
+			if(packet.valid)
 			{
 				for(unsigned int ii=0;ii<num_sensors();++ii)
-					unfiltered_data[ii].push_back((int)buffer[ii]);
+					unfiltered_data[ii].push_back((int)packet.data[ii]);
 			}
 			else {
 				std::cout<<"UAV sensor CRC ERROR!\n";
 			}
-
-			state=HEADER;
-			buffer="";
-			crc=0x00;
 		}
+		port.consume(size);
 	}
 
 	if(msl::millis()>=filter_timer)
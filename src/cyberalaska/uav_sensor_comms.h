@@ -6,12 +6,35 @@
 #ifndef __CYBERALASKA_UAV_SENSOR_COMMS_H
 #define __CYBERALASKA_UAV_SENSOR_COMMS_H
 #include "msl/serial.hpp"
+#include "msl/serial_thread.hpp"
 #include <string>
 #include <vector>
 
 #define UAV_SENSOR_COMMS_NUM_SENSORS 4
 
 
+/**
+ Frames the Arduino's 'm' sensor packets (header, one byte per sensor, XOR CRC)
+ for UAV_sensor_comms or an msl::serial_thread.
+*/
+class UAV_sensor_decoder : public msl::serial_decoder {
+public:
+	bool decode(const uint8_t *&data,const uint8_t *end,msl::serial_packet &packet);
+	void reset() { state=HEADER; buffer=""; crc=0x00; }
+
+private:
+	enum state_t
+	{
+		HEADER,
+		DATA,
+		CRC
+	};
+
+	state_t state=HEADER;
+	uint8_t crc=0x00;
+	std::string buffer; // incoming (unchecked) data
+};
+
 /**
  Reads data from UAV over serial port.
 */
@@ -35,16 +58,8 @@ public:
 	}
 
 private:
-	enum state_t
-	{
-		HEADER,
-		DATA,
-		CRC
-	};
-
-	state_t state=HEADER;
-	uint8_t crc=0x00;
-	std::string buffer; // incoming (unchecked) data
+	UAV_sensor_decoder decoder;
+	msl::serial_packet packet; // last decoded packet (reused)
 	std::vector<std::vector<float>> unfiltered_data;
 	float filtered_data[UAV_SENSOR_COMMS_NUM_SENSORS];
 	unsigned long filter_timer;
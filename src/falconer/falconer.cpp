@@ -25,65 +25,246 @@
 //Time Utility Header
 #include "msl/time_util.hpp"
 
-//https://github.com/elliotwoods/ARDrone-GStreamer-test/blob/master/plugin/src/pave.h
-struct parrot_video_encapsulation_t
-{
-	uint8_t signature[4];
-	uint8_t version;
-	uint8_t video_codec;
-	uint16_t header_size;
-	uint32_t payload_size;					/* Amount of data following this PaVE */
-	uint16_t encoded_stream_width;			/* ex: 640 */
-	uint16_t encoded_stream_height;			/* ex: 368 */
-	uint16_t display_width;					/* ex: 640 */
-	uint16_t display_height;				/* ex: 360 */
-	uint32_t frame_number;					/* frame position inside the current stream */
-	uint32_t timestamp;						/* in milliseconds */
-	uint8_t total_chuncks;					/* number of UDP packets containing the current decodable payload */
-	uint8_t chunck_index ;					/* position of the packet - first chunk is #0 */
-	uint8_t frame_type;						/* I-frame, P-frame */
-	uint8_t control;						/* Special commands like end-of-stream or advertised frames */
-	uint32_t stream_byte_position_lw;		/* Byte position of the current payload in the encoded stream - lower 32-bit word */
-	uint32_t stream_byte_position_uw;		/* Byte position of the current payload in the encoded stream - upper 32-bit word */
-	uint16_t stream_id;						/* This ID indentifies packets that should be recorded together */
-	uint8_t total_slices;					/* number of slices composing the current frame */
-	uint8_t slice_index ;					/* position of the current slice in the frame */
-	uint8_t header1_size;					/* H.264 only : size of SPS inside payload - no SPS present if value is zero */
-	uint8_t header2_size;					/* H.264 only : size of PPS inside payload - no PPS present if value is zero */
-	uint8_t reserved2[2];					/* Padding to align on 48 bytes */
-	uint32_t advertised_size;				/* Size of frames announced as advertised frames */
-	uint8_t reserved3[12];					/* Padding to align on 64 bytes */
-};
+//Bad Frame Size (anything bigger than this is garbage, not video)
+static const unsigned int pave_max_payload=4*1024*1024;
+
+//Frame Buffer Size (640x368 RGB)
+static const unsigned int video_buffer_size=640*368*3;
+
+//Fresh Frame Flag (set on _video_middle when the decoder publishes)
+static const int video_fresh=4;
+
+//Atomic Exchange Function (Full barrier, returns old value)
+static int atomic_exchange(volatile int* value,const int replacement)
+{
+	int old=*value;
+
+	while(true)
+	{
+		int seen=__sync_val_compare_and_swap(value,old,replacement);
+
+		if(seen==old)
+			return old;
+
+		old=seen;
+	}
+}
+
+pave_demuxer::pave_demuxer(const unsigned int capacity):_buffer(capacity),_start(0),_end(0),_resyncs(0)
+{}
+
+uint8_t* pave_demuxer::write_pointer(const unsigned int size)
+{
+	//Out of room at the back, slide unread bytes to the front.
+	if(_buffer.size()-_end<size&&_start>0)
+	{
+		memmove(&_buffer[0],&_buffer[_start],_end-_start);
+		_end-=_start;
+		_start=0;
+	}
+
+	//Still out of room (a frame bigger than the buffer), grow.
+	if(_buffer.size()-_end<size)
+		_buffer.resize(_end+size);
+
+	return &_buffer[_end];
+}
+
+void pave_demuxer::commit(const unsigned int size)
+{
+	_end+=size;
+}
+
+bool pave_demuxer::next_frame(parrot_video_encapsulation_t& header,const uint8_t*& payload)
+{
+	const unsigned int fixed_size=12;	//Signature through payload_size
+
+	while(_end-_start>=fixed_size)
+	{
+		const uint8_t* data=&_buffer[_start];
+		uint16_t header_size=0;
+		uint32_t payload_size=0;
+		memcpy(&header_size,data+6,2);
+		memcpy(&payload_size,data+8,4);
+
+		//Not a sane PaVE header, skip ahead to the next signature.
+		if(memcmp(data,"PaVE",4)!=0||header_size<fixed_size||payload_size>pave_max_payload)
+		{
+			++_resyncs;
+			++_start;
+
+			while(_end-_start>=4&&memcmp(&_buffer[_start],"PaVE",4)!=0)
+				++_start;
+
+			continue;
+		}
+
+		//Frame not all here yet.
+		if(_end-_start<header_size+payload_size)
+			return false;
+
+		memset(&header,0,sizeof(header));
+		memcpy(&header,data,std::min(static_cast<unsigned int>(header_size),static_cast<unsigned int>(sizeof(header))));
+		payload=data+header_size;
+		_start+=header_size+payload_size;
+		return true;
+	}
+
+	return false;
+}
+
+unsigned int pave_demuxer::resyncs() const
+{
+	return _resyncs;
+}
+
+void pave_demuxer::clear()
+{
+	_start=_end=0;
+}
+
+at_command_encoder::at_command_encoder():_size(0),_command_start(0),_overflow(false)
+{}
+
+void at_command_encoder::begin(const char* name,const unsigned int sequence)
+{
+	_command_start=_size;
+	_overflow=false;
+	append(name,strlen(name));
+	append("=",1);
+	append_int(static_cast<int>(sequence));
+}
+
+void at_command_encoder::arg(const int value)
+{
+	append(",",1);
+	append_int(value);
+}
+
+//The drone wants floats as the int with the same bits.
+void at_command_encoder::arg(const float value)
+{
+	int bits=0;
+	memcpy(&bits,&value,4);
+	arg(bits);
+}
+
+void at_command_encoder::arg(const char* value)
+{
+	append(",\"",2);
+	append(value,strlen(value));
+	append("\"",1);
+}
+
+void at_command_encoder::arg_quoted(const int value)
+{
+	append(",\"",2);
+	append_int(value);
+	append("\"",1);
+}
+
+bool at_command_encoder::end()
+{
+	append("\r",1);
+
+	if(_overflow)
+	{
+		_size=_command_start;
+		return false;
+	}
+
+	return true;
+}
+
+const char* at_command_encoder::data() const
+{
+	return _buffer;
+}
+
+unsigned int at_command_encoder::size() const
+{
+	return _size;
+}
+
+unsigned int at_command_encoder::space() const
+{
+	return capacity-_size;
+}
+
+void at_command_encoder::clear()
+{
+	_size=_command_start=0;
+	_overflow=false;
+}
+
+void at_command_encoder::append(const char* str,const unsigned int length)
+{
+	if(_overflow||length>capacity-_size)
+	{
+		_overflow=true;
+		return;
+	}
+
+	memcpy(_buffer+_size,str,length);
+	_size+=length;
+}
+
+void at_command_encoder::append_int(const int value)
+{
+	//Digits come out backwards, unsigned so INT_MIN negates cleanly.
+	char digits[12];
+	unsigned int count=0;
+	unsigned int magnitude=(value<0)?0u-static_cast<unsigned int>(value):static_cast<unsigned int>(value);
+
+	do
+	{
+		digits[count++]=static_cast<char>('0'+magnitude%10);
+		magnitude/=10;
+	}
+	while(magnitude>0);
+
+	if(value<0)
+		digits[count++]='-';
+
+	std::reverse(digits,digits+count);
+	append(digits,count);
+}
 
 ardrone::ardrone(const std::string ip,const unsigned short control_port,const unsigned short navdata_port,const unsigned short video_port):
 	_count(1),
 	_control_socket(ip+":"+msl::to_string(control_port)),
+	_pcmd_progressive(false),_pcmd_millis(0),
+	_control_thread(NULL),_control_running(false),
 	_navdata_socket(ip+":"+msl::to_string(navdata_port)),
 	_video_socket(ip+":"+msl::to_string(video_port)),
-	_battery_percent(0),
-	_landed(true),
-	_emergency_mode(false),
-	_low_battery(false),
-	_ultrasonic_enabled(false),
-	_video_enabled(false),
-	_motors_good(false),
-	_pitch(0),_roll(0),_yaw(0),_altitude(0)
+	_navdata_version(0),_navdata_last_sequence(0),
+	_navdata_thread(NULL),_navdata_running(false),_navdata_keepalive_time(0),
+	_video_back(0),_video_front(1),_video_middle(2),_video_frames(0),
+	_video_thread(NULL),_video_running(false),_video_keepalive_time(0),
+	_sws_context(NULL)
 {
+	for(int ii=0;ii<4;++ii)
+		_pcmd[ii]=0;
+
+	//No navdata yet (states of zero means landed).
+	memset(&_navdata,0,sizeof(_navdata));
+
 	//Hide Libav debug output...can't really print anything else...
 	av_log_set_level(AV_LOG_QUIET);
 
 	//Allocate camera data and clear to zero.
-	_camera_data=new uint8_t[640*368*3];
-	memset(_camera_data,0,640*368*3);
+	for(int ii=0;ii<3;++ii)
+	{
+		_video_buffers[ii]=new uint8_t[video_buffer_size];
+		memset(_video_buffers[ii],0,video_buffer_size);
+	}
 
 	//Register all the codecs, parsers and bitstream filters which were enabled at configuration time...
 	avcodec_register_all();
 
-	//Initialize codec frame packets and buffers.
+	//Initialize codec frame packets (data is set per frame in video_decode).
 	memset(&_av_packet,0,sizeof(_av_packet));
 	av_init_packet(&_av_packet);
-	_av_packet.data=new uint8_t[100000];
-	memset(_av_packet.data,0,100000);
 
 	//Find a codec.
 	_av_codec=avcodec_find_decoder(CODEC_ID_H264);
@@ -91,8 +272,9 @@ ardrone::ardrone(const std::string ip,const unsigned short control_port,const un
 	//Failed to find codec, cleanup and throw.
 	if(!_av_codec)
 	{
-		delete[] _camera_data;
-		delete[] _av_packet.data;
+		for(int ii=0;ii<3;++ii)
+			delete[] _video_buffers[ii];
+
 		throw std::runtime_error("ardrone::ardrone() - Could not find a video decoder (CODEC_ID_H264)!");
 	}
 
@@ -104,27 +286,35 @@ ardrone::ardrone(const std::string ip,const unsigned short control_port,const un
 	//Open codec, on failure, cleanup and throw.
 	if(avcodec_open2(_av_context,_av_codec,NULL)<0)
 	{
-		delete[] _camera_data;
+		for(int ii=0;ii<3;++ii)
+			delete[] _video_buffers[ii];
+
 		avcodec_close(_av_context);
 		av_free(_av_context);
 		av_free(_av_camera_cmyk);
 		av_free(_av_camera_rgb);
-		delete[] _av_packet.data;
+		throw std::runtime_error("ardrone::ardrone() - Could not open the video decoder (CODEC_ID_H264)!");
 	}
 }
 
 ardrone::~ardrone()
 {
+	control_stop();
+	navdata_stop();
+	video_stop();
 	_control_socket.close();
 	_navdata_socket.close();
 
 	_video_socket.close();
-	delete[] _camera_data;
+
+	for(int ii=0;ii<3;++ii)
+		delete[] _video_buffers[ii];
+
+	sws_freeContext(_sws_context);
 	avcodec_close(_av_context);
 	av_free(_av_context);
 	av_free(_av_camera_cmyk);
 	av_free(_av_camera_rgb);
-	delete[] _av_packet.data;
 }
 
 ardrone::operator bool() const
@@ -170,37 +360,55 @@ bool ardrone::connect(unsigned int time_out)
 	//If connected, set some settings...
 	if(good())
 	{
-		//Reset counter.
-		_count=1;
-
-		//Turn on full navdata packets.
-		std::string navdata_enable_command="AT*CONFIG="+msl::to_string(_count)+
-			",\"general:navdata_demo\",\"FALSE\"\r";
-		++_count;
-		_control_socket.write(navdata_enable_command);
-
-		//Send all navdata options.
-		std::string navdata_send_all_command="AT*CONFIG="+msl::to_string(_count)+
-			",\"general:navdata_options\",\"65537\"\r";
-		++_count;
-		_control_socket.write(navdata_send_all_command);
-
-		//Set the watchdog timer.
-		std::string watchdog_command="AT*COMWDG="+msl::to_string(_count)+"\r";
-		++_count;
-		_control_socket.write(watchdog_command);
-
-		//Set the video codec.
-		std::string video_codec_command="AT*CONFIG="+msl::to_string(_count)+
-			",\"video:video_codec\",\"P264_CODEC\"\r";
-		++_count;
-		_control_socket.write(video_codec_command);
-
-		//Set the video codec speed.
-		std::string video_codec_speed_command="AT*CONFIG="+msl::to_string(_count)+
-			",\"video:codec_fps\",\"30\"\r";
-		++_count;
-		_control_socket.write(video_codec_speed_command);
+		//Reset counter, anything queued before now has a stale sequence number.
+		{
+			porlock_scoped guard(&_control_lock);
+			_count=1;
+			_at_commands.clear();
+
+			//Turn on full navdata packets.
+			at_config("general:navdata_demo","FALSE");
+
+			//Send all navdata options.
+			at_config("general:navdata_options","65537");
+
+			//Set the watchdog timer.
+			at_begin("AT*COMWDG");
+			_at_commands.end();
+
+			//Set the video codec.
+			at_config("video:video_codec","P264_CODEC");
+
+			//Set the video codec speed.
+			at_config("video:codec_fps","30");
+
+			at_send();
+		}
+
+		//Send commands at a steady rate, however fast the caller's loop runs.
+		if(!_control_running)
+		{
+			_control_running=true;
+			_control_thread=porthread_create(control_thread_func,this);
+		}
+
+		//Receive navdata on its own thread, so readers always see the newest packet.
+		if(!_navdata_running)
+		{
+			_navdata_last_sequence=0;
+			_navdata_keepalive_time=0;
+			_navdata_running=true;
+			_navdata_thread=porthread_create(navdata_thread_func,this);
+		}
+
+		//Decode video on its own thread, so navdata and control never wait on it.
+		if(!_video_running)
+		{
+			_video_demuxer.clear();
+			_video_keepalive_time=0;
+			_video_running=true;
+			_video_thread=porthread_create(video_thread_func,this);
+		}
 
 		return true;
 	}
@@ -210,6 +418,9 @@ bool ardrone::connect(unsigned int time_out)
 
 void ardrone::close()
 {
+	control_stop();
+	navdata_stop();
+	video_stop();
 	_control_socket.close();
 	_navdata_socket.close();
 	_video_socket.close();
@@ -217,90 +428,385 @@ void ardrone::close()
 
 void ardrone::navdata_update()
 {
-	if(good())
+	if(good()&&!_navdata_running)
+		while(navdata_service())
+		{}
+}
+
+ardrone_navdata_t ardrone::navdata() const
+{
+	ardrone_navdata_t data;
+
+	//Retry if the writer was (or started) writing while we copied.
+	while(true)
+	{
+		unsigned int version=_navdata_version;
+
+		if(version&1)
+			continue;
+
+		__sync_synchronize();
+		data=_navdata;
+		__sync_synchronize();
+
+		if(_navdata_version==version)
+			return data;
+	}
+}
+
+//Reads one navdata packet if one is waiting, returns true if it read anything.
+bool ardrone::navdata_service()
+{
+	//Ask the drone to (keep) sending navdata to us.
+	if(msl::millis()-_navdata_keepalive_time>=1000)
 	{
 		char redirect_navdata_command[14]={1,0,0,0,0,0,0,0,0,0,0,0,0,0};
 		_navdata_socket.write(redirect_navdata_command,14);
+		_navdata_keepalive_time=msl::millis();
+	}
+
+	if(_navdata_socket.available()<=0)
+		return false;
+
+	//One recv is one whole datagram (full packets run about 500 bytes).
+	const unsigned int packet_size=4096;
+	uint8_t packet[packet_size];
+	int bytes_read=_navdata_socket.read(packet,packet_size);
+
+	if(bytes_read<=0||bytes_read>static_cast<int>(packet_size))
+		return false;
+
+	ardrone_navdata_t data;
+
+	//Skip bad and out of order packets (sequence starts over on reconnect).
+	if(navdata_parse(packet,bytes_read,data)&&data.sequence>_navdata_last_sequence)
+	{
+		data.receive_millis=msl::millis();
+		_navdata_last_sequence=data.sequence;
+		navdata_publish(data);
+	}
+
+	return true;
+}
+
+//Option Field Read Function (Copies value from offset of an option's data, if it fits)
+template<typename T> static void navdata_field(const uint8_t* data,const unsigned int size,const unsigned int offset,T& value)
+{
+	if(offset+sizeof(T)<=size)
+		memcpy(&value,data+offset,sizeof(T));
+}
+
+//Parses a navdata packet by walking its option chain, returns false for a bad packet.
+//	Option layouts are from the AR.Drone SDK's navdata_common.h.
+bool ardrone::navdata_parse(const uint8_t* packet,const unsigned int size,ardrone_navdata_t& data) const
+{
+	const unsigned int header_size=16;		//Magic, states, sequence, vision flag
+
+	memset(&data,0,sizeof(data));
+
+	if(size<header_size)
+		return false;
+
+	unsigned int packet_header=0;
+	memcpy(&packet_header,packet,4);
+
+	if(packet_header!=0x55667788)
+		return false;
+
+	memcpy(&data.states,packet+4,4);
+	memcpy(&data.sequence,packet+8,4);
 
-		const int packet_size=500;			//nav-data-full packet size=500, nav-data-demo packet size=24
-		uint8_t byte[packet_size];
+	unsigned int offset=header_size;
 
-		if(_navdata_socket.available()>0&&_navdata_socket.read(byte,packet_size,200)==packet_size)
+	//Every option is a 2 byte tag, a 2 byte size (including those 4), then data.
+	while(offset+4<=size)
+	{
+		uint16_t tag=0;
+		uint16_t option_size=0;
+		memcpy(&tag,packet+offset,2);
+		memcpy(&option_size,packet+offset+2,2);
+
+		if(option_size<4||offset+option_size>size)
+			return false;
+
+		const uint8_t* option=packet+offset+4;
+		const unsigned int option_data_size=option_size-4;
+
+		//Checksum is the last option, the sum of every byte before it.
+		if(tag==0xffff)
 		{
-			unsigned int packet_header;
-			memcpy(&packet_header,byte,4);
+			unsigned int checksum=0;
+			unsigned int sum=0;
+			navdata_field(option,option_data_size,0,checksum);
 
-			if(packet_header==0x55667788)
-			{
-				unsigned int states=0;
-				memcpy(&states,byte+4,4);
-
-				_landed=!static_cast<bool>(states&(1<<0));
-				_emergency_mode=static_cast<bool>(states&(1<<31));
-				_low_battery=static_cast<bool>(states&(1<<15));
-				_ultrasonic_enabled=!static_cast<bool>(states&(1<<21));
-				_video_enabled=static_cast<bool>(states&(1<<1));
-				_motors_good=!static_cast<bool>(states&(1<<12));
-
-				unsigned short header=-1;
-				memcpy(&header,byte+16,2);
-
-				if(header==0)
-				{
-					memcpy(&_battery_percent,byte+24,4);
-					memcpy(&_pitch,byte+28,4);
-					memcpy(&_roll,byte+32,4);
-					memcpy(&_yaw,byte+36,4);
-					memcpy(&_altitude,byte+40,4);
-				}
-			}
+			for(unsigned int ii=0;ii<offset;++ii)
+				sum+=packet[ii];
+
+			return sum==checksum;
 		}
+
+		if(tag<32)
+			data.options|=(1<<tag);
+
+		switch(tag)
+		{
+			case 0:		//Demo
+				navdata_field(option,option_data_size,0,data.control_state);
+				navdata_field(option,option_data_size,4,data.battery_percent);
+				navdata_field(option,option_data_size,8,data.pitch);
+				navdata_field(option,option_data_size,12,data.roll);
+				navdata_field(option,option_data_size,16,data.yaw);
+				navdata_field(option,option_data_size,20,data.altitude);
+				navdata_field(option,option_data_size,24,data.velocity);
+				break;
+			case 1:		//Time
+				navdata_field(option,option_data_size,0,data.drone_time);
+				break;
+			case 2:		//Raw Measures
+				navdata_field(option,option_data_size,0,data.raw_accelerometers);
+				navdata_field(option,option_data_size,6,data.raw_gyros);
+				navdata_field(option,option_data_size,16,data.raw_battery);
+				navdata_field(option,option_data_size,26,data.ultrasound_echo);
+				break;
+			case 3:		//Physical Measures
+				navdata_field(option,option_data_size,6,data.accelerometers);
+				navdata_field(option,option_data_size,18,data.gyros);
+				break;
+			case 10:	//Altitude
+				navdata_field(option,option_data_size,0,data.altitude_vision);
+				navdata_field(option,option_data_size,4,data.altitude_velocity);
+				navdata_field(option,option_data_size,12,data.altitude_raw);
+				break;
+			case 16:	//Vision Detect
+				navdata_field(option,option_data_size,0,data.tags_detected);
+				navdata_field(option,option_data_size,20,data.tag_x);
+				navdata_field(option,option_data_size,36,data.tag_y);
+				navdata_field(option,option_data_size,84,data.tag_distance);
+				break;
+			case 22:	//Magnetometer
+				navdata_field(option,option_data_size,0,data.magneto);
+				break;
+			case 26:	//Wifi
+				navdata_field(option,option_data_size,0,data.wifi_link_quality);
+				break;
+			default:	//Everything else we just step over.
+				break;
+		}
+
+		offset+=option_size;
+	}
+
+	//Ran out of packet before the checksum.
+	return false;
+}
+
+//Single writer seqlock: odd version while writing, readers retry on a change.
+void ardrone::navdata_publish(const ardrone_navdata_t& data)
+{
+	++_navdata_version;
+	__sync_synchronize();
+	_navdata=data;
+	__sync_synchronize();
+	++_navdata_version;
+}
+
+void ardrone::navdata_stop()
+{
+	if(_navdata_running)
+	{
+		_navdata_running=false;
+		porthread_wait(_navdata_thread);
+		_navdata_thread=NULL;
 	}
 }
 
+void ardrone::navdata_thread_func(void* drone)
+{
+	ardrone* self=reinterpret_cast<ardrone*>(drone);
+
+	while(self->_navdata_running)
+		if(!self->navdata_service())
+			msl::nsleep(1000000);
+}
+
 void ardrone::video_update()
 {
-	if(good())
+	if(good()&&!_video_running)
+		while(video_service())
+		{}
+}
+
+//Reads whatever video bytes are waiting and decodes every whole frame.
+//	Returns true if any bytes were read.
+bool ardrone::video_service()
+{
+	//Poke the drone now and then so it keeps streaming.
+	if(msl::millis()-_video_keepalive_time>=1000)
 	{
 		char video_keepalive_command[1]={1};
 		_video_socket.write(&video_keepalive_command,1);
+		_video_keepalive_time=msl::millis();
+	}
+
+	if(_video_socket.available()<=0)
+		return false;
 
-		parrot_video_encapsulation_t video_packet;
-		memset(&video_packet,0,sizeof(video_packet));
-		_av_packet.size=_video_socket.read(_av_packet.data,sizeof(parrot_video_encapsulation_t),200);
+	//One recv of whatever has arrived (the socket said it won't block).
+	const unsigned int chunk_size=64*1024;
+	int bytes_read=_video_socket.read(_video_demuxer.write_pointer(chunk_size),chunk_size);
 
-		if(static_cast<unsigned int>(_av_packet.size)<=sizeof(video_packet))
+	if(bytes_read<=0)
+		return false;
+
+	_video_demuxer.commit(bytes_read);
+
+	parrot_video_encapsulation_t header;
+	const uint8_t* payload=NULL;
+
+	while(_video_demuxer.next_frame(header,payload))
+		video_decode(header,payload);
+
+	return true;
+}
+
+void ardrone::video_decode(const parrot_video_encapsulation_t& header,const uint8_t* payload)
+{
+	//Libav wants zeroed padding past the end of the packet, so frames get copied once.
+	_av_packet_data.resize(header.payload_size+FF_INPUT_BUFFER_PADDING_SIZE);
+	memcpy(&_av_packet_data[0],payload,header.payload_size);
+	memset(&_av_packet_data[header.payload_size],0,FF_INPUT_BUFFER_PADDING_SIZE);
+	_av_packet.data=&_av_packet_data[0];
+	_av_packet.size=header.payload_size;
+	_av_packet.flags=0;
+
+	if(header.frame_type==1)
+		_av_packet.flags=AV_PKT_FLAG_KEY;
+
+	int frame_decoded=0;
+
+	if(avcodec_decode_video2(_av_context,_av_camera_cmyk,&frame_decoded,&_av_packet)>0&&frame_decoded>0&&
+		header.encoded_stream_width==640&&header.encoded_stream_height==368&&
+		header.display_width==640&&header.display_height==360)
+	{
+		//Scaler is built once, and only rebuilt if the stream changes.
+		_sws_context=sws_getCachedContext(_sws_context,header.encoded_stream_width,header.encoded_stream_height,_av_context->pix_fmt,
+			header.encoded_stream_width,header.encoded_stream_height,PIX_FMT_RGB24,SWS_BICUBIC,NULL,NULL,NULL);
+
+		if(_sws_context!=NULL&&_av_camera_cmyk->data[0]!=NULL)
 		{
-			memcpy(&video_packet,_av_packet.data,_av_packet.size);
-			_av_packet.size=_video_socket.read(_av_packet.data,video_packet.payload_size,200);
+			avpicture_fill(reinterpret_cast<AVPicture*>(_av_camera_rgb),_video_buffers[_video_back],PIX_FMT_RGB24,header.encoded_stream_width,header.encoded_stream_height);
+			sws_scale(_sws_context,_av_camera_cmyk->data,_av_camera_cmyk->linesize,0,header.display_height,_av_camera_rgb->data,_av_camera_rgb->linesize);
+			video_publish();
+		}
+	}
+}
+
+//Swap the finished back buffer into the middle, and take the old middle to decode into next.
+void ardrone::video_publish()
+{
+	_video_back=atomic_exchange(&_video_middle,_video_back|video_fresh)&~video_fresh;
+	__sync_fetch_and_add(&_video_frames,1);
+}
+
+void ardrone::video_stop()
+{
+	if(_video_running)
+	{
+		_video_running=false;
+		porthread_wait(_video_thread);
+		_video_thread=NULL;
+	}
+}
+
+void ardrone::video_thread_func(void* drone)
+{
+	ardrone* self=reinterpret_cast<ardrone*>(drone);
+
+	while(self->_video_running)
+		if(!self->video_service())
+			msl::nsleep(1000000);
+}
+
+//Starts a queued command with the next sequence number (call with _control_lock held).
+void ardrone::at_begin(const char* name)
+{
+	//No AT command we send comes close to this long.
+	const unsigned int longest_command=256;
+
+	if(_at_commands.space()<longest_command)
+		at_send();
+
+	_at_commands.begin(name,_count);
+	++_count;
+}
+
+//Sends everything queued as one datagram (call with _control_lock held).
+void ardrone::at_send()
+{
+	if(_at_commands.size()>0)
+		_control_socket.write(_at_commands.data(),_at_commands.size());
+
+	_at_commands.clear();
+}
+
+//Queues an AT*CONFIG (call with _control_lock held).
+void ardrone::at_config(const char* key,const char* value)
+{
+	at_begin("AT*CONFIG");
+	_at_commands.arg(key);
+	_at_commands.arg(value);
+	_at_commands.end();
+}
+
+void ardrone::control_stop()
+{
+	if(_control_running)
+	{
+		_control_running=false;
+		porthread_wait(_control_thread);
+		_control_thread=NULL;
+	}
+}
 
-			_av_packet.flags=0;
+//Every tick: the queued commands plus the newest PCMD go out together.
+//	A PCMD older than a few ticks turns into hover, so a stalled caller
+//	doesn't leave the drone flying its last command forever.
+void ardrone::control_thread_func(void* drone)
+{
+	ardrone* self=reinterpret_cast<ardrone*>(drone);
+	const unsigned long tick_millis=33;
+	const unsigned long stale_millis=200;
+	unsigned long next_tick=msl::millis();
 
-			if(video_packet.frame_type==1)
-				_av_packet.flags=AV_PKT_FLAG_KEY;
+	while(self->_control_running)
+	{
+		{
+			porlock_scoped guard(&self->_control_lock);
+			bool progressive=self->_pcmd_progressive&&msl::millis()-self->_pcmd_millis<stale_millis;
 
-			int frame_decoded=0;
+			self->at_begin("AT*PCMD");
+			self->_at_commands.arg(progressive?1:0);
 
-			if(avcodec_decode_video2(_av_context,_av_camera_cmyk,&frame_decoded,&_av_packet)>0&&frame_decoded>0)
+			for(int ii=0;ii<4;++ii)
 			{
-				if(video_packet.encoded_stream_width==640&&video_packet.encoded_stream_height==368)
-				{
-					SwsContext* _sws_context=sws_getContext(video_packet.encoded_stream_width,video_packet.encoded_stream_height,PIX_FMT_YUV420P,video_packet.encoded_stream_width,
-						video_packet.encoded_stream_height,PIX_FMT_RGB24,SWS_BICUBIC,NULL,NULL,NULL);
-
-					if(_sws_context!=NULL)
-					{
-						if(_av_camera_rgb!=NULL&&_camera_data!=NULL)
-							avpicture_fill(reinterpret_cast<AVPicture*>(_av_camera_rgb),_camera_data,PIX_FMT_BGR24,video_packet.encoded_stream_width,video_packet.encoded_stream_height);
-
-						if(_av_camera_cmyk->data!=NULL&&video_packet.display_width==640&&video_packet.display_height==360)
-							sws_scale(_sws_context,_av_camera_cmyk->data,_av_camera_cmyk->linesize,0,video_packet.display_height,_av_camera_rgb->data,_av_camera_rgb->linesize);
-
-						sws_freeContext(_sws_context);
-					}
-				}
+				if(progressive)
+					self->_at_commands.arg(self->_pcmd[ii]);
+				else
+					self->_at_commands.arg(0);
 			}
+
+			self->_at_commands.end();
+			self->at_send();
 		}
+
+		//Sleep to the next tick, or start over if we fell way behind.
+		next_tick+=tick_millis;
+		unsigned long now=msl::millis();
+
+		if(next_tick>now)
+			msl::nsleep((next_tick-now)*1000000);
+		else
+			next_tick=now;
 	}
 }
 
@@ -309,9 +815,10 @@ void ardrone::land()
 	if(good())
 	{
 		int land_flags=1<<18|1<<20|1<<22|1<<24|1<<28;
-		std::string command="AT*REF="+msl::to_string(_count)+","+msl::to_string(land_flags)+"\r";
-		++_count;
-		_control_socket.write(command);
+		porlock_scoped guard(&_control_lock);
+		at_begin("AT*REF");
+		_at_commands.arg(land_flags);
+		_at_commands.end();
 	}
 }
 
@@ -320,9 +827,10 @@ void ardrone::emergency_mode_toggle()
 	if(good())
 	{
 		int emergency_flags=1<<8|1<<18|1<<20|1<<22|1<<24|1<<28;
-		std::string command="AT*REF="+msl::to_string(_count)+","+msl::to_string(emergency_flags)+"\r";
-		++_count;
-		_control_socket.write(command);
+		porlock_scoped guard(&_control_lock);
+		at_begin("AT*REF");
+		_at_commands.arg(emergency_flags);
+		_at_commands.end();
 	}
 }
 
@@ -331,12 +839,14 @@ void ardrone::takeoff()
 	if(good())
 	{
 		int takeoff_flags=1<<9|1<<18|1<<20|1<<22|1<<24|1<<28;
-		std::string command="AT*REF="+msl::to_string(_count)+","+msl::to_string(takeoff_flags)+"\r";
-		++_count;
-		_control_socket.write(command);
+		porlock_scoped guard(&_control_lock);
+		at_begin("AT*REF");
+		_at_commands.arg(takeoff_flags);
+		_at_commands.end();
 	}
 }
 
+//Just remembers the command, the control thread sends it every tick.
 void ardrone::manuever(float altitude,float pitch,float roll,float yaw)
 {
 	if(good())
@@ -346,10 +856,13 @@ void ardrone::manuever(float altitude,float pitch,float roll,float yaw)
 		roll=std::max((float)-1.0,std::min((float)1.0,roll));
 		yaw=std::max((float)-1.0,std::min((float)1.0,yaw));
 
-		std::string command="AT*PCMD="+msl::to_string(_count)+",1,"+msl::to_string(*(int*)(&roll))+","+msl::to_string(*(int*)(&pitch))
-			+","+msl::to_string(*(int*)(&altitude))+","+msl::to_string(*(int*)(&yaw))+"\r";
-		++_count;
-		_control_socket.write(command);
+		porlock_scoped guard(&_control_lock);
+		_pcmd_progressive=true;
+		_pcmd[0]=roll;
+		_pcmd[1]=pitch;
+		_pcmd[2]=altitude;
+		_pcmd[3]=yaw;
+		_pcmd_millis=msl::millis();
 	}
 }
 
@@ -357,80 +870,61 @@ void ardrone::hover()
 {
 	if(good())
 	{
-		std::string command="AT*PCMD="+msl::to_string(_count)+",0,0,0,0,0\r";
-		++_count;
-		_control_socket.write(command);
+		porlock_scoped guard(&_control_lock);
+		_pcmd_progressive=false;
+		_pcmd_millis=msl::millis();
 	}
 }
 
 void ardrone::set_level()
 {
-	std::string initialize_command="AT*FTRIM="+msl::to_string(_count)+"\r";
-	++_count;
-	_control_socket.write(initialize_command);
+	porlock_scoped guard(&_control_lock);
+	at_begin("AT*FTRIM");
+	_at_commands.end();
 }
 
 void ardrone::set_outdoor_mode(const bool outdoor)
 {
-	std::string bool_value="FALSE";
-
-	if(outdoor)
-		bool_value="TRUE";
-
-	std::string outdoor_hull_command="AT*CONFIG="+msl::to_string(_count)+",\"control:outdoor\",\""+bool_value+"\"\r";
-	++_count;
-	_control_socket.write(outdoor_hull_command);
+	porlock_scoped guard(&_control_lock);
+	at_config("control:outdoor",outdoor?"TRUE":"FALSE");
 }
 
 void ardrone::set_using_shell(const bool on)
 {
-	std::string bool_value="FALSE";
-
-	if(on)
-		bool_value="TRUE";
-
-	std::string shell_is_on_command="AT*CONFIG="+msl::to_string(_count)+",\"control:flight_without_shell\",\""+bool_value+"\"\r";
-	++_count;
-	_control_socket.write(shell_is_on_command);
+	porlock_scoped guard(&_control_lock);
+	at_config("control:flight_without_shell",on?"TRUE":"FALSE");
 }
 
 void ardrone::set_using_brushless_motors(const bool brushless)
 {
-	std::string bool_value="FALSE";
-
-	if(brushless)
-		bool_value="TRUE";
-
-	std::string motor_type_command="AT*CONFIG="+msl::to_string(_count)+
-		",\"control:brushless\",\""+bool_value+"\"\r";
-	++_count;
-	_control_socket.write(motor_type_command);
+	porlock_scoped guard(&_control_lock);
+	at_config("control:brushless",brushless?"TRUE":"FALSE");
 }
 
 void ardrone::set_min_altitude(const int mm)
 {
-	std::string altitude_min_command="AT*CONFIG="+msl::to_string(_count)+
-		",\"control:altitude_min\",\""+msl::to_string(mm)+"\"\r";
-	++_count;
-	_control_socket.write(altitude_min_command);
+	porlock_scoped guard(&_control_lock);
+	at_begin("AT*CONFIG");
+	_at_commands.arg("control:altitude_min");
+	_at_commands.arg_quoted(mm);
+	_at_commands.end();
 }
 
 void ardrone::set_max_altitude(const int mm)
 {
-	std::string altitude_max_command="AT*CONFIG="+msl::to_string(_count)+
-		",\"control:altitude_max\",\""+msl::to_string(mm)+"\"\r";
-	++_count;
-	_control_socket.write(altitude_max_command);
+	porlock_scoped guard(&_control_lock);
+	at_begin("AT*CONFIG");
+	_at_commands.arg("control:altitude_max");
+	_at_commands.arg_quoted(mm);
+	_at_commands.end();
 }
 
 void ardrone::set_video_feed_front()
 {
 	if(good())
 	{
-		std::string command="AT*CONFIG="+msl::to_string(_count)+
-			",\"video:video_channel\",\"2\"\r";
-		++_count;
-		_control_socket.write(command);
+		porlock_scoped guard(&_control_lock);
+		at_config("video:video_channel","2");
 	}
 }
 
@@ -438,67 +932,80 @@ void ardrone::set_video_feed_bottom()
 {
 	if(good())
 	{
-		std::string command="AT*CONFIG="+msl::to_string(_count)+
-			",\"video:video_channel\",\"3\"\r";
-		++_count;
-		_control_socket.write(command);
+		porlock_scoped guard(&_control_lock);
+		at_config("video:video_channel","3");
 	}
 }
 
 unsigned int ardrone::battery_percent() const
 {
-	return _battery_percent;
+	return navdata().battery_percent;
 }
 
 bool ardrone::flying() const
 {
-	return !_landed;
+	return static_cast<bool>(navdata().states&(1<<0));
 }
 
 bool ardrone::emergency_mode() const
 {
-	return _emergency_mode;
+	return static_cast<bool>(navdata().states&(1<<31));
 }
 
 bool ardrone::low_battery() const
 {
-	return _low_battery;
+	return static_cast<bool>(navdata().states&(1<<15));
 }
 
 bool ardrone::ultrasonic_enabled() const
 {
-	return _ultrasonic_enabled;
+	ardrone_navdata_t data=navdata();
+
+	//Nothing heard yet, don't claim anything works.
+	return data.sequence>0&&!static_cast<bool>(data.states&(1<<21));
 }
 
 bool ardrone::motors_good() const
 {
-	return _motors_good;
+	ardrone_navdata_t data=navdata();
+
+	//Nothing heard yet, don't claim anything works.
+	return data.sequence>0&&!static_cast<bool>(data.states&(1<<12));
 }
 
 int ardrone::altitude() const
 {
-	return _altitude;
+	return navdata().altitude;
 }
 
 //command gives millidegrees, convert to degrees.
 float ardrone::pitch() const
 {
-	return _pitch/1000.0;
+	return navdata().pitch/1000.0;
 }
 
 //command gives millidegrees, convert to degrees.
 float ardrone::roll() const
 {
-	return _roll/1000.0;
+	return navdata().roll/1000.0;
 }
 
 //command gives millidegrees, convert to degrees.
 float ardrone::yaw() const
 {
-	return _yaw/1000.0;
+	return navdata().yaw/1000.0;
 }
 
 uint8_t* ardrone::video_data() const
 {
-	return _camera_data;
+	//Newer frame waiting in the middle, trade our front buffer for it.
+	if(_video_middle&video_fresh)
+		_video_front=atomic_exchange(&_video_middle,_video_front)&~video_fresh;
+
+	return _video_buffers[_video_front];
+}
+
+unsigned int ardrone::video_frames() const
+{
+	return _video_frames;
 }
@@ -10,8 +10,10 @@
 #ifndef FALCONER_H
 #define FALCONER_H
 
+#include "cyberalaska/porthread.h"
 #include "msl/socket.hpp"
 #include <string>
+#include <vector>
 
 extern "C"
 {
@@ -21,6 +23,153 @@ extern "C"
 	#include "libavutil/mem.h"
 }
 
+//https://github.com/elliotwoods/ARDrone-GStreamer-test/blob/master/plugin/src/pave.h
+struct parrot_video_encapsulation_t
+{
+	uint8_t signature[4];
+	uint8_t version;
+	uint8_t video_codec;
+	uint16_t header_size;
+	uint32_t payload_size;					/* Amount of data following this PaVE */
+	uint16_t encoded_stream_width;			/* ex: 640 */
+	uint16_t encoded_stream_height;			/* ex: 368 */
+	uint16_t display_width;					/* ex: 640 */
+	uint16_t display_height;				/* ex: 360 */
+	uint32_t frame_number;					/* frame position inside the current stream */
+	uint32_t timestamp;						/* in milliseconds */
+	uint8_t total_chuncks;					/* number of UDP packets containing the current decodable payload */
+	uint8_t chunck_index ;					/* position of the packet - first chunk is #0 */
+	uint8_t frame_type;						/* I-frame, P-frame */
+	uint8_t control;						/* Special commands like end-of-stream or advertised frames */
+	uint32_t stream_byte_position_lw;		/* Byte position of the current payload in the encoded stream - lower 32-bit word */
+	uint32_t stream_byte_position_uw;		/* Byte position of the current payload in the encoded stream - upper 32-bit word */
+	uint16_t stream_id;						/* This ID indentifies packets that should be recorded together */
+	uint8_t total_slices;					/* number of slices composing the current frame */
+	uint8_t slice_index ;					/* position of the current slice in the frame */
+	uint8_t header1_size;					/* H.264 only : size of SPS inside payload - no SPS present if value is zero */
+	uint8_t header2_size;					/* H.264 only : size of PPS inside payload - no PPS present if value is zero */
+	uint8_t reserved2[2];					/* Padding to align on 48 bytes */
+	uint32_t advertised_size;				/* Size of frames announced as advertised frames */
+	uint8_t reserved3[12];					/* Padding to align on 64 bytes */
+};
+
+//Navdata Snapshot
+//	Everything decoded from one navdata packet.  options has bit n set if
+//	option tag n was in the packet, fields from missing options are zero.
+struct ardrone_navdata_t
+{
+	unsigned int sequence;					/* Drone's packet sequence number */
+	unsigned long receive_millis;			/* msl::millis() when the packet arrived */
+	unsigned int options;
+	unsigned int states;
+
+	//Demo (tag 0)
+	unsigned int control_state;
+	unsigned int battery_percent;
+	float pitch;							/* millidegrees */
+	float roll;								/* millidegrees */
+	float yaw;								/* millidegrees */
+	int altitude;							/* cm */
+	float velocity[3];						/* mm/s */
+
+	//Time (tag 1)
+	unsigned int drone_time;				/* upper 21 bits seconds, lower 11 bits microseconds */
+
+	//Raw Measures (tag 2)
+	unsigned short raw_accelerometers[3];
+	short raw_gyros[3];
+	unsigned int raw_battery;				/* mV */
+	unsigned short ultrasound_echo;
+
+	//Physical Measures (tag 3)
+	float accelerometers[3];				/* mg */
+	float gyros[3];							/* deg/s */
+
+	//Altitude (tag 10)
+	int altitude_vision;					/* mm */
+	float altitude_velocity;				/* mm/s */
+	int altitude_raw;						/* mm */
+
+	//Vision Detect (tag 16)
+	unsigned int tags_detected;
+	unsigned int tag_x[4];					/* 0-1000 across the image */
+	unsigned int tag_y[4];					/* 0-1000 down the image */
+	unsigned int tag_distance[4];			/* cm */
+
+	//Magnetometer (tag 22)
+	short magneto[3];
+
+	//Wifi (tag 26)
+	unsigned int wifi_link_quality;
+};
+
+//Streaming PaVE demuxer.
+//	Bytes go in however the socket hands them over, whole frames come out.
+//	Consumed bytes are slid out of the front of the buffer only when space
+//	runs out at the back, so each frame is contiguous and copied once.
+class pave_demuxer
+{
+	public:
+		pave_demuxer(const unsigned int capacity=256*1024);
+
+		//Returns a spot for at least size more bytes, call commit() after filling it.
+		uint8_t* write_pointer(const unsigned int size);
+		void commit(const unsigned int size);
+
+		//Gets the next whole frame, returns false if one isn't buffered yet.
+		//	payload points into the buffer and stays valid until the next write_pointer().
+		bool next_frame(parrot_video_encapsulation_t& header,const uint8_t*& payload);
+
+		//Number of times garbage had to be skipped to find a PaVE signature.
+		unsigned int resyncs() const;
+
+		void clear();
+
+	private:
+		std::vector<uint8_t> _buffer;
+		unsigned int _start;
+		unsigned int _end;
+		unsigned int _resyncs;
+};
+
+//AT Command Encoder
+//	Formats AT commands straight into one fixed datagram sized buffer,
+//	so building a command never touches the heap.
+class at_command_encoder
+{
+	public:
+		//Biggest datagram the drone accepts.
+		static const unsigned int capacity=1024;
+
+		at_command_encoder();
+
+		//Starts a command, ex: begin("AT*REF",7) gives "AT*REF=7".
+		void begin(const char* name,const unsigned int sequence);
+
+		//Arguments: ints as is, floats as their int bit pattern, strings quoted.
+		void arg(const int value);
+		void arg(const float value);
+		void arg(const char* value);
+		void arg_quoted(const int value);
+
+		//Finishes the command, returns false (and drops it) if it didn't fit.
+		bool end();
+
+		const char* data() const;
+		unsigned int size() const;
+		unsigned int space() const;
+		void clear();
+
+	private:
+		void append(const char* str,const unsigned int length);
+		void append_int(const int value);
+
+		char _buffer[capacity];
+		unsigned int _size;
+		unsigned int _command_start;
+		bool _overflow;
+};
+
 class ardrone
 {
 	public:
@@ -37,7 +186,15 @@ class ardrone
 		bool connect(unsigned int time_out=1000);
 		void close();
 
+		//Reads whatever navdata has arrived without blocking.
+		//	Does nothing while the navdata thread (started by connect()) is running.
 		void navdata_update();
+
+		//Newest navdata, a consistent copy no matter which thread is writing it.
+		ardrone_navdata_t navdata() const;
+
+		//Decodes whatever video has arrived without blocking.
+		//	Does nothing while the video thread (started by connect()) is running.
 		void video_update();
 
 		void land();
@@ -73,29 +230,77 @@ class ardrone
 		//In cm.
 		int altitude() const;
 
+		//Newest decoded 640x368 RGB frame.
+		//	Stays valid (the decoder never writes into it) until the next call.
 		uint8_t* video_data() const;
 
+		//Number of frames decoded so far.
+		unsigned int video_frames() const;
+
 	private:
 		ardrone(const ardrone& copy);
 		ardrone& operator=(const ardrone& copy);
 		unsigned int _count;
 		msl::socket _control_socket;
+
+		//Control: commands queue up in _at_commands (under _control_lock)
+		//	and go out as one datagram per tick of the control thread, along
+		//	with the newest PCMD, which also keeps the watchdog fed.
+		porlock _control_lock;
+		at_command_encoder _at_commands;
+		bool _pcmd_progressive;
+		float _pcmd[4];
+		unsigned long _pcmd_millis;
+
+		porthread_t _control_thread;
+		volatile bool _control_running;
+
+		void at_begin(const char* name);
+		void at_send();
+		void at_config(const char* key,const char* value);
+		void control_stop();
+		static void control_thread_func(void* drone);
+
 		msl::socket _navdata_socket;
 		msl::socket _video_socket;
-		unsigned int _battery_percent;
-		bool _landed;
-		bool _emergency_mode;
-		bool _low_battery;
-		bool _ultrasonic_enabled;
-		bool _video_enabled;
-		bool _motors_good;
-		float _pitch;
-		float _roll;
-		float _yaw;
-		int _altitude;
-
-		uint8_t* _camera_data;
 
+		//Navdata seqlock: _navdata_version is odd while _navdata is being written.
+		volatile unsigned int _navdata_version;
+		ardrone_navdata_t _navdata;
+		unsigned int _navdata_last_sequence;
+
+		porthread_t _navdata_thread;
+		volatile bool _navdata_running;
+		unsigned long _navdata_keepalive_time;
+
+		bool navdata_service();
+		bool navdata_parse(const uint8_t* packet,const unsigned int size,ardrone_navdata_t& data) const;
+		void navdata_publish(const ardrone_navdata_t& data);
+		void navdata_stop();
+		static void navdata_thread_func(void* drone);
+
+		//Frame buffers: the decoder owns _video_back, video_data() owns
+		//	_video_front, and _video_middle (plus a fresh frame flag) is
+		//	swapped atomically between them, so neither side ever waits.
+		uint8_t* _video_buffers[3];
+		int _video_back;
+		mutable int _video_front;
+		mutable volatile int _video_middle;
+		volatile unsigned int _video_frames;
+
+		porthread_t _video_thread;
+		volatile bool _video_running;
+		unsigned long _video_keepalive_time;
+		pave_demuxer _video_demuxer;
+
+		bool video_service();
+		void video_decode(const parrot_video_encapsulation_t& header,const uint8_t* payload);
+		void video_publish();
+		void video_stop();
+		static void video_thread_func(void* drone);
+
+		std::vector<uint8_t> _av_packet_data;
+		SwsContext* _sws_context;
 		AVPacket _av_packet;
 		AVCodec* _av_codec;
 		AVCodecContext* _av_context;
@@ -0,0 +1,261 @@
+//JSON Benchmark Source
+//	Times parsing generated telemetry-like JSON objects from 1 KB to 10 MB:
+//	"old" is a copy of what msl::json's constructor used to do (erase from the
+//	front of the remaining string as it goes), then the new msl::json, a
+//	msl::json_document, and a msl::json_parse pass with a counting handler.
+//	Small documents are parsed repeatedly so each time is about one megabyte
+//	of parsing.  The old parser is skipped once one parse takes over a second.
+//
+//	Usage: json_benchmark [max bytes]
+
+//MSL Headers
+#include <msl/json.hpp>
+#include <msl/string_util.hpp>
+#include <msl/time_util.hpp>
+
+//STL Headers
+#include <cctype>
+#include <iostream>
+#include <map>
+#include <string>
+
+//Old JSON Parse Function (msl::json's constructor before the single pass parser, error reporting dropped)
+static void old_json_parse(const std::string& json_string,std::map<std::string,std::string>& data)
+{
+	std::string temp=msl::extract_between(json_string,'{','}',false);
+
+	while(temp.size()>0)
+	{
+		while(temp.size()>0&&isspace(temp[0]))
+			temp.erase(0,1);
+
+		std::string var;
+
+		if(temp[0]=='\"')
+		{
+			var=msl::extract_between(temp,'\"','\"',true);
+			temp.erase(0,var.size());
+			var=msl::extract_between(var,'\"','\"',false);
+		}
+		else if(temp[0]=='\'')
+		{
+			var=msl::extract_between(temp,'\'','\'',true);
+			temp.erase(0,var.size());
+			var=msl::extract_between(var,'\'','\'',false);
+		}
+
+		if(var=="")
+			break;
+
+		while(temp.size()>0&&isspace(temp[0]))
+			temp.erase(0,1);
+
+		if(temp.size()>0&&temp[0]==':')
+			temp.erase(0,1);
+		else
+			break;
+
+		while(temp.size()>0&&isspace(temp[0]))
+			temp.erase(0,1);
+
+		std::string val="";
+
+		if(temp.size()==0)
+			break;
+
+		if(temp[0]=='{')
+		{
+			val=msl::extract_between(temp,'{','}',true);
+			temp.erase(0,val.size());
+		}
+		else if(temp[0]=='\"'||temp[0]=='\'')
+		{
+			val=msl::extract_until(temp,',',false);
+
+			while(true)
+			{
+				std::string check_for_comma_in_string=val;
+
+				while(check_for_comma_in_string.size()>0&&std::isspace(val[check_for_comma_in_string.size()-1]))
+					check_for_comma_in_string.erase(check_for_comma_in_string.size()-1,1);
+
+				if(check_for_comma_in_string.size()>0&&check_for_comma_in_string[check_for_comma_in_string.size()-1]!=temp[0])
+				{
+					val+=',';
+					std::string val_add=msl::extract_until(temp.substr(val.size(),temp.size()-val.size()),',',false);
+
+					if(val_add.size()==0)
+						break;
+
+					val+=val_add;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			temp.erase(0,val.size());
+
+			while(val.size()>0&&std::isspace(val[val.size()-1]))
+				val.erase(val.size()-1,1);
+
+			if(val.size()>=2)
+				val=val.substr(1,val.size()-2);
+		}
+		else
+		{
+			val=msl::extract_until(temp,',',false);
+			temp.erase(0,val.size());
+
+			while(val.size()>0&&std::isspace(val[val.size()-1]))
+				val.erase(val.size()-1,1);
+		}
+
+		while(temp.size()>0&&isspace(temp[0]))
+			temp.erase(0,1);
+
+		if(temp.size()>0&&temp[0]==',')
+			temp.erase(0,1);
+		else if(temp.size()>0)
+			break;
+
+		data[var]=val;
+	}
+}
+
+//Counting Handler (SAX pass that only counts values)
+class counting_handler:public msl::json_handler
+{
+	public:
+		counting_handler():values(0)
+		{}
+
+		bool null_value()
+		{
+			++values;
+			return true;
+		}
+
+		bool boolean(const bool)
+		{
+			++values;
+			return true;
+		}
+
+		bool number(const double,const char*,const unsigned int)
+		{
+			++values;
+			return true;
+		}
+
+		bool string(const char*,const unsigned int)
+		{
+			++values;
+			return true;
+		}
+
+		unsigned int values;
+};
+
+//Make Document Function (Object of strings, numbers, and small nested objects, about size bytes)
+static std::string make_document(const unsigned int size)
+{
+	std::string json_string="{";
+
+	for(unsigned int ii=0;json_string.size()<size;++ii)
+	{
+		if(ii>0)
+			json_string+=",";
+
+		std::string name="\"key"+msl::to_string(ii)+"\":";
+
+		if(ii%3==0)
+			json_string+=name+"\"value "+msl::to_string(ii)+"\"";
+		else if(ii%3==1)
+			json_string+=name+msl::to_string(ii)+".25";
+		else
+			json_string+=name+"{\"x\":"+msl::to_string(ii)+",\"y\":\"north, then east\"}";
+	}
+
+	return json_string+"}";
+}
+
+//Print Rate Function (milliseconds is the time for repeat parses)
+static void print_rate(const std::string& name,const double milliseconds,const unsigned int bytes,const unsigned int repeat)
+{
+	std::cout<<"\t"<<name<<"\t"<<milliseconds/repeat<<" ms\t"<<bytes*(double)repeat/1000.0/(milliseconds+0.001)<<" MB/s"<<std::endl;
+}
+
+//Main
+int main(int argc,char* argv[])
+{
+	unsigned int max_size=10*1000*1000;
+
+	if(argc>1)
+		max_size=msl::to_int(argv[1]);
+
+	bool run_old=true;
+
+	for(unsigned int size=1000;size<=max_size;size*=10)
+	{
+		std::string json_string=make_document(size);
+		unsigned int repeat=1+1000000/size;
+		std::cout<<json_string.size()<<" bytes:"<<std::endl;
+
+		//Old
+		if(run_old)
+		{
+			double start=msl::millis();
+
+			for(unsigned int ii=0;ii<repeat;++ii)
+			{
+				std::map<std::string,std::string> data;
+				old_json_parse(json_string,data);
+			}
+
+			double took=msl::millis()-start;
+			print_rate("old",took,json_string.size(),repeat);
+			run_old=(took/repeat<1000);
+		}
+		else
+		{
+			std::cout<<"\told\tskipped"<<std::endl;
+		}
+
+		//msl::json
+		msl::json flat;
+		double start=msl::millis();
+
+		for(unsigned int ii=0;ii<repeat;++ii)
+			flat=msl::json(json_string);
+
+		print_rate("json",msl::millis()-start,json_string.size(),repeat);
+
+		//msl::json_document (Reused, like a telemetry loop would)
+		msl::json_document document;
+		start=msl::millis();
+
+		for(unsigned int ii=0;ii<repeat;++ii)
+			document.parse(json_string);
+
+		print_rate("document",msl::millis()-start,json_string.size(),repeat);
+
+		//msl::json_parse
+		counting_handler counter;
+		start=msl::millis();
+
+		for(unsigned int ii=0;ii<repeat;++ii)
+			msl::json_parse(json_string.data(),json_string.size(),counter);
+
+		print_rate("sax",msl::millis()-start,json_string.size(),repeat);
+
+		if(flat.size()!=document.root().size())
+		{
+			std::cout<<"FAIL: json has "<<flat.size()<<" members, document has "<<document.root().size()<<std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
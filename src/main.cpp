@@ -40,6 +40,7 @@ int main(int argc,char* argv[])
 	int camera=0;
 	std::string serial_port="/dev/ttyUSB0";
 	unsigned int serial_baud=57600;
+	bool camera_tracking=false;
 
 	for(unsigned int ii=0;ii<command_line_args.size();++ii)
 	{
@@ -58,6 +59,10 @@ int main(int argc,char* argv[])
 			serial_baud=msl::to_int(command_line_args[ii+1]);
 			++ii;
 		}
+		else if(command_line_args[ii]=="--track")
+		{
+			camera_tracking=true;
+		}
 		else
 		{
 			std::cout<<"Unrecognized command line argument "<<command_line_args[ii]<<"!\n";
@@ -67,6 +72,7 @@ int main(int argc,char* argv[])
 
 	//Setup Camera
 	eye=new bullseye_keeper(camera,640,480);
+	eye->set_tracking(camera_tracking);
 
 	//Start MSL 2D
 	return msl::start_2d("Haggard",640,480);
@@ -0,0 +1,606 @@
+//File Cache Source
+//	Static file cache for the msl web servers, see file_cache.hpp.
+
+//Required Libraries:
+//	pthread
+
+//Definitions for "file_cache.hpp"
+#include "file_cache.hpp"
+
+//C Character Header
+#include <cctype>
+
+//C Standard IO Header
+#include <cstdio>
+
+//C Time Header
+#include <ctime>
+
+//String Stream Header
+#include <sstream>
+
+//Time Utility Header
+#include "time_util.hpp"
+
+//File Status Header
+#include <sys/stat.h>
+
+//Sendfile Headers (Linux only, everything else streams through a buffer)
+#if(defined(__linux__))
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <sys/sendfile.h>
+	#include <unistd.h>
+#endif
+
+//Don't Wait Flag (For sends that must not block)
+#if(defined(_WIN32)&&!defined(__CYGWIN__))
+	static const int dont_wait=0;
+#else
+	static const int dont_wait=MSG_DONTWAIT;
+#endif
+
+//HTTP Date Function (RFC 1123 date, built by hand so the locale can't change it)
+static std::string http_date(const time_t seconds)
+{
+	static const char* days[7]={"Sun","Mon","Tue","Wed","Thu","Fri","Sat"};
+	static const char* months[12]={"Jan","Feb","Mar","Apr","May","Jun","Jul","Aug","Sep","Oct","Nov","Dec"};
+
+	tm parts;
+
+	#if(defined(_WIN32)&&!defined(__CYGWIN__))
+		gmtime_s(&parts,&seconds);
+	#else
+		gmtime_r(&seconds,&parts);
+	#endif
+
+	char date[32];
+	sprintf(date,"%s, %02d %s %04d %02d:%02d:%02d GMT",days[parts.tm_wday],parts.tm_mday,months[parts.tm_mon],
+		parts.tm_year+1900,parts.tm_hour,parts.tm_min,parts.tm_sec);
+	return date;
+}
+
+//HTTP ETag Function (Size and modification time, changes whenever the file does)
+static std::string http_etag(const unsigned long file_size,const long mtime)
+{
+	char etag[48];
+	sprintf(etag,"\"%lx-%lx\"",file_size,(unsigned long)mtime);
+	return etag;
+}
+
+//Request Header Function (Value of a header in request, empty if it isn't there, name is lowercase)
+static std::string request_header(const std::string& request,const std::string& name)
+{
+	std::string::size_type line=request.find('\n');
+
+	while(line!=std::string::npos)
+	{
+		++line;
+		std::string::size_type end=request.find('\n',line);
+
+		if(end==std::string::npos)
+			end=request.size();
+
+		//Blank Line Ends the Headers
+		if(end==line||(end==line+1&&request[line]=='\r'))
+			break;
+
+		//Case Insensitive Name Match
+		bool match=(end-line>name.size()&&request[line+name.size()]==':');
+
+		for(unsigned int ii=0;match&&ii<name.size();++ii)
+			match=(tolower((unsigned char)request[line+ii])==name[ii]);
+
+		if(match)
+		{
+			std::string::size_type begin=line+name.size()+1;
+
+			while(begin<end&&(request[begin]==' '||request[begin]=='\t'))
+				++begin;
+
+			while(end>begin&&(request[end-1]=='\r'||request[end-1]==' '||request[end-1]=='\t'))
+				--end;
+
+			return request.substr(begin,end-begin);
+		}
+
+		line=request.find('\n',line);
+	}
+
+	return "";
+}
+
+//Not Modified Check Function (True if the client's copy is still good)
+static bool client_has_current(const std::string& request,const std::string& etag,const std::string& last_modified)
+{
+	std::string if_none_match=request_header(request,"if-none-match");
+
+	//If-None-Match Wins Over If-Modified-Since
+	if(if_none_match!="")
+		return (if_none_match=="*"||if_none_match.find(etag)!=std::string::npos);
+
+	return (request_header(request,"if-modified-since")==last_modified);
+}
+
+//HTTP Header Function (200 header with validators, same fields as msl::http_create_header)
+static std::string http_file_header(const unsigned long file_size,const long mtime,const std::string& mime_type,
+	const bool keep_alive)
+{
+	std::ostringstream header;
+	header<<"HTTP/1.1 200 OK\r\n";
+	header<<"Server: Super Lightning Automatic Systematic Wisdomatic Server 3000 v6.54.33.2.1a-177b-c Stable Beta\r\n";
+	header<<"Content-Length: "<<file_size<<"\r\n";
+	header<<"Content-Type: "<<mime_type<<"; charset=UTF-8\r\n";
+	header<<"ETag: "<<http_etag(file_size,mtime)<<"\r\n";
+	header<<"Last-Modified: "<<http_date(mtime)<<"\r\n";
+	header<<"Connection: "<<(keep_alive?"keep-alive":"close")<<"\r\n\r\n";
+	return header.str();
+}
+
+//HTTP Not Modified Function (304 header, no body)
+static std::string http_not_modified(const std::string& etag,const std::string& last_modified,const bool keep_alive)
+{
+	return "HTTP/1.1 304 Not Modified\r\nETag: "+etag+"\r\nLast-Modified: "+last_modified+
+		"\r\nConnection: "+(keep_alive?"keep-alive":"close")+"\r\n\r\n";
+}
+
+//Stream File Function (Sends an uncached file after its header, closes client if it gets cut short)
+static bool stream_file(msl::socket& client,const std::string& filename,const std::string& mime_type,
+	const unsigned long time_out,msl::pending_output* pending,const bool keep_alive)
+{
+	#if(defined(__linux__))
+		int file=open(filename.c_str(),O_RDONLY);
+
+		if(file<0)
+			return false;
+
+		struct stat info;
+
+		if(fstat(file,&info)!=0)
+		{
+			::close(file);
+			return false;
+		}
+
+		std::string header=http_file_header(info.st_size,info.st_mtime,mime_type,keep_alive);
+
+		//Leave What Doesn't Go Now for the Caller (pending closes the file)
+		if(pending!=NULL)
+		{
+			if(!pending->write(client,header.c_str(),header.size())||!pending->write_file(client,file,0,info.st_size))
+				client.close();
+
+			return true;
+		}
+
+		//Kernel Copies File to Socket
+		off_t offset=0;
+		unsigned long time_start=msl::millis();
+
+		if(client.write(header.c_str(),header.size(),time_out)==(int)header.size())
+		{
+			while(offset<info.st_size)
+			{
+				ssize_t sent=sendfile(client.system_socket(),file,&offset,info.st_size-offset);
+
+				//Only Retry a Full Send Buffer, Until time_out
+				if(sent==0||(sent<0&&((errno!=EAGAIN&&errno!=EINTR)||msl::millis()-time_start>=time_out)))
+					break;
+			}
+		}
+
+		::close(file);
+
+		if(offset<info.st_size)
+			client.close();
+
+		return true;
+	#else
+		FILE* file=fopen(filename.c_str(),"rb");
+
+		if(file==NULL)
+			return false;
+
+		struct stat info;
+
+		if(fstat(fileno(file),&info)!=0)
+		{
+			fclose(file);
+			return false;
+		}
+
+		std::string header=http_file_header(info.st_size,info.st_mtime,mime_type,keep_alive);
+		bool sent=(client.write(header.c_str(),header.size(),time_out)==(int)header.size());
+		unsigned long bytes_unsent=info.st_size;
+		char buffer[64*1024];
+
+		//Buffer at a Time
+		while(sent&&bytes_unsent>0)
+		{
+			size_t bytes_read=fread(buffer,1,sizeof(buffer),file);
+
+			if(bytes_read==0)
+				break;
+
+			sent=(client.write(buffer,bytes_read,time_out)==(int)bytes_read);
+			bytes_unsent-=bytes_read;
+		}
+
+		fclose(file);
+
+		if(!sent||bytes_unsent>0)
+			client.close();
+
+		return true;
+	#endif
+}
+
+//Pending Output Constructor (Default)
+msl::pending_output::pending_output():_sent(0),_file(-1),_offset(0),_end(0),_last_progress(0)
+{}
+
+//Pending Output Destructor (Closes the file, if any)
+msl::pending_output::~pending_output()
+{
+	#if(defined(__linux__))
+		if(_file>=0)
+			::close(_file);
+	#endif
+}
+
+//Empty Function (True once everything has been sent)
+bool msl::pending_output::empty() const
+{
+	return (_sent>=_bytes.size()&&_file<0);
+}
+
+//Write Function (Sends what client takes without waiting and keeps the rest, returns false if client broke)
+bool msl::pending_output::write(msl::socket& client,const void* buffer,const unsigned int size)
+{
+	const char* bytes=reinterpret_cast<const char*>(buffer);
+	unsigned int sent=0;
+
+	//Nothing Queued Ahead, Try Now
+	if(empty())
+	{
+		int ret=client.write(bytes,size,0,dont_wait);
+
+		if(ret<0)
+			return false;
+
+		sent=ret;
+		_last_progress=msl::millis();
+	}
+
+	_bytes.append(bytes+sent,size-sent);
+	return true;
+}
+
+//Write File Function (Like write, for size bytes of file starting at offset, takes the file and closes it when done)
+bool msl::pending_output::write_file(msl::socket& client,const int file,const long long offset,const long long size)
+{
+	#if(defined(__linux__))
+		if(_file>=0)
+			::close(_file);
+
+		if(empty())
+			_last_progress=msl::millis();
+
+		_file=file;
+		_offset=offset;
+		_end=offset+size;
+		return flush(client);
+	#else
+		return false;
+	#endif
+}
+
+//Flush Function (Sends what client takes of what's kept, without waiting, returns false if client broke)
+bool msl::pending_output::flush(msl::socket& client)
+{
+	//Bytes First
+	if(_sent<_bytes.size())
+	{
+		int ret=client.write(_bytes.c_str()+_sent,_bytes.size()-_sent,0,dont_wait);
+
+		if(ret<0)
+			return false;
+
+		if(ret>0)
+			_last_progress=msl::millis();
+
+		_sent+=ret;
+
+		if(_sent<_bytes.size())
+			return true;
+	}
+
+	_bytes.clear();
+	_sent=0;
+
+	//Then the File (Kernel copies it, a full send buffer just means try again later)
+	#if(defined(__linux__))
+		while(_file>=0)
+		{
+			off_t offset=_offset;
+			ssize_t sent=0;
+
+			//sendfile has no don't wait flag, so make the socket non-blocking just for it
+			if(_offset<_end)
+			{
+				int flags=fcntl(client.system_socket(),F_GETFL,0);
+				fcntl(client.system_socket(),F_SETFL,flags|O_NONBLOCK);
+				sent=sendfile(client.system_socket(),_file,&offset,_end-_offset);
+				int error=errno;
+				fcntl(client.system_socket(),F_SETFL,flags);
+				errno=error;
+			}
+
+			if(sent<0&&(errno==EAGAIN||errno==EINTR))
+				break;
+
+			//Done, Or File Got Shorter, Or Socket Broke
+			if(sent<=0||offset>=_end)
+			{
+				::close(_file);
+				_file=-1;
+
+				if(offset<_end)
+					return false;
+
+				break;
+			}
+
+			_offset=offset;
+			_last_progress=msl::millis();
+		}
+	#endif
+
+	return true;
+}
+
+//Last Progress Accessor (msl::millis() when bytes last went out, or when bytes were first kept)
+unsigned long msl::pending_output::last_progress() const
+{
+	return _last_progress;
+}
+
+//File Cache Constructor
+msl::file_cache::file_cache(const unsigned long max_size,const unsigned long max_file_size):_max_size(max_size),
+	_max_file_size(max_file_size),_size(0),_hits(0),_misses(0),_not_modified(0)
+{
+	pthread_mutex_init(&_lock,NULL);
+}
+
+//File Cache Destructor
+msl::file_cache::~file_cache()
+{
+	clear();
+	pthread_mutex_destroy(&_lock);
+}
+
+//Serve Function (Writes filename to client as an HTTP response, returns false if it can't be read)
+bool msl::file_cache::serve(msl::socket& client,const std::string& filename,const std::string& mime_type,
+	const std::string& request,const unsigned long time_out,msl::pending_output* pending,const bool keep_alive)
+{
+	//One stat Validates the Cache (No Reads)
+	struct stat info;
+
+	if(stat(filename.c_str(),&info)!=0||(info.st_mode&S_IFMT)!=S_IFREG)
+		return false;
+
+	//Client Already Has It
+	std::string etag=http_etag(info.st_size,info.st_mtime);
+	std::string last_modified=http_date(info.st_mtime);
+
+	if(client_has_current(request,etag,last_modified))
+	{
+		pthread_mutex_lock(&_lock);
+		++_not_modified;
+		pthread_mutex_unlock(&_lock);
+
+		std::string response=http_not_modified(etag,last_modified,keep_alive);
+
+		if(pending==NULL)
+			client.write(response.c_str(),response.size(),time_out);
+		else if(!pending->write(client,response.c_str(),response.size()))
+			client.close();
+
+		return true;
+	}
+
+	//Too Big to Cache
+	if((unsigned long)info.st_size>_max_file_size)
+	{
+		pthread_mutex_lock(&_lock);
+		++_misses;
+		pthread_mutex_unlock(&_lock);
+
+		return stream_file(client,filename,mime_type,time_out,pending,keep_alive);
+	}
+
+	//Check Cache
+	pthread_mutex_lock(&_lock);
+	entry_t* entry=lookup(filename,info.st_mtime,info.st_size);
+
+	if(entry!=NULL)
+		++_hits;
+	else
+		++_misses;
+
+	pthread_mutex_unlock(&_lock);
+
+	//Load File (Outside the lock, header and body in one buffer)
+	if(entry==NULL)
+	{
+		FILE* file=fopen(filename.c_str(),"rb");
+
+		if(file==NULL)
+			return false;
+
+		//Key the Entry on What Was Actually Opened
+		if(fstat(fileno(file),&info)!=0)
+		{
+			fclose(file);
+			return false;
+		}
+
+		entry=new entry_t;
+		entry->filename=filename;
+		entry->mtime=info.st_mtime;
+		entry->file_size=info.st_size;
+		entry->response=http_file_header(info.st_size,info.st_mtime,mime_type,true);
+		entry->header_size=entry->response.size();
+		entry->references=0;
+		entry->evicted=false;
+
+		entry->response.resize(entry->header_size+entry->file_size);
+		bool loaded=(entry->file_size==0||fread(&entry->response[entry->header_size],1,entry->file_size,file)==entry->file_size);
+		fclose(file);
+
+		//Changed While Reading
+		if(!loaded)
+		{
+			delete entry;
+			return false;
+		}
+
+		pthread_mutex_lock(&_lock);
+		entry=insert(entry);
+		pthread_mutex_unlock(&_lock);
+	}
+
+	//Send (Entry can't be freed while referenced, pending copies what it keeps)
+	//	Entries are cached with a keep-alive header, a closing response gets a copy with its own.
+	const std::string* response=&entry->response;
+	std::string closing_response;
+
+	if(!keep_alive)
+	{
+		closing_response=http_file_header(entry->file_size,entry->mtime,mime_type,false);
+		closing_response.append(entry->response,entry->header_size,std::string::npos);
+		response=&closing_response;
+	}
+
+	if(pending==NULL)
+		client.write(response->c_str(),response->size(),time_out);
+	else if(!pending->write(client,response->c_str(),response->size()))
+		client.close();
+
+	pthread_mutex_lock(&_lock);
+	release(entry);
+	pthread_mutex_unlock(&_lock);
+
+	return true;
+}
+
+//Clear Function (Drops every cached file)
+void msl::file_cache::clear()
+{
+	pthread_mutex_lock(&_lock);
+
+	while(_lru.size()>0)
+		evict(_lru.back());
+
+	pthread_mutex_unlock(&_lock);
+}
+
+//Size Accessor (Bytes cached right now)
+unsigned long msl::file_cache::size() const
+{
+	pthread_mutex_lock(&_lock);
+	unsigned long size=_size;
+	pthread_mutex_unlock(&_lock);
+	return size;
+}
+
+//Hits Accessor (Requests answered from memory)
+unsigned long msl::file_cache::hits() const
+{
+	pthread_mutex_lock(&_lock);
+	unsigned long hits=_hits;
+	pthread_mutex_unlock(&_lock);
+	return hits;
+}
+
+//Misses Accessor (Requests read from disk)
+unsigned long msl::file_cache::misses() const
+{
+	pthread_mutex_lock(&_lock);
+	unsigned long misses=_misses;
+	pthread_mutex_unlock(&_lock);
+	return misses;
+}
+
+//Not Modified Accessor (Requests answered with 304)
+unsigned long msl::file_cache::not_modified() const
+{
+	pthread_mutex_lock(&_lock);
+	unsigned long not_modified=_not_modified;
+	pthread_mutex_unlock(&_lock);
+	return not_modified;
+}
+
+//Lookup Function (Referenced entry if filename is cached and unchanged, else NULL, stale entries are evicted)
+msl::file_cache::entry_t* msl::file_cache::lookup(const std::string& filename,const long mtime,const unsigned long file_size)
+{
+	std::map<std::string,entry_t*>::iterator found=_entries.find(filename);
+
+	if(found==_entries.end())
+		return NULL;
+
+	entry_t* entry=found->second;
+
+	if(entry->mtime!=mtime||entry->file_size!=file_size)
+	{
+		evict(entry);
+		return NULL;
+	}
+
+	//Most Recently Used Goes to the Front
+	_lru.splice(_lru.begin(),_lru,entry->lru);
+	++entry->references;
+	return entry;
+}
+
+//Insert Function (Adds a loaded entry, replacing any older copy, returns it referenced)
+msl::file_cache::entry_t* msl::file_cache::insert(entry_t* entry)
+{
+	std::map<std::string,entry_t*>::iterator found=_entries.find(entry->filename);
+
+	if(found!=_entries.end())
+		evict(found->second);
+
+	_lru.push_front(entry);
+	entry->lru=_lru.begin();
+	entry->references=1;
+	_entries[entry->filename]=entry;
+	_size+=entry->response.size();
+
+	//Least Recently Used Go First (Even the new one, if it doesn't fit at all)
+	while(_size>_max_size&&_lru.size()>0)
+		evict(_lru.back());
+
+	return entry;
+}
+
+//Evict Function (Removes entry from the cache, freeing it once unreferenced)
+void msl::file_cache::evict(entry_t* entry)
+{
+	_entries.erase(entry->filename);
+	_lru.erase(entry->lru);
+	_size-=entry->response.size();
+	entry->evicted=true;
+
+	if(entry->references==0)
+		delete entry;
+}
+
+//Release Function (Drops a reference taken by lookup or insert)
+void msl::file_cache::release(entry_t* entry)
+{
+	--entry->references;
+
+	if(entry->evicted&&entry->references==0)
+		delete entry;
+}
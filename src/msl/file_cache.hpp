@@ -0,0 +1,151 @@
+//File Cache Header
+//	Static file cache for the msl web servers.  Each cached file is kept as a
+//	ready to send response (headers and body in one buffer), validated against
+//	the file's modification time and size on every request, and evicted least
+//	recently used first.  Files bigger than the per-file limit are not cached,
+//	they go straight from disk to the socket (sendfile on Linux).
+//
+//	Passing serve a pending_output makes it never wait on the client: it sends
+//	what the socket takes right away and leaves the rest in the pending_output
+//	for the caller to flush when the socket is writable (the web server's
+//	event loop mode does this).
+
+//Required Libraries:
+//	pthread
+
+//Begin Define Guards
+#ifndef MSL_FILE_CACHE_H
+#define MSL_FILE_CACHE_H
+
+//List Header
+#include <list>
+
+//Map Header
+#include <map>
+
+//PThread Header
+#include <pthread.h>
+
+//Socket Header
+#include "socket.hpp"
+
+//String Header
+#include <string>
+
+//MSL Namespace
+namespace msl
+{
+	//Pending Output Class Declaration (Bytes, then maybe the rest of a file, that a non-blocking write couldn't send yet)
+	class pending_output
+	{
+		public:
+			//Constructor (Default)
+			pending_output();
+
+			//Destructor (Closes the file, if any)
+			~pending_output();
+
+			//Empty Function (True once everything has been sent)
+			bool empty() const;
+
+			//Write Function (Sends what client takes without waiting and keeps the rest, returns false if client broke)
+			bool write(msl::socket& client,const void* buffer,const unsigned int size);
+
+			//Write File Function (Like write, for size bytes of file starting at offset, takes the file and closes it when done)
+			//	Linux only, everywhere else serve streams files itself.
+			bool write_file(msl::socket& client,const int file,const long long offset,const long long size);
+
+			//Flush Function (Sends what client takes of what's kept, without waiting, returns false if client broke)
+			bool flush(msl::socket& client);
+
+			//Last Progress Accessor (msl::millis() when bytes last went out, or when bytes were first kept)
+			unsigned long last_progress() const;
+
+		private:
+			//Copy Constructor (Deleted)
+			pending_output(const msl::pending_output& copy);
+
+			//Copy Assignment Operator (Deleted)
+			msl::pending_output& operator=(const msl::pending_output& copy);
+
+			//Member Variables
+			std::string _bytes;
+			unsigned int _sent;
+			int _file;
+			long long _offset;
+			long long _end;
+			unsigned long _last_progress;
+	};
+
+	//File Cache Class Declaration
+	class file_cache
+	{
+		public:
+			//Constructor (Sizes in bytes, default is 32 MB total and 1 MB per file)
+			file_cache(const unsigned long max_size=32*1024*1024,const unsigned long max_file_size=1024*1024);
+
+			//Destructor
+			~file_cache();
+
+			//Serve Function (Writes filename to client as an HTTP response, returns false if it can't be read)
+			//	request is the client's whole request, a matching If-None-Match or
+			//	If-Modified-Since gets a 304 Not Modified with no body.  If pending
+			//	isn't NULL, time_out is ignored and whatever client won't take right
+			//	away is left in pending (which must be empty to start with).  Pass
+			//	keep_alive false if the caller will close client after this response.
+			bool serve(msl::socket& client,const std::string& filename,const std::string& mime_type,
+				const std::string& request,const unsigned long time_out=120000,msl::pending_output* pending=NULL,
+				const bool keep_alive=true);
+
+			//Clear Function (Drops every cached file)
+			void clear();
+
+			//Size Accessor (Bytes cached right now)
+			unsigned long size() const;
+
+			//Statistics Accessors (Requests answered from memory, read from disk, and answered with 304)
+			unsigned long hits() const;
+			unsigned long misses() const;
+			unsigned long not_modified() const;
+
+		private:
+			//Cache Entry (Freed when evicted and nobody is still writing it out)
+			struct entry_t
+			{
+				std::string filename;
+				long mtime;
+				unsigned long file_size;
+				std::string response;
+				unsigned long header_size;
+				unsigned int references;
+				bool evicted;
+				std::list<entry_t*>::iterator lru;
+			};
+
+			//Copy Constructor (Deleted)
+			file_cache(const msl::file_cache& copy);
+
+			//Copy Assignment Operator (Deleted)
+			msl::file_cache& operator=(const msl::file_cache& copy);
+
+			//Cache Functions (Call with _lock held)
+			entry_t* lookup(const std::string& filename,const long mtime,const unsigned long file_size);
+			entry_t* insert(entry_t* entry);
+			void evict(entry_t* entry);
+			void release(entry_t* entry);
+
+			//Member Variables
+			std::map<std::string,entry_t*> _entries;
+			std::list<entry_t*> _lru;
+			mutable pthread_mutex_t _lock;
+			unsigned long _max_size;
+			unsigned long _max_file_size;
+			unsigned long _size;
+			unsigned long _hits;
+			unsigned long _misses;
+			unsigned long _not_modified;
+	};
+}
+
+//End Define Guards
+#endif
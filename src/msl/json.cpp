@@ -5,292 +5,1185 @@
 //Definitions for "json.hpp"
 #include "json.hpp"
 
-//Stream Out Operator
-std::ostream& operator<<(std::ostream& lhs,const msl::json& rhs)
-{
-	return (lhs<<rhs.str());
-}
+//C Character Header
+#include <cctype>
 
-//Constructor (Default, if error is found json contains only only entry, "error".
-//	Error is an object containing "what", the error message, and "position",
-//	the position of the error in the passed string.)
-msl::json::json(const std::string& json_string)
-{
-	//Error Variables
-	bool error=false;
-	unsigned int error_position=1;
-	std::string error_what="";
+//C Standard IO Header
+#include <cstdio>
 
-	//Get Data Between Brackets
-	std::string temp=msl::extract_between(json_string,'{','}',false);
+//C Standard Library Header
+#include <cstdlib>
 
-	//Parse Data
-	while(temp.size()>0)
-	{
-		//Remove Whitespace
-		while(temp.size()>0&&isspace(temp[0]))
-		{
-			temp.erase(0,1);
-			++error_position;
-		}
+//C Math Header
+#include <cmath>
+
+//C String Header
+#include <cstring>
 
-		//Variable Name Variable
-		std::string var;
+//JSON Parser Class (One pass over the text, open containers kept on a stack instead of recursing)
+class json_parser
+{
+	public:
+		json_parser(const char* text,const unsigned int size,msl::json_handler& handler):_text(text),_size(size),
+			_position(0),_handler(handler),_error(NULL)
+		{}
 
-		//Get Variable Name (With "")
-		if(temp[0]=='\"')
+		//Parse Function (Returns false on error, see error() and position())
+		bool parse()
 		{
-			var=msl::extract_between(temp,'\"','\"',true);
-			temp.erase(0,var.size());
-			var=msl::extract_between(var,'\"','\"',false);
+			while(true)
+			{
+				//Value
+				skip_whitespace();
+
+				if(_position>=_size)
+					return fail("unexpected end of input");
+
+				char symbol=_text[_position];
+
+				if(symbol=='{')
+				{
+					++_position;
+
+					if(!_handler.start_object())
+						return fail("stopped by handler");
+
+					skip_whitespace();
+
+					if(_position<_size&&_text[_position]=='}')
+					{
+						++_position;
+
+						if(!_handler.end_object())
+							return fail("stopped by handler");
+					}
+					else
+					{
+						_containers.push_back('{');
+
+						if(!parse_key())
+							return false;
+
+						continue;
+					}
+				}
+				else if(symbol=='[')
+				{
+					++_position;
+
+					if(!_handler.start_array())
+						return fail("stopped by handler");
+
+					skip_whitespace();
+
+					if(_position<_size&&_text[_position]==']')
+					{
+						++_position;
+
+						if(!_handler.end_array())
+							return fail("stopped by handler");
+					}
+					else
+					{
+						_containers.push_back('[');
+						continue;
+					}
+				}
+				else if(symbol=='\"'||symbol=='\'')
+				{
+					if(!parse_string(false))
+						return false;
+				}
+				else if(symbol=='t')
+				{
+					if(!parse_literal("true",4))
+						return false;
+
+					if(!_handler.boolean(true))
+						return fail("stopped by handler");
+				}
+				else if(symbol=='f')
+				{
+					if(!parse_literal("false",5))
+						return false;
+
+					if(!_handler.boolean(false))
+						return fail("stopped by handler");
+				}
+				else if(symbol=='n')
+				{
+					if(!parse_literal("null",4))
+						return false;
+
+					if(!_handler.null_value())
+						return fail("stopped by handler");
+				}
+				else if(symbol=='-'||isdigit((unsigned char)symbol))
+				{
+					if(!parse_number())
+						return false;
+				}
+				else
+				{
+					return fail("invalid variable value");
+				}
+
+				//After a Value (Close finished containers, or move on to the next element)
+				while(true)
+				{
+					skip_whitespace();
+
+					if(_containers.size()==0)
+					{
+						if(_position<_size)
+							return fail("unexpected data after value");
+
+						return true;
+					}
+
+					if(_position>=_size)
+						return fail("unexpected end of input");
+
+					char container=_containers[_containers.size()-1];
+					symbol=_text[_position];
+
+					if(symbol==',')
+					{
+						++_position;
+
+						if(container=='{'&&!parse_key())
+							return false;
+
+						break;
+					}
+
+					if((container=='{'&&symbol=='}')||(container=='['&&symbol==']'))
+					{
+						++_position;
+						_containers.pop_back();
+
+						if(!(container=='{'?_handler.end_object():_handler.end_array()))
+							return fail("stopped by handler");
+
+						continue;
+					}
+
+					return fail("comma expected");
+				}
+			}
 		}
 
-		//Get Variable Name (With '')
-		else if(temp[0]=='\'')
+		//Error Accessor (NULL if there wasn't one)
+		const char* error() const
 		{
-			var=msl::extract_between(temp,'\'','\'',true);
-			temp.erase(0,var.size());
-			var=msl::extract_between(var,'\'','\'',false);
+			return _error;
 		}
 
-		//Update Error Postion
-		++error_position;
-
-		//Bad Variable Name
-		if(var=="")
+		//Position Accessor (Byte offset of the error)
+		unsigned int position() const
 		{
-			error_what="bad variable name";
-			error=true;
-			break;
+			return _position;
 		}
 
-		//Update Error Position
-		error_position+=var.size();
-		++error_position;
-
-		//Remove Whitespace
-		while(temp.size()>0&&isspace(temp[0]))
+	private:
+		//Fail Function (Records the error, always returns false)
+		bool fail(const char* what)
 		{
-			temp.erase(0,1);
-			++error_position;
+			_error=what;
+			return false;
 		}
 
-		//Remove Colon
-		if(temp.size()>0&&temp[0]==':')
+		//Skip Whitespace Function
+		void skip_whitespace()
 		{
-			temp.erase(0,1);
-			++error_position;
+			while(_position<_size&&isspace((unsigned char)_text[_position]))
+				++_position;
 		}
 
-		//No Colon, Error
-		else
+		//Parse Key Function (Object member name and its colon)
+		bool parse_key()
 		{
-			error_what="colon expected";
-			error=true;
-			break;
+			skip_whitespace();
+
+			if(_position>=_size||(_text[_position]!='\"'&&_text[_position]!='\''))
+				return fail("bad variable name");
+
+			if(!parse_string(true))
+				return false;
+
+			skip_whitespace();
+
+			if(_position>=_size||_text[_position]!=':')
+				return fail("colon expected");
+
+			++_position;
+			return true;
 		}
 
-		//Remove Whitespace
-		while(temp.size()>0&&isspace(temp[0]))
+		//Parse Literal Function (true, false, and null)
+		bool parse_literal(const char* literal,const unsigned int length)
 		{
-			temp.erase(0,1);
-			++error_position;
-		}
+			if(_size-_position<length||strncmp(_text+_position,literal,length)!=0)
+				return fail("invalid variable value");
 
-		//Variable Value Variable
-		std::string val="";
+			_position+=length;
+			return true;
+		}
 
-		//Check Size
-		if(temp.size()>0)
+		//Parse Hex Function (Four digits of a \u escape)
+		bool parse_hex(unsigned int& value)
 		{
-			//Extract Object
-			if(temp[0]=='{')
+			if(_size-_position<4)
+				return false;
+
+			value=0;
+
+			for(unsigned int ii=0;ii<4;++ii)
 			{
-				//Get Object
-				val=msl::extract_between(temp,'{','}',true);
-				temp.erase(0,val.size());
-				error_position+=val.size();
+				char digit=_text[_position++];
+				value<<=4;
+
+				if(digit>='0'&&digit<='9')
+					value|=digit-'0';
+				else if(digit>='a'&&digit<='f')
+					value|=digit-'a'+10;
+				else if(digit>='A'&&digit<='F')
+					value|=digit-'A'+10;
+				else
+					return false;
 			}
 
-			//Extract String ("" || '')
-			else if(temp[0]=='\"'||temp[0]=='\'')
+			return true;
+		}
+
+		//Parse String Function (Strings without escapes go to the handler straight out of the text)
+		bool parse_string(const bool is_key)
+		{
+			char quote=_text[_position++];
+			unsigned int start=_position;
+
+			while(_position<_size&&_text[_position]!=quote&&_text[_position]!='\\')
+				++_position;
+
+			if(_position>=_size)
+				return fail("invalid string");
+
+			const char* value=_text+start;
+			unsigned int length=_position-start;
+
+			//Decode Escapes
+			if(_text[_position]=='\\')
 			{
-				//Get String
-				val=msl::extract_until(temp,',',false);
+				_scratch.assign(value,length);
 
-				//Check for Commas in Strings
-				while(true)
+				while(_position<_size&&_text[_position]!=quote)
 				{
-					//Temp Copy of Val
-					std::string check_for_comma_in_string=val;
+					char symbol=_text[_position++];
+
+					if(symbol!='\\')
+					{
+						_scratch+=symbol;
+						continue;
+					}
+
+					if(_position>=_size)
+						break;
 
-					//Remove Whitespace At End of String
-					while(check_for_comma_in_string.size()>0&&std::isspace(val[check_for_comma_in_string.size()-1]))
-						check_for_comma_in_string.erase(check_for_comma_in_string.size()-1,1);
+					symbol=_text[_position++];
 
-					//If Comma Found
-					if(check_for_comma_in_string.size()>0&&check_for_comma_in_string[check_for_comma_in_string.size()-1]!=temp[0])
+					if(symbol=='b')
+						_scratch+='\b';
+					else if(symbol=='f')
+						_scratch+='\f';
+					else if(symbol=='n')
+						_scratch+='\n';
+					else if(symbol=='r')
+						_scratch+='\r';
+					else if(symbol=='t')
+						_scratch+='\t';
+					else if(symbol=='u')
 					{
-						//Add Comma
-						val+=',';
+						unsigned int code=0;
 
-						//Get Rest of String
-						std::string val_add=msl::extract_until(temp.substr(val.size(),temp.size()-val.size()),',',false);
+						if(!parse_hex(code))
+							return fail("invalid string");
 
-						//Nothing Found, Break
-						if(val_add.size()==0)
-							break;
+						//Surrogate Pair
+						if(code>=0xd800&&code<0xdc00&&_size-_position>=6&&_text[_position]=='\\'&&_text[_position+1]=='u')
+						{
+							unsigned int low=0;
+							_position+=2;
 
-						//Add Rest of Value to Value String
-						val+=val_add;
-					}
+							if(!parse_hex(low)||low<0xdc00||low>=0xe000)
+								return fail("invalid string");
 
-					//If No Comma, Break
+							code=0x10000+((code-0xd800)<<10)+(low-0xdc00);
+						}
+
+						append_utf8(code);
+					}
 					else
 					{
-						break;
+						_scratch+=symbol;
 					}
 				}
 
-				//Remove Extracted Data
-				temp.erase(0,val.size());
-
-				//Update Error Position
-				error_position+=val.size();
-
-				//Remove Whitespace At End of String
-				while(val.size()>0&&std::isspace(val[val.size()-1]))
-					val.erase(val.size()-1,1);
+				if(_position>=_size)
+					return fail("invalid string");
 
-				//Valid String, Remove Quotes
-				if((val.size()>=2&&val[0]=='\"'&&val[val.size()-1]=='\"')||(val.size()>=2&&val[0]=='\''&&val[val.size()-1]=='\''))
-				{
-					val=val.substr(1,val.size()-2);
-				}
-				//Bad String
-				else
-				{
-					error_what="invalid string";
-					error=true;
-					break;
-				}
+				value=_scratch.c_str();
+				length=_scratch.size();
 			}
 
-			//Extract Boolean
-			else if(msl::starts_with(msl::to_lower(temp),"true")||msl::starts_with(msl::to_lower(temp),"false"))
-			{
-				//Get Boolean
-				val=msl::to_lower(msl::extract_until(temp,',',false));
-				temp.erase(0,val.size());
-
-				//Keep Old Val Size, For Error Position Later On
-				unsigned int old_val_size=val.size();
+			//Skip Closing Quote
+			++_position;
 
-				//Remove Whitespace At End of Boolean
-				while(val.size()>0&&std::isspace(val[val.size()-1]))
-					val.erase(val.size()-1,1);
+			if(!(is_key?_handler.key(value,length):_handler.string(value,length)))
+				return fail("stopped by handler");
 
-				//Check for Good Boolean
-				if(val=="true"||val=="false")
-				{
-					//Update Error Position
-					error_position+=old_val_size-val.size();
-				}
+			return true;
+		}
 
-				//Error
-				else
-				{
-					error_what="invalid variable value";
-					error=true;
-				}
+		//Append UTF-8 Function (Encodes a \u escape)
+		void append_utf8(const unsigned int code)
+		{
+			if(code<0x80)
+			{
+				_scratch+=(char)code;
+			}
+			else if(code<0x800)
+			{
+				_scratch+=(char)(0xc0|(code>>6));
+				_scratch+=(char)(0x80|(code&0x3f));
+			}
+			else if(code<0x10000)
+			{
+				_scratch+=(char)(0xe0|(code>>12));
+				_scratch+=(char)(0x80|((code>>6)&0x3f));
+				_scratch+=(char)(0x80|(code&0x3f));
 			}
-
-			//Extract Number
 			else
 			{
-				//Get Number
-				val=msl::extract_until(temp,',',false);
-				temp.erase(0,val.size());
+				_scratch+=(char)(0xf0|(code>>18));
+				_scratch+=(char)(0x80|((code>>12)&0x3f));
+				_scratch+=(char)(0x80|((code>>6)&0x3f));
+				_scratch+=(char)(0x80|(code&0x3f));
+			}
+		}
 
-				//Keep Old Val Size, For Error Position Later On
-				unsigned int old_val_size=val.size();
+		//Parse Number Function (Small integers are converted by hand, everything else by strtod)
+		bool parse_number()
+		{
+			unsigned int start=_position;
+			bool negative=false;
+			bool integer=true;
+			double value=0;
 
-				//Remove Whitespace At End of Number
-				while(val.size()>0&&std::isspace(val[val.size()-1]))
-					val.erase(val.size()-1,1);
+			if(_text[_position]=='-')
+			{
+				negative=true;
+				++_position;
+			}
 
-				//Period Finder
-				bool found_period=false;
+			unsigned int digits_start=_position;
 
-				//Check for Valid Number
-				for(unsigned int ii=0;ii<val.size();++ii)
-				{
-					//Non-Number or Period or Mutiple Periods
-					if((!std::isdigit(val[ii])&&val[ii]!='.'&&val[ii]!='-')||
-						(val[ii]=='.'&&found_period)||((val[ii]=='-'&&ii!=0)))
-					{
-						error_what="invalid variable value";
-						error=true;
-						break;
-					}
+			while(_position<_size&&isdigit((unsigned char)_text[_position]))
+				value=value*10+(_text[_position++]-'0');
 
-					//Look for Multiple Periods
-					if(val[ii]=='.')
-						found_period=true;
+			if(_position==digits_start)
+				return fail("invalid variable value");
 
-					//Update Error Position
-					++error_position;
-				}
+			//Fraction
+			if(_position<_size&&_text[_position]=='.')
+			{
+				integer=false;
+				++_position;
+				unsigned int fraction_start=_position;
 
-				//Update Error Position
-				error_position+=old_val_size-val.size();
+				while(_position<_size&&isdigit((unsigned char)_text[_position]))
+					++_position;
+
+				if(_position==fraction_start)
+					return fail("invalid variable value");
 			}
 
-			//Remove Whitespace
-			while(temp.size()>0&&isspace(temp[0]))
+			//Exponent
+			if(_position<_size&&(_text[_position]=='e'||_text[_position]=='E'))
 			{
-				temp.erase(0,1);
-				++error_position;
+				integer=false;
+				++_position;
+
+				if(_position<_size&&(_text[_position]=='+'||_text[_position]=='-'))
+					++_position;
+
+				unsigned int exponent_start=_position;
+
+				while(_position<_size&&isdigit((unsigned char)_text[_position]))
+					++_position;
+
+				if(_position==exponent_start)
+					return fail("invalid variable value");
 			}
 
-			//Remove Comma
-			if(temp.size()>0&&temp[0]==',')
+			unsigned int length=_position-start;
+
+			//Integers up to 15 digits are exact in a double
+			if(integer&&_position-digits_start<=15)
 			{
-				temp.erase(0,1);
-				++error_position;
+				if(negative)
+					value=-value;
 			}
-
-			//No Comma, Error
-			else if(temp.size()>0)
+			else
 			{
-				error_what="comma expected";
-				error=true;
-				break;
+				_scratch.assign(_text+start,length);
+				value=strtod(_scratch.c_str(),NULL);
 			}
+
+			if(!_handler.number(value,_text+start,length))
+				return fail("stopped by handler");
+
+			return true;
 		}
 
-		//On Error
+		const char* _text;
+		unsigned int _size;
+		unsigned int _position;
+		msl::json_handler& _handler;
+		const char* _error;
+		std::vector<char> _containers;
+		std::string _scratch;
+};
+
+//Write String Function (Appends value as a quoted JSON string)
+static void json_write_string(std::string& json_string,const char* value,const unsigned int length)
+{
+	json_string+='\"';
+
+	for(unsigned int ii=0;ii<length;++ii)
+	{
+		unsigned char symbol=value[ii];
+
+		if(symbol=='\"')
+			json_string+="\\\"";
+		else if(symbol=='\\')
+			json_string+="\\\\";
+		else if(symbol=='\n')
+			json_string+="\\n";
+		else if(symbol=='\r')
+			json_string+="\\r";
+		else if(symbol=='\t')
+			json_string+="\\t";
+		else if(symbol<0x20)
+		{
+			char escape[8];
+			sprintf(escape,"\\u%04x",symbol);
+			json_string+=escape;
+		}
 		else
+			json_string+=(char)symbol;
+	}
+
+	json_string+='\"';
+}
+
+//Write Fixed Function (Writes value with at most max_decimals decimals if some count of
+//	decimals parses back to value, returns false if none does or value is max_magnitude or more)
+template<typename T> static bool json_write_fixed(std::string& json_string,const T value,const int max_decimals,
+	const double max_magnitude)
+{
+	double magnitude=fabs((double)value);
+	double scale=1;
+
+	if(magnitude>=max_magnitude)
+		return false;
+
+	for(int decimals=0;decimals<=max_decimals&&magnitude*scale<1e15;++decimals,scale*=10)
+	{
+		double scaled=floor(magnitude*scale+0.5);
+
+		//Parses Back (Reader rounds the decimal to a double, then to T)
+		if((T)(scaled/scale)!=(T)magnitude)
+			continue;
+
+		char digits[24];
+		int length=0;
+		unsigned long long number=(unsigned long long)scaled;
+
+		do
+		{
+			digits[length++]='0'+number%10;
+			number/=10;
+		}
+		while(number>0||length<=decimals);
+
+		if(value<0)
+			json_string+='-';
+
+		while(length>0)
 		{
-			error_what="unexpected end of object";
-			error=true;
+			if(length==decimals)
+				json_string+='.';
+
+			json_string+=digits[--length];
 		}
 
-		//Add Variable
-		set(var,val);
+		return true;
 	}
 
-	//On Errors
-	if(error)
+	return false;
+}
+
+//Write Number Function (Fewest significant digits that parse back to value)
+template<typename T> static void json_write_number(std::string& json_string,const T value,const int max_decimals,
+	const double max_magnitude,const int min_precision,const int max_precision)
+{
+	//NaN and Infinity Aren't JSON
+	if(value!=value||value-value!=0)
+	{
+		json_string+="null";
+		return;
+	}
+
+	//Fast Path (Plain decimals, which is nearly everything a robot sends)
+	if(json_write_fixed(json_string,value,max_decimals,max_magnitude))
+		return;
+
+	//Slow Path (Big, tiny, or long numbers, every precision below min_precision
+	//	that would parse back is trimmed to its shortest form by %g anyway)
+	char number[32];
+
+	for(int precision=min_precision;precision<=max_precision;++precision)
+	{
+		sprintf(number,"%.*g",precision,(double)value);
+
+		if((T)strtod(number,NULL)==value)
+			break;
+	}
+
+	json_string+=number;
+}
+
+//Write Integer Function
+static void json_write_int(std::string& json_string,const int value)
+{
+	char digits[16];
+	int length=0;
+	unsigned int number=(value<0)?0u-(unsigned int)value:(unsigned int)value;
+
+	do
+	{
+		digits[length++]='0'+number%10;
+		number/=10;
+	}
+	while(number>0);
+
+	if(value<0)
+		json_string+='-';
+
+	while(length>0)
+		json_string+=digits[--length];
+}
+
+//Stream Out Operator
+std::ostream& operator<<(std::ostream& lhs,const msl::json& rhs)
+{
+	return (lhs<<rhs.str());
+}
+
+//JSON Handler Destructor
+msl::json_handler::~json_handler()
+{}
+
+//JSON Handler Default Callbacks (Ignore everything)
+bool msl::json_handler::null_value()
+{
+	return true;
+}
+
+bool msl::json_handler::boolean(const bool)
+{
+	return true;
+}
+
+bool msl::json_handler::number(const double,const char*,const unsigned int)
+{
+	return true;
+}
+
+bool msl::json_handler::string(const char*,const unsigned int)
+{
+	return true;
+}
+
+bool msl::json_handler::start_object()
+{
+	return true;
+}
+
+bool msl::json_handler::key(const char*,const unsigned int)
+{
+	return true;
+}
+
+bool msl::json_handler::end_object()
+{
+	return true;
+}
+
+bool msl::json_handler::start_array()
+{
+	return true;
+}
+
+bool msl::json_handler::end_array()
+{
+	return true;
+}
+
+//JSON Parse Function (Calls handler for each token in text, returns false on error)
+bool msl::json_parse(const char* text,const unsigned int size,msl::json_handler& handler,
+	std::string* error,unsigned int* error_position)
+{
+	json_parser parser(text,size,handler);
+	bool parsed=parser.parse();
+
+	if(!parsed&&error!=NULL)
+		*error=parser.error();
+
+	if(!parsed&&error_position!=NULL)
+		*error_position=parser.position();
+
+	return parsed;
+}
+
+//JSON Value Constructor (Default is a missing value)
+msl::json_value::json_value(const msl::json_document* document,const unsigned int index):_document(document),_index(index)
+{}
+
+//Type Accessor
+msl::json_type msl::json_value::type() const
+{
+	if(_document==NULL)
+		return msl::JSON_MISSING;
+
+	return _document->_nodes[_index].type;
+}
+
+//Type Test Functions
+bool msl::json_value::missing() const
+{
+	return (type()==msl::JSON_MISSING);
+}
+
+bool msl::json_value::is_null() const
+{
+	return (type()==msl::JSON_NULL);
+}
+
+bool msl::json_value::is_bool() const
+{
+	return (type()==msl::JSON_BOOL);
+}
+
+bool msl::json_value::is_number() const
+{
+	return (type()==msl::JSON_NUMBER);
+}
+
+bool msl::json_value::is_string() const
+{
+	return (type()==msl::JSON_STRING);
+}
+
+bool msl::json_value::is_array() const
+{
+	return (type()==msl::JSON_ARRAY);
+}
+
+bool msl::json_value::is_object() const
+{
+	return (type()==msl::JSON_OBJECT);
+}
+
+//Size Accessor (Number of array elements or object members, else 0)
+unsigned int msl::json_value::size() const
+{
+	if(is_array()||is_object())
+		return _document->_nodes[_index].count;
+
+	return 0;
+}
+
+//Array and Object Index Operator
+msl::json_value msl::json_value::operator[](const unsigned int index) const
+{
+	if(index>=size())
+		return msl::json_value();
+
+	return msl::json_value(_document,_document->_nodes[_index].first+index);
+}
+
+//Object Member Operator (String Version)
+msl::json_value msl::json_value::operator[](const std::string& name) const
+{
+	return (*this)[name.c_str()];
+}
+
+//Object Member Operator
+msl::json_value msl::json_value::operator[](const char* name) const
+{
+	if(!is_object())
+		return msl::json_value();
+
+	const msl::json_document::node_t& object=_document->_nodes[_index];
+	unsigned int length=strlen(name);
+
+	for(unsigned int ii=object.first;ii<object.first+object.count;++ii)
 	{
-		//Clear Data
-		_data.clear();
+		const msl::json_document::node_t& member=_document->_nodes[ii];
 
+		if(member.key_length==length&&memcmp(_document->_strings.data()+member.key,name,length)==0)
+			return msl::json_value(_document,ii);
+	}
+
+	return msl::json_value();
+}
+
+//Key Accessor (Name of this value in its object, else "")
+std::string msl::json_value::key() const
+{
+	if(_document==NULL)
+		return "";
+
+	const msl::json_document::node_t& node=_document->_nodes[_index];
+	return _document->_strings.substr(node.key,node.key_length);
+}
+
+//Bool Accessor
+bool msl::json_value::as_bool(const bool fallback) const
+{
+	if(!is_bool())
+		return fallback;
+
+	return (_document->_nodes[_index].number!=0);
+}
+
+//Number Accessor
+double msl::json_value::as_number(const double fallback) const
+{
+	if(!is_number())
+		return fallback;
+
+	return _document->_nodes[_index].number;
+}
+
+//String Accessor
+std::string msl::json_value::as_string(const std::string& fallback) const
+{
+	if(!is_string())
+		return fallback;
+
+	const msl::json_document::node_t& node=_document->_nodes[_index];
+	return _document->_strings.substr(node.first,node.count);
+}
+
+//String Function (Returns this value as compact JSON)
+std::string msl::json_value::str() const
+{
+	std::string json_string;
+	write(json_string);
+	return json_string;
+}
+
+//Write Function (Appends this value as compact JSON)
+void msl::json_value::write(std::string& json_string) const
+{
+	msl::json_type node_type=type();
+
+	if(node_type==msl::JSON_MISSING||node_type==msl::JSON_NULL)
+	{
+		json_string+="null";
+		return;
+	}
+
+	const msl::json_document::node_t& node=_document->_nodes[_index];
+
+	if(node_type==msl::JSON_BOOL)
+	{
+		json_string+=(node.number!=0)?"true":"false";
+	}
+	else if(node_type==msl::JSON_NUMBER)
+	{
+		json_string.append(_document->_strings,node.first,node.count);
+	}
+	else if(node_type==msl::JSON_STRING)
+	{
+		json_write_string(json_string,_document->_strings.data()+node.first,node.count);
+	}
+	else
+	{
+		json_string+=(node_type==msl::JSON_OBJECT)?'{':'[';
+
+		for(unsigned int ii=0;ii<node.count;++ii)
+		{
+			if(ii>0)
+				json_string+=',';
+
+			if(node_type==msl::JSON_OBJECT)
+			{
+				const msl::json_document::node_t& member=_document->_nodes[node.first+ii];
+				json_write_string(json_string,_document->_strings.data()+member.key,member.key_length);
+				json_string+=':';
+			}
+
+			msl::json_value(_document,node.first+ii).write(json_string);
+		}
+
+		json_string+=(node_type==msl::JSON_OBJECT)?'}':']';
+	}
+}
+
+//JSON Document Constructor (Default, empty document)
+msl::json_document::json_document():_next_key(0),_next_key_length(0),_good(false),_error("empty document"),_error_position(0)
+{}
+
+//JSON Document Constructor (Parses json_string)
+msl::json_document::json_document(const std::string& json_string):_next_key(0),_next_key_length(0),_good(false),
+	_error_position(0)
+{
+	parse(json_string);
+}
+
+//Parse Function (String Version)
+bool msl::json_document::parse(const std::string& json_string)
+{
+	return parse(json_string.data(),json_string.size());
+}
+
+//Parse Function (Replaces the document, returns false on error)
+bool msl::json_document::parse(const char* text,const unsigned int size)
+{
+	//Clear (Keeps capacity for the next document)
+	_nodes.clear();
+	_strings.clear();
+	_pending.clear();
+	_open.clear();
+	_next_key=0;
+	_next_key_length=0;
+	_error="";
+	_error_position=0;
+
+	_good=msl::json_parse(text,size,*this,&_error,&_error_position);
+
+	//Root is the Last Node
+	if(_good&&_pending.size()==1)
+		_nodes.push_back(_pending[0]);
+	else
+		_nodes.clear();
+
+	_pending.clear();
+	return _good;
+}
+
+//Good Function (Tests if the last parse worked)
+bool msl::json_document::good() const
+{
+	return _good;
+}
+
+//Error Accessor (Message of the last parse error)
+std::string msl::json_document::error() const
+{
+	return _error;
+}
+
+//Error Position Accessor (Byte offset of the last parse error)
+unsigned int msl::json_document::error_position() const
+{
+	return _error_position;
+}
+
+//Root Accessor (Missing if the parse failed)
+msl::json_value msl::json_document::root() const
+{
+	if(!_good||_nodes.size()==0)
+		return msl::json_value();
+
+	return msl::json_value(this,_nodes.size()-1);
+}
+
+//Null Callback
+bool msl::json_document::null_value()
+{
+	return add(msl::JSON_NULL,0,NULL,0);
+}
+
+//Boolean Callback
+bool msl::json_document::boolean(const bool value)
+{
+	return add(msl::JSON_BOOL,value?1:0,NULL,0);
+}
+
+//Number Callback (Keeps the text, so str() gives numbers back unchanged)
+bool msl::json_document::number(const double value,const char* text,const unsigned int length)
+{
+	return add(msl::JSON_NUMBER,value,text,length);
+}
+
+//String Callback
+bool msl::json_document::string(const char* value,const unsigned int length)
+{
+	return add(msl::JSON_STRING,0,value,length);
+}
+
+//Start Object Callback
+bool msl::json_document::start_object()
+{
+	add(msl::JSON_OBJECT,0,NULL,0);
+	_open.push_back(_pending.size()-1);
+	return true;
+}
+
+//Key Callback (Saved for the member's value)
+bool msl::json_document::key(const char* name,const unsigned int length)
+{
+	_next_key=_strings.size();
+	_next_key_length=length;
+	_strings.append(name,length);
+	_strings+='\0';
+	return true;
+}
+
+//End Object Callback
+bool msl::json_document::end_object()
+{
+	return end_container();
+}
+
+//Start Array Callback
+bool msl::json_document::start_array()
+{
+	add(msl::JSON_ARRAY,0,NULL,0);
+	_open.push_back(_pending.size()-1);
+	return true;
+}
+
+//End Array Callback
+bool msl::json_document::end_array()
+{
+	return end_container();
+}
+
+//Add Function (Appends a value to the innermost open container)
+bool msl::json_document::add(const msl::json_type type,const double number,const char* text,const unsigned int length)
+{
+	node_t node;
+	node.type=type;
+	node.key=_next_key;
+	node.key_length=_next_key_length;
+	node.first=_strings.size();
+	node.count=length;
+	node.number=number;
+	_next_key=0;
+	_next_key_length=0;
+
+	if(text!=NULL)
+	{
+		_strings.append(text,length);
+		_strings+='\0';
+	}
+
+	_pending.push_back(node);
+	return true;
+}
+
+//End Container Function (Moves the finished container's children into _nodes, side by side)
+bool msl::json_document::end_container()
+{
+	unsigned int container=_open[_open.size()-1];
+	_open.pop_back();
+
+	_pending[container].first=_nodes.size();
+	_pending[container].count=_pending.size()-container-1;
+	_nodes.insert(_nodes.end(),_pending.begin()+container+1,_pending.end());
+	_pending.resize(container+1);
+	return true;
+}
+
+//JSON Writer Constructor (Default)
+msl::json_writer::json_writer():_need_comma(false)
+{}
+
+//Clear Function (Empties the buffer, keeps its memory)
+void msl::json_writer::clear()
+{
+	_buffer.clear();
+	_need_comma=false;
+}
+
+//String Accessor (Everything written since clear)
+const std::string& msl::json_writer::str() const
+{
+	return _buffer;
+}
+
+//Start Object Function
+void msl::json_writer::start_object()
+{
+	separate();
+	_buffer+='{';
+	_need_comma=false;
+}
+
+//End Object Function
+void msl::json_writer::end_object()
+{
+	_buffer+='}';
+	_need_comma=true;
+}
+
+//Start Array Function
+void msl::json_writer::start_array()
+{
+	separate();
+	_buffer+='[';
+	_need_comma=false;
+}
+
+//End Array Function
+void msl::json_writer::end_array()
+{
+	_buffer+=']';
+	_need_comma=true;
+}
+
+//Key Function (Name of the next object member)
+void msl::json_writer::key(const char* name)
+{
+	separate();
+	json_write_string(_buffer,name,strlen(name));
+	_buffer+=':';
+	_need_comma=false;
+}
+
+//Null Value Function
+void msl::json_writer::null_value()
+{
+	separate();
+	_buffer+="null";
+	_need_comma=true;
+}
+
+//Bool Value Function
+void msl::json_writer::value(const bool value)
+{
+	separate();
+	_buffer+=value?"true":"false";
+	_need_comma=true;
+}
+
+//Int Value Function
+void msl::json_writer::value(const int value)
+{
+	separate();
+	json_write_int(_buffer,value);
+	_need_comma=true;
+}
+
+//Float Value Function (Shortest text that reads back as the same float)
+void msl::json_writer::value(const float value)
+{
+	separate();
+	json_write_number(_buffer,value,9,1e7,6,9);
+	_need_comma=true;
+}
+
+//Double Value Function (Shortest text that reads back as the same double)
+void msl::json_writer::value(const double value)
+{
+	separate();
+	json_write_number(_buffer,value,17,1e15,15,17);
+	_need_comma=true;
+}
+
+//C String Value Function (NULL is written as null)
+void msl::json_writer::value(const char* value)
+{
+	if(value==NULL)
+	{
+		null_value();
+		return;
+	}
+
+	separate();
+	json_write_string(_buffer,value,strlen(value));
+	_need_comma=true;
+}
+
+//String Value Function
+void msl::json_writer::value(const std::string& value)
+{
+	separate();
+	json_write_string(_buffer,value.data(),value.size());
+	_need_comma=true;
+}
+
+//Separate Function (Comma before every element but the first)
+void msl::json_writer::separate()
+{
+	if(_need_comma)
+		_buffer+=',';
+}
+
+//Constructor (Default, if error is found json contains only only entry, "error".
+//	Error is an object containing "what", the error message, and "position",
+//	the position of the error in the passed string.)
+msl::json::json(const std::string& json_string)
+{
+	//Nothing is an Empty Object
+	unsigned int start=0;
+
+	while(start<json_string.size()&&isspace((unsigned char)json_string[start]))
+		++start;
+
+	if(start==json_string.size())
+		return;
+
+	//Parse
+	msl::json_document document(json_string);
+	msl::json_value root=document.root();
+	std::string error_what=document.error();
+	unsigned int error_position=document.error_position()+1;
+
+	if(document.good()&&!root.is_object())
+	{
+		error_what="object expected";
+		error_position=start+1;
+	}
+
+	//On Errors
+	if(error_what!="")
+	{
 		//Create and Set Error Object
 		msl::json error_object;
 		error_object.set("what",error_what);
 		error_object.set("position",error_position);
 		set("error",error_object);
+		return;
+	}
+
+	//Add Variables
+	for(unsigned int ii=0;ii<root.size();++ii)
+	{
+		msl::json_value value=root[ii];
+
+		if(value.is_string())
+			_data[value.key()]=value.as_string();
+		else
+			_data[value.key()]=value.str();
+
+		if(value.is_object()||value.is_array())
+			_raw.insert(value.key());
 	}
 }
 
@@ -303,7 +1196,8 @@ unsigned int msl::json::size() const
 //Set Operator (Sets a variable to a value) (JSON Version)
 void msl::json::set(const std::string& lhs,const json& rhs)
 {
-	set(lhs,rhs.str());
+	_data[lhs]=rhs.str();
+	_raw.insert(lhs);
 }
 
 //Get Operator (Returns variable from an index)
@@ -343,13 +1237,14 @@ std::string msl::json::str() const
 	for(std::map<std::string,std::string>::const_iterator ii=_data.begin();ii!=_data.end();++ii)
 	{
 		//Add Variable to String
-		json_string+="\""+ii->first+"\":";
+		json_write_string(json_string,ii->first.data(),ii->first.size());
+		json_string+=":";
 
-		//Add Value to String
-		if(ii->second.size()>0&&ii->second[0]=='{')
+		//Add Value to String (Objects and arrays as is, everything else as an escaped string)
+		if(_raw.count(ii->first)>0)
 			json_string+=ii->second;
 		else
-			json_string+="\""+ii->second+"\"";
+			json_write_string(json_string,ii->second.data(),ii->second.size());
 
 		//Get Next Variable
 		std::map<std::string,std::string>::const_iterator next=ii;
@@ -2,6 +2,14 @@
 //	Created By:		Mike Moss
 //	Modified On:	11/07/2013
 
+//Parsing is one pass over the text with an explicit container stack (no
+//	recursion, no copies of the remaining input).  There are three ways in:
+//		msl::json_parse		SAX style, calls a msl::json_handler per token.
+//		msl::json_document	Builds a DOM (all nodes in one vector, all decoded
+//							strings in one buffer) read through msl::json_value.
+//		msl::json			The original flat object of strings, now built
+//							from a json_document.
+
 //Begin Define Guards
 #ifndef MSL_JSON_H
 #define MSL_JSON_H
@@ -12,16 +20,227 @@
 //OStream Header
 #include <ostream>
 
+//Set Header
+#include <set>
+
 //String Header
 #include <string>
 
 //String Utility Header
 #include "string_util.hpp"
 
+//Vector Header
+#include <vector>
+
 //MSL Namespace
 namespace msl
 {
-	//JSON Class Declaration
+	//JSON Handler Class Declaration (SAX callbacks, return false from any of them to stop parsing)
+	//	Strings and keys are decoded, and only valid until the callback returns.
+	//	Numbers also get their original text.
+	class json_handler
+	{
+		public:
+			//Destructor
+			virtual ~json_handler();
+
+			//Value Callbacks
+			virtual bool null_value();
+			virtual bool boolean(const bool value);
+			virtual bool number(const double value,const char* text,const unsigned int length);
+			virtual bool string(const char* value,const unsigned int length);
+
+			//Object Callbacks (key is called before each member's value)
+			virtual bool start_object();
+			virtual bool key(const char* name,const unsigned int length);
+			virtual bool end_object();
+
+			//Array Callbacks
+			virtual bool start_array();
+			virtual bool end_array();
+	};
+
+	//JSON Parse Function (Calls handler for each token in text, returns false on error)
+	//	error and error_position (byte offset into text) are set on failure if not NULL.
+	//	Accepts standard JSON, plus single quoted strings like msl::json always has.
+	bool json_parse(const char* text,const unsigned int size,msl::json_handler& handler,
+		std::string* error=NULL,unsigned int* error_position=NULL);
+
+	//JSON Type Enumeration
+	enum json_type
+	{
+		JSON_MISSING,
+		JSON_NULL,
+		JSON_BOOL,
+		JSON_NUMBER,
+		JSON_STRING,
+		JSON_ARRAY,
+		JSON_OBJECT
+	};
+
+	//JSON Document Class Pre-Declaration (For msl::json_value)
+	class json_document;
+
+	//JSON Value Class Declaration (A node in a json_document, only valid while the document is unchanged)
+	//	Looking up something that isn't there gives a JSON_MISSING value, whose
+	//	accessors all return their fallback, so lookups can be chained safely.
+	class json_value
+	{
+		public:
+			//Constructor (Default is a missing value)
+			json_value(const msl::json_document* document=NULL,const unsigned int index=0);
+
+			//Type Accessors
+			msl::json_type type() const;
+			bool missing() const;
+			bool is_null() const;
+			bool is_bool() const;
+			bool is_number() const;
+			bool is_string() const;
+			bool is_array() const;
+			bool is_object() const;
+
+			//Size Accessor (Number of array elements or object members, else 0)
+			unsigned int size() const;
+
+			//Array and Object Index Operator (Member values of objects are in document order)
+			msl::json_value operator[](const unsigned int index) const;
+
+			//Object Member Operators (Linear search, objects are expected to be small)
+			msl::json_value operator[](const std::string& name) const;
+			msl::json_value operator[](const char* name) const;
+
+			//Key Accessor (Name of this value in its object, else "")
+			std::string key() const;
+
+			//Value Accessors (Return fallback if the value is another type)
+			bool as_bool(const bool fallback=false) const;
+			double as_number(const double fallback=0) const;
+			std::string as_string(const std::string& fallback="") const;
+
+			//String Function (Returns this value as compact JSON)
+			std::string str() const;
+
+		private:
+			//Write Function (Appends this value as compact JSON)
+			void write(std::string& json_string) const;
+
+			//Member Variables
+			const msl::json_document* _document;
+			unsigned int _index;
+	};
+
+	//JSON Document Class Declaration
+	//	Reusing a document for the next parse reuses its memory too.
+	class json_document:private msl::json_handler
+	{
+		public:
+			//Constructor (Default, empty document)
+			json_document();
+
+			//Constructor (Parses json_string)
+			json_document(const std::string& json_string);
+
+			//Parse Functions (Replaces the document, returns false on error)
+			bool parse(const std::string& json_string);
+			bool parse(const char* text,const unsigned int size);
+
+			//Good Function (Tests if the last parse worked)
+			bool good() const;
+
+			//Error Accessors (Message and byte offset of the last parse error)
+			std::string error() const;
+			unsigned int error_position() const;
+
+			//Root Accessor (Missing if the parse failed)
+			msl::json_value root() const;
+
+			//Value Class Friend
+			friend class msl::json_value;
+
+		private:
+			//Node Structure (first/count are a slice of _strings for strings and
+			//	number text, and of _nodes for array elements and object members)
+			struct node_t
+			{
+				msl::json_type type;
+				unsigned int key;
+				unsigned int key_length;
+				unsigned int first;
+				unsigned int count;
+				double number;
+			};
+
+			//Handler Functions (Build the tree, see json_handler)
+			bool null_value();
+			bool boolean(const bool value);
+			bool number(const double value,const char* text,const unsigned int length);
+			bool string(const char* value,const unsigned int length);
+			bool start_object();
+			bool key(const char* name,const unsigned int length);
+			bool end_object();
+			bool start_array();
+			bool end_array();
+			bool add(const msl::json_type type,const double number,const char* text,const unsigned int length);
+			bool end_container();
+
+			//Member Variables
+			std::vector<node_t> _nodes;
+			std::string _strings;
+			std::vector<node_t> _pending;
+			std::vector<unsigned int> _open;
+			unsigned int _next_key;
+			unsigned int _next_key_length;
+			bool _good;
+			std::string _error;
+			unsigned int _error_position;
+	};
+
+	//JSON Writer Class Declaration (Appends compact JSON to one buffer, commas are handled for you)
+	//	clear() keeps the buffer's memory, so a writer reused every tick stops allocating.
+	//	Floats and doubles are written with the fewest digits that read back exactly,
+	//	NaN and infinity (not JSON) as null.
+	class json_writer
+	{
+		public:
+			//Constructor (Default)
+			json_writer();
+
+			//Clear Function (Empties the buffer, keeps its memory)
+			void clear();
+
+			//String Accessor (Everything written since clear)
+			const std::string& str() const;
+
+			//Container Functions
+			void start_object();
+			void end_object();
+			void start_array();
+			void end_array();
+
+			//Key Function (Name of the next object member)
+			void key(const char* name);
+
+			//Value Functions
+			void null_value();
+			void value(const bool value);
+			void value(const int value);
+			void value(const float value);
+			void value(const double value);
+			void value(const char* value);
+			void value(const std::string& value);
+
+		private:
+			//Separate Function (Comma before every element but the first)
+			void separate();
+
+			//Member Variables
+			std::string _buffer;
+			bool _need_comma;
+	};
+
+	//JSON Class Declaration (Top level members of an object as strings, nested
+	//	objects and arrays are kept as compact JSON, numbers as their original text)
 	class json
 	{
 		public:
@@ -51,6 +270,7 @@ namespace msl
 		private:
 			//Member Variables
 			std::map<std::string,std::string> _data;
+			std::set<std::string> _raw; //Keys holding objects or arrays, written unquoted
 	};
 }
 
@@ -58,6 +278,7 @@ namespace msl
 template<typename T> void msl::json::set(const std::string& lhs,const T& rhs)
 {
 	_data[lhs]=msl::to_string(rhs);
+	_raw.erase(lhs);
 }
 
 //End Define Guards
@@ -87,6 +308,11 @@ int main()
 	std::cout<<"\t\t\tabc="<<msl::json(msl::json(oo.get("test3")).get("test4")).get("abc")<<std::endl;
 	std::cout<<"\ttest5="<<oo.get("test5")<<std::endl;
 
+	//Same Thing as a Document (Parsed once, nested values read in place)
+	msl::json_document doc("{\"test3\":{\"test4\":{\"abc\":678}},\"list\":[1,2.5,\"three\"]}");
+	std::cout<<"\t\t\tabc="<<doc.root()["test3"]["test4"]["abc"].as_number()<<std::endl;
+	std::cout<<"\tlist[2]="<<doc.root()["list"][2].as_string()<<std::endl;
+
 	//All Done
 	return 0;
 }
@@ -5,6 +5,9 @@
 //Definitions for "serial.hpp"
 #include "serial.hpp"
 
+//C String Header
+#include <cstring>
+
 //Time Utility Header
 #include "time_util.hpp"
 
@@ -63,11 +66,13 @@
 #endif
 
 //Constructor(Default)
-msl::serial::serial(const std::string& name,const unsigned int baud):_port(SERIAL_ERROR),_name(name),_baud(baud)
+msl::serial::serial(const std::string& name,const unsigned int baud):_port(SERIAL_ERROR),_name(name),_baud(baud),
+	_rx_start(0),_rx_end(0)
 {}
 
 //Copy Constructor
-msl::serial::serial(const msl::serial& copy):_port(copy._port),_name(copy._name),_baud(copy._baud)
+msl::serial::serial(const msl::serial& copy):_port(copy._port),_name(copy._name),_baud(copy._baud),
+	_rx_buffer(copy._rx_buffer),_rx_start(copy._rx_start),_rx_end(copy._rx_end)
 {}
 
 //Copy Assignment Operator
@@ -78,6 +83,9 @@ msl::serial& msl::serial::operator=(const msl::serial& copy)
 		_port=copy._port;
 		_name=copy._name;
 		_baud=copy._baud;
+		_rx_buffer=copy._rx_buffer;
+		_rx_start=copy._rx_start;
+		_rx_end=copy._rx_end;
 	}
 
 	return *this;
@@ -117,18 +125,107 @@ void msl::serial::connect()
 void msl::serial::close()
 {
 	serial_close(_port);
+	_rx_start=_rx_end=0;
 }
 
 //Available Function (Checks if there are Bytes to be Read, -1 on Error)
 int msl::serial::available() const
 {
+	if(_rx_end>_rx_start)
+		return _rx_end-_rx_start;
+
 	return serial_available(_port,0);
 }
 
 //Read Function (Returns -1 on Error Else Returns Number of Bytes Read)
 int msl::serial::read(void* buffer,const unsigned int size,const unsigned int time_out)
 {
-	return serial_read(_port,buffer,size,time_out);
+	//Nothing Buffered, Read the Port
+	if(_rx_end==_rx_start)
+		return serial_read(_port,buffer,size,time_out);
+
+	//Copy Buffered Bytes
+	unsigned int bytes_copied=_rx_end-_rx_start;
+
+	if(bytes_copied>size)
+		bytes_copied=size;
+
+	memcpy(buffer,&_rx_buffer[_rx_start],bytes_copied);
+	consume(bytes_copied);
+
+	//Read the Rest from the Port (Without blocking if the caller didn't ask to wait)
+	if(bytes_copied<size&&(time_out>0||serial_available(_port,0)>0))
+	{
+		int bytes_read=serial_read(_port,reinterpret_cast<char*>(buffer)+bytes_copied,size-bytes_copied,time_out);
+
+		if(bytes_read>0)
+			bytes_copied+=bytes_read;
+	}
+
+	return bytes_copied;
+}
+
+//Fill Function (Returns Number of Bytes Added to the Receive Buffer, -1 on Error)
+int msl::serial::fill(const unsigned int time_out)
+{
+	//Allocate Buffer (First fill only)
+	if(_rx_buffer.size()==0)
+		_rx_buffer.resize(MSL_SERIAL_RX_BUFFER);
+
+	//Slide Unconsumed Bytes to the Front (Usually part of one packet, keeps peek contiguous)
+	if(_rx_start>0)
+	{
+		memmove(&_rx_buffer[0],&_rx_buffer[_rx_start],_rx_end-_rx_start);
+		_rx_end-=_rx_start;
+		_rx_start=0;
+	}
+
+	//Buffer Full (Caller has to consume first)
+	unsigned int bytes_free=_rx_buffer.size()-_rx_end;
+
+	if(bytes_free==0)
+		return 0;
+
+	//Check for Waiting Bytes
+	int bytes_waiting=serial_available(_port,time_out);
+
+	if(bytes_waiting<=0)
+		return bytes_waiting;
+
+	//Windows (Select returns the queued byte count, and ReadFile blocks for more)
+	#if(defined(_WIN32)&&!defined(__CYGWIN__))
+		if(bytes_free>(unsigned int)bytes_waiting)
+			bytes_free=bytes_waiting;
+	#endif
+
+	//Read Everything Waiting (One call, returns as soon as any bytes are in)
+	int bytes_read=::read(_port,&_rx_buffer[_rx_end],bytes_free);
+
+	if(bytes_read<0)
+		return -1;
+
+	_rx_end+=bytes_read;
+	return bytes_read;
+}
+
+//Peek Function (Points data at the buffered bytes and returns how many, no system calls)
+unsigned int msl::serial::peek(const uint8_t*& data) const
+{
+	data=NULL;
+
+	if(_rx_end>_rx_start)
+		data=&_rx_buffer[_rx_start];
+
+	return _rx_end-_rx_start;
+}
+
+//Consume Function (Drops size bytes from the front of the receive buffer)
+void msl::serial::consume(const unsigned int size)
+{
+	if(size>=_rx_end-_rx_start)
+		_rx_start=_rx_end=0;
+	else
+		_rx_start+=size;
 }
 
 //Write Function (Returns -1 on Error Else Returns Number of Bytes Sent)
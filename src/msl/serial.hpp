@@ -6,12 +6,18 @@
 #ifndef MSL_SERIAL_H
 #define MSL_SERIAL_H
 
+//Integer Standard Types Header
+#include <inttypes.h>
+
 //String Header
 #include <string>
 
 //String Stream Header
 #include <sstream>
 
+//Vector Header
+#include <vector>
+
 //Windows Dependencies
 #if(defined(_WIN32)&&!defined(__CYGWIN__))
 	#include <conio.h>
@@ -27,6 +33,9 @@
 	#define SERIAL_ERROR (-1)
 #endif
 
+//Receive Buffer Size (Bytes, for msl::serial::fill)
+#define MSL_SERIAL_RX_BUFFER 4096
+
 //MSL Namespace
 namespace msl
 {
@@ -59,11 +68,25 @@ namespace msl
 			void close();
 
 			//Available Function (Checks if there are Bytes to be Read)
+			//	Returns the buffered byte count if fill() left any, else asks the OS.
 			int available() const;
 
 			//Read Function (Returns Number of Bytes Read, -1 on Error)
+			//	Takes buffered bytes first, then reads the port directly.
 			int read(void* buffer,const unsigned int size,const unsigned int time_out=0);
 
+			//Fill Function (Returns Number of Bytes Added to the Receive Buffer, -1 on Error)
+			//	One select and at most one read, however many bytes are waiting, so
+			//	parsers cost O(1) system calls per batch instead of per byte.
+			int fill(const unsigned int time_out=0);
+
+			//Peek Function (Points data at the buffered bytes and returns how many, no system calls)
+			//	The bytes are contiguous and stay put until the next consume, read, or fill.
+			unsigned int peek(const uint8_t*& data) const;
+
+			//Consume Function (Drops size bytes from the front of the receive buffer)
+			void consume(const unsigned int size);
+
 			//Write Function (Returns Number of Bytes Sent, -1 on Error)
 			int write(const void* buffer,const unsigned int size,const unsigned int time_out=0);
 			int write(const std::string& str);
@@ -83,6 +106,9 @@ namespace msl
 			std::string _name;
 			unsigned int _baud;
 			unsigned long _time_out;
+			std::vector<uint8_t> _rx_buffer;
+			unsigned int _rx_start;
+			unsigned int _rx_end;
 	};
 
 	//Serial Connection Function (Connects to a Port)
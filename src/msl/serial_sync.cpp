@@ -5,9 +5,79 @@
 //Definitions for "serial_sync.hpp"
 #include "serial_sync.hpp"
 
+//Packet CRC Function (XORs all bytes together)
+static uint8_t serial_sync_crc(const uint8_t* buffer,const uint32_t size)
+{
+	uint8_t crc=0x00;
+
+	for(uint32_t ii=0;ii<size;++ii)
+		crc^=buffer[ii];
+
+	return crc;
+}
+
+//Decoder Constructor (Default)
+msl::serial_sync_decoder::serial_sync_decoder():_rx_counter(0)
+{
+	_rx_packet[3]=0;
+}
+
+//Decoder Decode Function (Returns true when packet was filled out, data is advanced past the bytes used)
+bool msl::serial_sync_decoder::decode(const uint8_t*& data,const uint8_t* end,msl::serial_packet& packet)
+{
+	while(data<end)
+	{
+		//Put Byte in Buffer
+		uint8_t temp=*data++;
+		_rx_packet[_rx_counter]=temp;
+
+		//Parse Header and Size
+		if((_rx_counter==0&&temp=='m')||(_rx_counter==1&&temp=='s')||(_rx_counter==2&&temp=='l')||_rx_counter==3)
+		{
+			//Increment Counter
+			++_rx_counter;
+		}
+
+		//Parse Data
+		else if(_rx_counter>3&&_rx_counter<3+1+(uint32_t)_rx_packet[3])
+		{
+			//Increment Counter
+			++_rx_counter;
+		}
+
+		//Parse CRC
+		else if(_rx_counter==3+1+(uint32_t)_rx_packet[3])
+		{
+			//Hand Out Payload
+			packet.command=0;
+			packet.valid=(temp==serial_sync_crc(_rx_packet,_rx_counter));
+			packet.data.assign(reinterpret_cast<const char*>(_rx_packet+3+1),_rx_packet[3]);
+
+			//Reset Counter
+			_rx_counter=0;
+			return true;
+		}
+
+		//Errors
+		else
+		{
+			//Reset Counter
+			_rx_counter=0;
+		}
+	}
+
+	return false;
+}
+
+//Decoder Reset Function (Forget any partial packet)
+void msl::serial_sync_decoder::reset()
+{
+	_rx_counter=0;
+}
+
 //Constructor (Default)
 msl::serial_sync::serial_sync(const std::string& port,const uint32_t baud):
-	_baud(baud),_serial(port,_baud),_rx_counter(0)
+	_baud(baud),_serial(port,_baud)
 {
 	//Zero Out Data Array
 	for(uint8_t ii=0;ii<MSL_SERIALSYNC_VARIABLES;++ii)
@@ -18,10 +88,7 @@ msl::serial_sync::serial_sync(const std::string& port,const uint32_t baud):
 
 	//Zero Out Buffers
 	for(uint8_t ii=0;ii<3+1+MSL_SERIALSYNC_VARIABLES+1;++ii)
-	{
 		_tx_packet[ii]=0x00;
-		_rx_packet[ii]=0x00;
-	}
 }
 
 //Copy Assignment Operator
@@ -40,12 +107,9 @@ msl::serial_sync& msl::serial_sync::operator=(const msl::serial_sync& copy)
 		}
 
 		for(unsigned int ii=0;ii<MSL_SERIALSYNC_VARIABLES*3+1;++ii)
-		{
 			_tx_packet[ii]=copy._tx_packet[ii];
-			_rx_packet[ii]=copy._rx_packet[ii];
-		}
 
-		_rx_counter=copy._rx_counter;
+		_decoder=copy._decoder;
 	}
 
 	return *this;
@@ -103,67 +167,44 @@ void msl::serial_sync::close()
 //Update RX Function (Receives updates over link)
 void msl::serial_sync::update_rx()
 {
-	//Temporary Byte Variable
-	uint8_t temp;
-
-	//Read Bytes
-	while(_serial.available()>0&&_serial.read(&temp,1)==1)
+	//Read Everything Waiting (One buffer fill per batch, not a read per byte)
+	while(_serial.fill()>0)
 	{
-		//Put Byte in Buffer
-		_rx_packet[_rx_counter]=temp;
+		const uint8_t* start;
+		uint32_t size=_serial.peek(start);
+		const uint8_t* data=start;
 
-		//Parse Header and Size
-		if((_rx_counter==0&&temp=='m')||(_rx_counter==1&&temp=='s')||(_rx_counter==2&&temp=='l')||_rx_counter==3)
-		{
-			//Increment Counter
-			++_rx_counter;
-		}
+		while(_decoder.decode(data,start+size,_rx))
+			if(_rx.valid)
+				apply_rx(_rx);
 
-		//Parse Data
-		else if(_rx_counter>3&&_rx_counter<3+1+(uint32_t)_rx_packet[3])
-		{
-			//Increment Counter
-			++_rx_counter;
-		}
+		_serial.consume(size);
+	}
+}
 
-		//Parse CRC
-		else if(_rx_counter==3+1+(uint32_t)_rx_packet[3])
-		{
-			//Check CRC
-			if(temp==calculate_crc(_rx_packet,_rx_counter))
-			{
-
-				//Packet Size 0
-				if(_rx_packet[3]==0x00)
-				{
-					//Set All Variables t Update
-					for(uint8_t ii=0;ii<MSL_SERIALSYNC_VARIABLES;++ii)
-						_flags[ii]=0x01;
-
-					//Send Global Update
-					update_tx();
-				}
-
-				//Packet Size > 0
-				else
-				{
-					//Save Data
-					for(uint8_t ii=0;ii<_rx_packet[3];ii+=3)
-						if(_rx_packet[3+1+ii]<MSL_SERIALSYNC_VARIABLES)
-							_data[_rx_packet[3+1+ii]]=*(int16_t*)(_rx_packet+3+1+ii+1);
-				}
-			}
+//Apply RX Function (Saves a received packet's values, or answers a size 0 packet with everything)
+void msl::serial_sync::apply_rx(const msl::serial_packet& packet)
+{
+	//Packet Size 0
+	if(packet.data.size()==0)
+	{
+		//Set All Variables t Update
+		for(uint8_t ii=0;ii<MSL_SERIALSYNC_VARIABLES;++ii)
+			_flags[ii]=0x01;
 
-			//Reset Counter
-			_rx_counter=0;
-		}
+		//Send Global Update
+		update_tx();
+	}
 
-		//Errors
-		else
-		{
-			//Reset Counter
-			_rx_counter=0;
-		}
+	//Packet Size > 0
+	else
+	{
+		//Save Data
+		const uint8_t* triples=reinterpret_cast<const uint8_t*>(packet.data.data());
+
+		for(uint32_t ii=0;ii+2<packet.data.size();ii+=3)
+			if(triples[ii]<MSL_SERIALSYNC_VARIABLES)
+				_data[triples[ii]]=*(int16_t*)(triples+ii+1);
 	}
 }
 
@@ -12,6 +12,9 @@
 //Serial Header
 #include "serial.hpp"
 
+//Serial Thread Header (For msl::serial_decoder)
+#include "serial_thread.hpp"
+
 //String Header
 #include <string>
 
@@ -21,6 +24,27 @@
 //MSL Namespace
 namespace msl
 {
+	//Serial Sync Decoder Class Declaration
+	//	Frames "msl" packets (header, size, size bytes of index/value triples, CRC)
+	//	into msl::serial_packets holding the triples, for serial_sync or an msl::serial_thread.
+	class serial_sync_decoder:public msl::serial_decoder
+	{
+		public:
+			//Constructor (Default)
+			serial_sync_decoder();
+
+			//Decode Function (Returns true when packet was filled out, data is advanced past the bytes used)
+			bool decode(const uint8_t*& data,const uint8_t* end,msl::serial_packet& packet);
+
+			//Reset Function (Forget any partial packet)
+			void reset();
+
+		private:
+			//Member Variables
+			uint8_t _rx_packet[3+1+255+1];
+			uint32_t _rx_counter;
+	};
+
 	//Serial Sync Class Declaration
 	class serial_sync
 	{
@@ -59,6 +83,9 @@ namespace msl
 			void set(const uint8_t index,const int16_t value);
 
 		private:
+			//Apply RX Function (Saves a received packet's values, or answers a size 0 packet with everything)
+			void apply_rx(const msl::serial_packet& packet);
+
 			//Calculate CRC Function (XORs all bytes together)
 			uint8_t calculate_crc(const uint8_t* buffer,const uint8_t size) const;
 
@@ -68,8 +95,8 @@ namespace msl
 			int16_t _data[MSL_SERIALSYNC_VARIABLES];
 			uint8_t _flags[MSL_SERIALSYNC_VARIABLES];
 			uint8_t _tx_packet[3+1+MSL_SERIALSYNC_VARIABLES*3+1];
-			uint8_t _rx_packet[3+1+MSL_SERIALSYNC_VARIABLES*3+1];
-			uint32_t _rx_counter;
+			msl::serial_sync_decoder _decoder;
+			msl::serial_packet _rx;
 	};
 }
 
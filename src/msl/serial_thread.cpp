@@ -0,0 +1,251 @@
+//Serial Thread Source
+
+//Definitions for "serial_thread.hpp"
+#include "serial_thread.hpp"
+
+//Error Number Header
+#include <errno.h>
+
+//Time Header
+#include <time.h>
+
+//Time Utility Header
+#include "time_util.hpp"
+
+//Unix Dependencies
+#if(!defined(_WIN32)||defined(__CYGWIN__))
+	#include <poll.h>
+#endif
+
+//Serial Thread Constructor
+msl::serial_thread::serial_thread(msl::serial& port,msl::serial_decoder& decoder,callback_t callback,void* arg,
+	const unsigned int queue_size):_port(port),_decoder(decoder),_callback(callback),_arg(arg),_queue_mask(0),
+	_head(0),_tail(0),_waiting(false),_reset(false),_running(false),_packets(0),_dropped(0),_wakeups(0)
+{
+	//Round Queue Size up to a Power of Two (So indices can just wrap)
+	unsigned int size=1;
+
+	while(size<queue_size)
+		size*=2;
+
+	_queue.resize(size);
+	_queue_mask=size-1;
+
+	pthread_mutex_init(&_lock,NULL);
+	pthread_cond_init(&_ready,NULL);
+}
+
+//Serial Thread Destructor
+msl::serial_thread::~serial_thread()
+{
+	stop();
+	pthread_cond_destroy(&_ready);
+	pthread_mutex_destroy(&_lock);
+}
+
+//Serial Thread Start Function (Starts the I/O thread, returns false if it couldn't)
+bool msl::serial_thread::start()
+{
+	if(!_running)
+	{
+		_running=true;
+
+		if(pthread_create(&_thread,NULL,&thread_func,this)!=0)
+			_running=false;
+	}
+
+	return _running;
+}
+
+//Serial Thread Stop Function (Waits for the I/O thread to finish)
+void msl::serial_thread::stop()
+{
+	if(_running)
+	{
+		_running=false;
+		pthread_join(_thread,NULL);
+	}
+}
+
+//Serial Thread Running Accessor
+bool msl::serial_thread::running() const
+{
+	return _running;
+}
+
+//Serial Thread Pop Function (Consumer thread only, waits up to time_out milliseconds for a packet)
+bool msl::serial_thread::pop(msl::serial_packet& packet,const unsigned long time_out)
+{
+	//Empty, Wait for the I/O Thread
+	if(_head==_tail)
+	{
+		if(time_out==0)
+			return false;
+
+		timespec deadline;
+		clock_gettime(CLOCK_REALTIME,&deadline);
+		deadline.tv_sec+=time_out/1000;
+		deadline.tv_nsec+=(time_out%1000)*1000000;
+
+		if(deadline.tv_nsec>=1000000000)
+		{
+			++deadline.tv_sec;
+			deadline.tv_nsec-=1000000000;
+		}
+
+		//Flag first, then look again (deliver pushes first, then looks at the flag)
+		pthread_mutex_lock(&_lock);
+		_waiting=true;
+		__sync_synchronize();
+
+		while(_head==_tail)
+			if(pthread_cond_timedwait(&_ready,&_lock,&deadline)==ETIMEDOUT)
+				break;
+
+		_waiting=false;
+		pthread_mutex_unlock(&_lock);
+
+		if(_head==_tail)
+			return false;
+	}
+
+	//Take the Oldest Packet (Swap so both sides keep reusing string memory)
+	__sync_synchronize();
+	msl::serial_packet& slot=_queue[_head&_queue_mask];
+	packet.command=slot.command;
+	packet.valid=slot.valid;
+	packet.data.swap(slot.data);
+	__sync_synchronize();
+	++_head;
+
+	return true;
+}
+
+//Serial Thread Reset Function (Has the I/O thread reset the decoder before its next bytes)
+void msl::serial_thread::reset()
+{
+	_reset=true;
+}
+
+//Serial Thread Packets Accessor
+unsigned long msl::serial_thread::packets() const
+{
+	return _packets;
+}
+
+//Serial Thread Dropped Accessor
+unsigned long msl::serial_thread::dropped() const
+{
+	return _dropped;
+}
+
+//Serial Thread Wakeups Accessor
+unsigned long msl::serial_thread::wakeups() const
+{
+	return _wakeups;
+}
+
+//Serial Thread Thread Function
+void* msl::serial_thread::thread_func(void* serial_thread)
+{
+	msl::serial_thread* self=reinterpret_cast<msl::serial_thread*>(serial_thread);
+
+	while(self->_running)
+	{
+		//Windows (No poll on serial handles, check every millisecond)
+		#if(defined(_WIN32)&&!defined(__CYGWIN__))
+			if(self->_port.fill()<=0)
+			{
+				msl::nsleep(1000000);
+				continue;
+			}
+
+		//Unix (Sleep until bytes arrive, waking every 100 ms to check for stop)
+		#else
+			pollfd port_poll;
+			port_poll.fd=self->_port.system_port();
+			port_poll.events=POLLIN;
+			port_poll.revents=0;
+
+			int ready=poll(&port_poll,1,100);
+
+			if(ready==0||(ready<0&&errno==EINTR))
+				continue;
+
+			//Closed, Broken, or Hung Up Port (Don't spin on it, an unplugged USB tty polls POLLHUP forever)
+			if(ready<0||(port_poll.revents&(POLLERR|POLLHUP|POLLNVAL))!=0)
+			{
+				msl::nsleep(100000000);
+				continue;
+			}
+
+			++self->_wakeups;
+
+			//Readable but Nothing Read is a Hang Up Too (Unless the receive buffer is just full)
+			const uint8_t* buffered;
+			int bytes_read=self->_port.fill();
+
+			if(bytes_read<0||(bytes_read==0&&self->_port.peek(buffered)<MSL_SERIAL_RX_BUFFER))
+			{
+				msl::nsleep(100000000);
+				continue;
+			}
+		#endif
+
+		//Reset Decoder (Asked for by the consumer)
+		if(self->_reset)
+		{
+			self->_decoder.reset();
+			self->_reset=false;
+		}
+
+		//Decode Every Whole Packet in the Buffer (Decoders may still hold bytes of their own once data reaches the end)
+		const uint8_t* start;
+		unsigned int size=self->_port.peek(start);
+		const uint8_t* data=start;
+
+		while(self->_decoder.decode(data,start+size,self->_packet))
+			self->deliver();
+
+		self->_port.consume(data-start);
+	}
+
+	return NULL;
+}
+
+//Serial Thread Deliver Function (I/O thread only, callback or queue)
+void msl::serial_thread::deliver()
+{
+	++_packets;
+
+	//Callback
+	if(_callback!=NULL)
+	{
+		_callback(_packet,_arg);
+		return;
+	}
+
+	//Full Queue (Consumer is behind, drop the newest)
+	if(_tail-_head>_queue_mask)
+	{
+		++_dropped;
+		return;
+	}
+
+	//Push (Swap so both sides keep reusing string memory)
+	msl::serial_packet& slot=_queue[_tail&_queue_mask];
+	slot.command=_packet.command;
+	slot.valid=_packet.valid;
+	slot.data.swap(_packet.data);
+	__sync_synchronize();
+	++_tail;
+	__sync_synchronize();
+
+	//Wake a Waiting Consumer
+	if(_waiting)
+	{
+		pthread_mutex_lock(&_lock);
+		pthread_cond_signal(&_ready);
+		pthread_mutex_unlock(&_lock);
+	}
+}
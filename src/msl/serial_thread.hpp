@@ -0,0 +1,131 @@
+//Serial Thread Header
+//	Gives a serial port its own I/O thread.  The thread sleeps in poll until
+//	bytes arrive, pulls in everything waiting with one msl::serial::fill, runs
+//	the bytes through a decoder, and hands each whole packet either to a
+//	callback (on the I/O thread) or to a single producer single consumer queue
+//	that one other thread pops from, waiting on a condition instead of spinning.
+//	Writes still go straight to the msl::serial from the caller's thread.
+
+//Required Libraries:
+//	pthread
+
+//Begin Define Guards
+#ifndef MSL_SERIAL_THREAD_H
+#define MSL_SERIAL_THREAD_H
+
+//Integer Standard Types Header
+#include <inttypes.h>
+
+//PThread Header
+#include <pthread.h>
+
+//Serial Header
+#include "serial.hpp"
+
+//String Header
+#include <string>
+
+//Vector Header
+#include <vector>
+
+//MSL Namespace
+namespace msl
+{
+	//Serial Packet Struct (One whole frame out of a decoder)
+	struct serial_packet
+	{
+		uint8_t command;
+		bool valid;
+		std::string data;
+	};
+
+	//Serial Decoder Class Declaration (Frames a byte stream into packets, called only from the I/O thread)
+	class serial_decoder
+	{
+		public:
+			//Destructor
+			virtual ~serial_decoder()
+			{}
+
+			//Decode Function (Returns true when packet was filled out, data is advanced past the bytes used)
+			//	Returns false once every byte up to end went into a partial packet (also called
+			//	with data==end, in case the decoder held bytes back).  Overwrite all of packet,
+			//	its data string is recycled from earlier packets.
+			virtual bool decode(const uint8_t*& data,const uint8_t* end,msl::serial_packet& packet)=0;
+
+			//Reset Function (Forget any partial packet)
+			virtual void reset()=0;
+	};
+
+	//Serial Thread Class Declaration
+	class serial_thread
+	{
+		public:
+			//Callback Type (Called on the I/O thread for each packet, instead of queueing)
+			typedef void(*callback_t)(const msl::serial_packet& packet,void* arg);
+
+			//Constructor (Port and decoder must outlive the thread, queue size is rounded up to a power of two)
+			serial_thread(msl::serial& port,msl::serial_decoder& decoder,callback_t callback=NULL,void* arg=NULL,
+				const unsigned int queue_size=64);
+
+			//Destructor (Stops the thread)
+			~serial_thread();
+
+			//Start Function (Starts the I/O thread, returns false if it couldn't)
+			bool start();
+
+			//Stop Function (Waits for the I/O thread to finish)
+			void stop();
+
+			//Running Accessor
+			bool running() const;
+
+			//Pop Function (Consumer thread only, waits up to time_out milliseconds for a packet)
+			//	Swaps the packet's data into packet, so reusing one packet reuses its memory.
+			bool pop(msl::serial_packet& packet,const unsigned long time_out=0);
+
+			//Reset Function (Has the I/O thread reset the decoder before its next bytes)
+			void reset();
+
+			//Statistics Accessors (Packets decoded, packets dropped on a full queue, and wakeups from poll)
+			unsigned long packets() const;
+			unsigned long dropped() const;
+			unsigned long wakeups() const;
+
+		private:
+			//Copy Constructor (Deleted)
+			serial_thread(const msl::serial_thread& copy);
+
+			//Copy Assignment Operator (Deleted)
+			msl::serial_thread& operator=(const msl::serial_thread& copy);
+
+			//Thread Function
+			static void* thread_func(void* serial_thread);
+
+			//Deliver Function (I/O thread only, callback or queue)
+			void deliver();
+
+			//Member Variables
+			msl::serial& _port;
+			msl::serial_decoder& _decoder;
+			callback_t _callback;
+			void* _arg;
+			msl::serial_packet _packet;
+			std::vector<msl::serial_packet> _queue;
+			unsigned int _queue_mask;
+			volatile unsigned int _head;
+			volatile unsigned int _tail;
+			volatile bool _waiting;
+			volatile bool _reset;
+			pthread_mutex_t _lock;
+			pthread_cond_t _ready;
+			pthread_t _thread;
+			volatile bool _running;
+			unsigned long _packets;
+			unsigned long _dropped;
+			unsigned long _wakeups;
+	};
+}
+
+//End Define Guards
+#endif
@@ -14,6 +14,9 @@
 //Exception Header
 #include <stdexcept>
 
+//Error Number Header
+#include <errno.h>
+
 //Signal Header
 #include <signal.h>
 
@@ -91,7 +94,7 @@ std::string msl::ipv4::str() const
 }
 
 //Constructor(Default)
-msl::socket::socket(const std::string& address):_socket(SOCKET_ERROR),_hosting(false)
+msl::socket::socket(const std::string& address):_socket(SOCKET_ERROR),_hosting(false),_udp(false),_connected(false)
 {
 	//Parsing Variables
 	unsigned char ip[4]={0,0,0,0};
@@ -130,7 +133,8 @@ msl::socket::socket(const std::string& address):_socket(SOCKET_ERROR),_hosting(f
 }
 
 //Copy Constructor
-msl::socket::socket(const msl::socket& copy):_address(copy._address),_socket(copy._socket),_hosting(copy._hosting)
+msl::socket::socket(const msl::socket& copy):_address(copy._address),_socket(copy._socket),_hosting(copy._hosting),
+	_udp(copy._udp),_connected(copy._connected)
 {}
 
 //Copy Assignment Operator
@@ -141,6 +145,8 @@ msl::socket& msl::socket::operator=(const msl::socket& copy)
 		_address=copy._address;
 		_socket=copy._socket;
 		_hosting=copy._hosting;
+		_udp=copy._udp;
+		_connected=copy._connected;
 	}
 
 	return *this;
@@ -172,19 +178,33 @@ bool msl::socket::operator!=(const msl::socket& rhs) const
 
 //Good Function (Tests if Socket is Good)
 bool msl::socket::good() const
+{
+	return _connected;
+}
+
+//Poll Connection Function (Asks the OS if the other end is still there, updates good())
+bool msl::socket::poll_connection() const
 {
 	//Check for Errored Socket
 	if(_socket==static_cast<unsigned int>(SOCKET_ERROR)||_socket==static_cast<unsigned int>(INVALID_SOCKET))
-		return false;
+		_connected=false;
 
-	//Check for Disconnected Socket (Magic Situation of Select=1 and RECV=0)
-	char temp;
+	//Check for Disconnected Socket (Magic Situation of Select=1 and RECV=0, UDP never hangs up)
+	if(_connected&&!_udp)
+	{
+		char temp;
 
-	if(available()>0&&socket_peek(_socket,&temp,1)==0)
-		return false;
+		#if(defined(_WIN32)&&!defined(__CYGWIN__))
+			const int dont_wait=0;
+		#else
+			const int dont_wait=MSG_DONTWAIT;
+		#endif
+
+		if(available()>0&&socket_peek(_socket,&temp,1,0,dont_wait)<0)
+			_connected=false;
+	}
 
-	//Check Reading Error
-	return (available()>=0);
+	return _connected;
 }
 
 //Create Function (Hosts a Socket Locally) (TCP)
@@ -192,6 +212,8 @@ void msl::socket::create_tcp()
 {
 	_socket=socket_create(_address);
 	_hosting=true;
+	_udp=false;
+	_connected=(_socket!=static_cast<unsigned int>(SOCKET_ERROR));
 }
 
 //Create Function (Hosts a Socket Locally) (UDP)
@@ -199,6 +221,8 @@ void msl::socket::create_udp(const unsigned int buffersize)
 {
 	_socket=socket_create(_address,0,true,buffersize);
 	_hosting=true;
+	_udp=true;
+	_connected=(_socket!=static_cast<unsigned int>(SOCKET_ERROR));
 }
 
 //Connect Function (Connects to a Remote Socket) (TCP)
@@ -206,6 +230,8 @@ void msl::socket::connect_tcp()
 {
 	_socket=socket_connect(_address,0,false);
 	_hosting=false;
+	_udp=false;
+	_connected=(_socket!=static_cast<unsigned int>(SOCKET_ERROR));
 }
 
 //Connect Function (Connects to a Remote Socket) (UDP)
@@ -213,12 +239,15 @@ void msl::socket::connect_udp()
 {
 	_socket=socket_connect(_address,0,true);
 	_hosting=false;
+	_udp=true;
+	_connected=(_socket!=static_cast<unsigned int>(SOCKET_ERROR));
 }
 
-//Close Function (Closes a Local Socket)
+//Close Function (Closes a Local Socket, and forgets it so a reused descriptor is never touched)
 void msl::socket::close()
 {
-	socket_close(_socket);
+	_socket=socket_close(_socket);
+	_connected=false;
 }
 
 //Accept Function (Accepts a Remote Connection to a Local Socket)
@@ -227,7 +256,10 @@ msl::socket msl::socket::accept()
 	msl::socket ret;
 
 	if(available()>0)
+	{
 		ret._socket=socket_accept(_socket,ret._address);
+		ret._connected=(ret._socket!=static_cast<unsigned int>(SOCKET_ERROR));
+	}
 
 	return ret;
 }
@@ -235,19 +267,36 @@ msl::socket msl::socket::accept()
 //Available Function (Checks if there are Bytes to be Read, -1 on Error)
 int msl::socket::available() const
 {
-	return socket_available(_socket,0);
+	int ret=socket_available(_socket,0);
+
+	if(ret<0)
+		_connected=false;
+
+	return ret;
 }
 
 //Read Function (Returns -1 on Error Else Returns Number of Bytes Read)
 int msl::socket::read(void* buffer,const unsigned int size,const unsigned long time_out,const int flags) const
 {
-	return socket_read(_socket,buffer,size,time_out,flags);
+	int ret=socket_read(_socket,buffer,size,time_out,flags);
+
+	//Hung up or broken (UDP errors are just unreachable ports, keep trying)
+	if(ret<0&&!_udp)
+		_connected=false;
+
+	return ret;
 }
 
 //Write Function (Returns -1 on Error Else Returns Number of Bytes Sent)
 int msl::socket::write(const void* buffer,const unsigned int size,const unsigned long time_out,const int flags)
 {
-	return socket_write(_socket,buffer,size,time_out,flags);
+	int ret=socket_write(_socket,buffer,size,time_out,flags);
+
+	//Broken (UDP errors are just unreachable ports, keep trying)
+	if(ret<0&&!_udp)
+		_connected=false;
+
+	return ret;
 }
 
 //Write String Function (Returns -1 on Error Else Returns Number of Bytes Sent)
@@ -268,9 +317,88 @@ SOCKET msl::socket::system_socket() const
 	return _socket;
 }
 
+//Socket Poller Class Constructor
+msl::socket_poller::socket_poller(const unsigned long interval):_running(true),_interval(interval)
+{
+	pthread_mutex_init(&_lock,NULL);
+
+	if(pthread_create(&_thread,NULL,&thread_func,this)!=0)
+		_running=false;
+}
+
+//Socket Poller Class Destructor
+msl::socket_poller::~socket_poller()
+{
+	if(_running)
+	{
+		_running=false;
+		pthread_join(_thread,NULL);
+	}
+
+	pthread_mutex_destroy(&_lock);
+}
+
+//Socket Poller Class Add Function
+void msl::socket_poller::add(msl::socket& socket)
+{
+	pthread_mutex_lock(&_lock);
+	_sockets.push_back(&socket);
+	pthread_mutex_unlock(&_lock);
+}
+
+//Socket Poller Class Remove Function
+void msl::socket_poller::remove(msl::socket& socket)
+{
+	pthread_mutex_lock(&_lock);
+
+	for(unsigned int ii=0;ii<_sockets.size();++ii)
+	{
+		if(_sockets[ii]==&socket)
+		{
+			_sockets.erase(_sockets.begin()+ii);
+			--ii;
+		}
+	}
+
+	pthread_mutex_unlock(&_lock);
+}
+
+//Socket Poller Class Thread Function
+void* msl::socket_poller::thread_func(void* poller)
+{
+	msl::socket_poller* self=reinterpret_cast<msl::socket_poller*>(poller);
+
+	while(self->_running)
+	{
+		pthread_mutex_lock(&self->_lock);
+
+		for(unsigned int ii=0;ii<self->_sockets.size();++ii)
+			self->_sockets[ii]->poll_connection();
+
+		pthread_mutex_unlock(&self->_lock);
+		msl::nsleep(self->_interval*1000000);
+	}
+
+	return NULL;
+}
+
 //Temporary Socket Variables
 static bool socket_inited=false;
 
+//System Call Counter (Not locked, so only approximate when threads share sockets)
+static volatile unsigned long socket_syscalls=0;
+
+//Would Block Function (Last socket error was just "try again later")
+static bool socket_would_block()
+{
+	#if(defined(_WIN32)&&!defined(__CYGWIN__))
+		int error=WSAGetLastError();
+		return (error==WSAEWOULDBLOCK||error==WSAEINTR);
+	#else
+		return (errno==EAGAIN||errno==EWOULDBLOCK||errno==EINTR);
+	#endif
+}
+
 //Socket Initialize Function (Sets up the use of sockets, operating system dependent...)
 void socket_init()
 {
@@ -292,6 +420,12 @@ void socket_init()
 	}
 }
 
+//Socket System Call Count Function (Number of select/recv/send/accept calls made so far, for benchmarking)
+unsigned long socket_syscall_count()
+{
+	return socket_syscalls;
+}
+
 //Socket Create Function (Hosts a Socket Locally)
 SOCKET socket_create(const msl::ipv4 ip,const unsigned long time_out,const bool UDP,const unsigned int buffersize)
 {
@@ -337,7 +471,7 @@ SOCKET socket_create(const msl::ipv4 ip,const unsigned long time_out,const bool
 			if(bind(ret,(sockaddr*)&address,sizeof(address)))
 				return socket_close(ret);
 
-			if(!UDP&&listen(ret,5))
+			if(!UDP&&listen(ret,SOMAXCONN))
 				return socket_close(ret);
 
 			if(getsockname(ret,(sockaddr*)&address,&address_length))
@@ -404,6 +538,7 @@ SOCKET socket_accept(const SOCKET socket,msl::ipv4& client_ip,const unsigned lon
 	do
 	{
 		//Create Socket
+		++socket_syscalls;
 		ret=accept(socket,(sockaddr*)&address,&address_length);
 
 		//Check for Good Socket
@@ -459,6 +594,7 @@ int socket_available(const SOCKET socket,const unsigned long time_out)
 	FD_SET(socket,&rfds);
 
 	//Return Bytes Waiting
+	++socket_syscalls;
 	return select(1+socket,&rfds,NULL,NULL,&temp);
 }
 
@@ -486,7 +622,17 @@ int socket_read(const SOCKET socket,void* buffer,const unsigned int size,const u
 	do
 	{
 		//Get Bytes in Read Buffer
-		unsigned int bytes_read=recv(socket,reinterpret_cast<char*>(buffer)+(size-bytes_unread),bytes_unread,flags);
+		++socket_syscalls;
+		int bytes_read=recv(socket,reinterpret_cast<char*>(buffer)+(size-bytes_unread),bytes_unread,flags);
+
+		//Other End Hung Up, or Broken Socket (Unless Some Bytes Made It)
+		if((bytes_read==0&&size>0)||(bytes_read<0&&!socket_would_block()))
+		{
+			if(bytes_unread==size)
+				return -1;
+
+			break;
+		}
 
 		//If Bytes Were Read
 		if(bytes_read>0)
@@ -523,7 +669,17 @@ int socket_write(const SOCKET socket,const void* buffer,const unsigned int size,
 	do
 	{
 		//Get Bytes in Send Buffer
-		unsigned int bytes_sent=send(socket,reinterpret_cast<const char*>(buffer)+(size-bytes_unsent),bytes_unsent,flags);
+		++socket_syscalls;
+		int bytes_sent=send(socket,reinterpret_cast<const char*>(buffer)+(size-bytes_unsent),bytes_unsent,flags);
+
+		//Broken Socket (Unless Some Bytes Made It)
+		if(bytes_sent<0&&!socket_would_block())
+		{
+			if(bytes_unsent==size)
+				return -1;
+
+			break;
+		}
 
 		//If Bytes Were Sent
 		if(bytes_sent>0)
@@ -4,17 +4,24 @@
 
 //Required Libraries:
 //	Ws2_32 (windows only)
+//	pthread (msl::socket_poller only)
 
 //Begin Define Guards
 #ifndef MSL_SOCKET_H
 #define MSL_SOCKET_H
 
+//PThread Header (For msl::socket_poller)
+#include <pthread.h>
+
 //String Header
 #include <string>
 
 //String Stream Header
 #include <sstream>
 
+//Vector Header
+#include <vector>
+
 //Windows Dependencies
 #if(defined(_WIN32)&&!defined(__CYGWIN__))
 	#include <winsock2.h>
@@ -96,8 +103,14 @@ namespace msl
 			bool operator!=(const msl::socket& rhs) const;
 
 			//Good Function (Tests if Socket is Good)
+			//	No system calls, this is the state left by the last create, connect,
+			//	available, read, write, close, or poll_connection.
 			bool good() const;
 
+			//Poll Connection Function (Asks the OS if the other end is still there, updates good())
+			//	Costs a select, and a peek when bytes are waiting.
+			bool poll_connection() const;
+
 			//Create Functions (Hosts a Socket Locally)
 			void create_tcp();
 			void create_udp(const unsigned int buffersize);
@@ -133,12 +146,53 @@ namespace msl
 			msl::ipv4 _address;
 			SOCKET _socket;
 			bool _hosting;
+			bool _udp;
+			mutable volatile bool _connected;
+	};
+
+	//Socket Poller Class Declaration
+	//	Calls poll_connection() on every added socket from a background thread,
+	//	so good() notices a quiet peer hanging up without anybody reading.
+	class socket_poller
+	{
+		public:
+			//Constructor (Interval in milliseconds)
+			socket_poller(const unsigned long interval=100);
+
+			//Destructor (Stops the thread)
+			~socket_poller();
+
+			//Add Function (Socket must outlive the poller or be removed first)
+			void add(msl::socket& socket);
+
+			//Remove Function
+			void remove(msl::socket& socket);
+
+		private:
+			//Copy Constructor (Deleted)
+			socket_poller(const msl::socket_poller& copy);
+
+			//Copy Assignment Operator (Deleted)
+			msl::socket_poller& operator=(const msl::socket_poller& copy);
+
+			//Thread Function
+			static void* thread_func(void* poller);
+
+			//Member Variables
+			std::vector<msl::socket*> _sockets;
+			pthread_mutex_t _lock;
+			pthread_t _thread;
+			volatile bool _running;
+			unsigned long _interval;
 	};
 }
 
 //Socket Initialize Function (Sets up the use of sockets, operating system dependent...)
 void socket_init();
 
+//Socket System Call Count Function (Number of select/recv/send/accept calls made so far, for benchmarking)
+unsigned long socket_syscall_count();
+
 //Socket Create Function (Hosts a Socket Locally)
 SOCKET socket_create(const msl::ipv4 ip,const unsigned long time_out=0,const bool UDP=false,const unsigned int buffersize=200);
 
@@ -157,7 +211,7 @@ int socket_available(const SOCKET socket,const unsigned long time_out=0);
 //Socket Peek Function (Same as socket_read but Leaves Bytes in Socket Buffer)
 int socket_peek(const SOCKET socket,void* buffer,const unsigned int size,const unsigned long time_out=0,const int flags=0);
 
-//Socket Read Function (Returns Number of Bytes Read, -1 on Error)
+//Socket Read Function (Returns Number of Bytes Read, -1 on Error or if the Other End Hung Up)
 int socket_read(const SOCKET socket,void* buffer,const unsigned int size,const unsigned long time_out=0,const int flags=0);
 
 //Socket Write Function (Returns Number of Bytes Sent, -1 on Error)
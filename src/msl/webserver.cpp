@@ -3,14 +3,12 @@
 //	Modified On:	04/11/2014
 
 //Required Libraries:
+//	pthread (msl::file_cache)
 //	Ws2_32 (windows only)
 
 //Definitions for "webserver.hpp"
 #include "webserver.hpp"
 
-//File Utility Header
-#include "file_util.hpp"
-
 //Socket Utility Header
 #include "socket_util.hpp"
 
@@ -129,6 +127,12 @@ void msl::webserver::close()
 	_socket.close();
 }
 
+//File Cache Accessor (Static files served out of memory, default is 32 MB total and 1 MB per file.)
+msl::file_cache& msl::webserver::get_file_cache()
+{
+	return _file_cache;
+}
+
 //Service Client Function Definition
 void msl::webserver::service_client(msl::socket& client,const std::string& message)
 {
@@ -183,25 +187,9 @@ void msl::webserver::service_client(msl::socket& client,const std::string& messa
 			else if(msl::ends_with(request,".htm")||msl::ends_with(request,".html"))
 				mime_type="text/html";
 
-			//File Data Variable
-			std::string file;
-
-			//Load File
-			if(msl::file_to_string(_web_directory+request,file,true))
-			{
-				std::string response_str=msl::http_pack_string(file,mime_type,false);
-				client.write(response_str.c_str(),response_str.size());
-			}
-
-			//Bad File
-			else if(msl::file_to_string(_web_directory+"/not_found.html",file,true))
-			{
-				std::string response_str=msl::http_pack_string(file);
-				client.write(response_str.c_str(),response_str.size());
-			}
-
-			//No Bad File
-			else
+			//Serve File (Out of the cache unless it changed on disk), Else Bad File, Else No Bad File
+			if(!_file_cache.serve(client,_web_directory+request,mime_type,message)&&
+				!_file_cache.serve(client,_web_directory+"/not_found.html","text/html",message))
 			{
 				std::string response_str=msl::http_pack_string("sorry...");
 				client.write(response_str.c_str(),response_str.size());
@@ -3,12 +3,16 @@
 //	Modified On:	04/11/2014
 
 //Required Libraries:
+//	pthread (msl::file_cache)
 //	Ws2_32 (windows only)
 
 //Begin Define Guards
 #ifndef MSL_WEBSERVER_H
 #define MSL_WEBSERVER_H
 
+//File Cache Header
+#include "file_cache.hpp"
+
 //Socket Header
 #include "socket.hpp"
 
@@ -47,6 +51,9 @@ namespace msl
 			//Close Function (Closes Server) (Warning!!!  This doesn't close all the threads, there is no way to kill a running joined thread in C++11...yet...)
 			void close();
 
+			//File Cache Accessor (Static files served out of memory, default is 32 MB total and 1 MB per file.)
+			msl::file_cache& get_file_cache();
+
 		private:
 			//Member Variables
 			bool(*_user_service_client)(msl::socket& client,const std::string& message);
@@ -55,6 +62,7 @@ namespace msl
 			std::vector<msl::socket> _clients;
 			std::vector<std::string> _client_messages;
 			std::string _web_directory;
+			msl::file_cache _file_cache;
 	};
 }
 
@@ -9,9 +9,6 @@
 //Definitions for "webserver_threaded.hpp"
 #include "webserver_threaded.hpp"
 
-//File Utility Header
-#include "file_util.hpp"
-
 //Socket Utility Header
 #include "socket_util.hpp"
 
@@ -24,18 +21,35 @@
 //Time Utility Header
 #include "time_util.hpp"
 
+//Algorithm Header
+#include <algorithm>
+
+//C String Header
+#include <cstring>
+
+//Set Header
+#include <set>
+
+//Epoll Header (Event loop mode is Linux only)
+#if(defined(__linux__))
+	#include <sys/epoll.h>
+#endif
+
 //Thread Argument Passing Container
 class client_thread_arg
 {
 	public:
 		msl::socket socket;
 		std::string web_directory;
+		msl::file_cache* file_cache;
 		bool(*user_service_client)(msl::socket& client,const std::string& message);
 		unsigned int max_upload_size;
 };
 
-//Static Global Service Client Function
-void service_client(msl::socket client,const std::string&message,const std::string web_directory,bool(*user_service_client)(msl::socket& client,const std::string& message))
+//Static Global Service Client Function (If pending isn't NULL, our responses never wait on client, what it won't take yet is left in pending,
+//	keep_alive false means client gets closed after this response)
+void service_client(msl::socket& client,const std::string&message,const std::string web_directory,bool(*user_service_client)(msl::socket& client,const std::string& message),
+	msl::file_cache& file_cache,msl::pending_output* pending=NULL,const bool keep_alive=true)
 {
 	//If User Options Fail
 	if(user_service_client==NULL||!user_service_client(client,message))
@@ -88,28 +102,16 @@ void service_client(msl::socket client,const std::string&message,const std::stri
 			else if(msl::ends_with(request,".htm")||msl::ends_with(request,".html"))
 				mime_type="text/html";
 
-			//File Data Variable
-			std::string file;
-
-			//Load File
-			if(msl::file_to_string(web_directory+request,file,true))
-			{
-				std::string response_str=msl::http_pack_string(file,mime_type,false);
-				client.write(response_str.c_str(),response_str.size(),120000);
-			}
-
-			//Bad File
-			else if(msl::file_to_string(web_directory+"/not_found.html",file,true))
-			{
-				std::string response_str=msl::http_pack_string(file);
-				client.write(response_str.c_str(),response_str.size(),120000);
-			}
-
-			//No Bad File
-			else
+			//Serve File (Out of the cache unless it changed on disk), Else Bad File, Else No Bad File
+			if(!file_cache.serve(client,web_directory+request,mime_type,message,120000,pending,keep_alive)&&
+				!file_cache.serve(client,web_directory+"/not_found.html","text/html",message,120000,pending,keep_alive))
 			{
 				std::string response_str=msl::http_pack_string("sorry...");
-				client.write(response_str.c_str(),response_str.size(),120000);
+
+				if(pending==NULL)
+					client.write(response_str.c_str(),response_str.size(),120000);
+				else if(!pending->write(client,response_str.c_str(),response_str.size()))
+					client.close();
 			}
 		}
 
@@ -152,7 +154,7 @@ static void* client_thread(void* args)
 				if(msl::ends_with(message,"\r\n\r\n")||message.size()>=client_data->max_upload_size)
 				{
 					service_client(client_data->socket,message,client_data->web_directory,
-						client_data->user_service_client);
+						client_data->user_service_client,*client_data->file_cache);
 					message.clear();
 				}
 			}
@@ -173,12 +175,328 @@ static void* client_thread(void* args)
 	return NULL;
 }
 
+//Event Loop Client Container
+class event_client
+{
+	public:
+		msl::socket socket;
+		std::string buffer;
+		unsigned int scanned;			//Buffer before here has no "\r\n\r\n" in it
+		msl::pending_output output;		//Response bytes the socket hasn't taken yet
+		bool writing;					//Waiting for EPOLLOUT (not reading) until output is sent
+		bool closing;					//Close once output is sent
+};
+
+//Header Value Function (Value of a header in buffer[begin,end), lower case, "" if missing)
+static std::string header_value(const std::string& buffer,const size_t begin,const size_t end,const std::string& name)
+{
+	size_t line=buffer.find("\r\n",begin);
+
+	while(line!=std::string::npos&&line<end)
+	{
+		line+=2;
+		size_t line_end=std::min(buffer.find("\r\n",line),end);
+		size_t colon=buffer.find(':',line);
+
+		if(colon<line_end&&msl::to_lower(buffer.substr(line,colon-line))==name)
+		{
+			size_t value=buffer.find_first_not_of(" \t",colon+1);
+
+			if(value>=line_end)
+				return "";
+
+			return msl::to_lower(buffer.substr(value,line_end-value));
+		}
+
+		line=line_end;
+	}
+
+	return "";
+}
+
+#if(defined(__linux__))
+
+//Event Loop Worker Class (One thread, one epoll set, many clients)
+class msl::webserver_event_worker
+{
+	public:
+		webserver_event_worker(const std::string& web_directory,bool(*user_service_client)(msl::socket& client,const std::string& message),
+			msl::file_cache& file_cache,const unsigned int max_upload_size):_web_directory(web_directory),
+			_user_service_client(user_service_client),_file_cache(file_cache),_max_upload_size(max_upload_size),_running(false)
+		{
+			pthread_mutex_init(&_lock,NULL);
+			_epoll=epoll_create(1024);
+
+			if(_epoll>=0)
+			{
+				_running=true;
+
+				if(pthread_create(&_thread,NULL,&thread_func,this)!=0)
+					_running=false;
+			}
+		}
+
+		~webserver_event_worker()
+		{
+			if(_running)
+			{
+				_running=false;
+				pthread_join(_thread,NULL);
+			}
+
+			while(!_clients.empty())
+				close_client(*_clients.begin());
+
+			if(_epoll>=0)
+				::close(_epoll);
+
+			pthread_mutex_destroy(&_lock);
+		}
+
+		bool good() const
+		{
+			return _running;
+		}
+
+		//Add Function (Called from the accepting thread)
+		void add(const msl::socket& client)
+		{
+			event_client* new_client=new event_client;
+			new_client->socket=client;
+			new_client->scanned=0;
+			new_client->writing=false;
+			new_client->closing=false;
+
+			pthread_mutex_lock(&_lock);
+			_clients.insert(new_client);
+			pthread_mutex_unlock(&_lock);
+
+			epoll_event event;
+			memset(&event,0,sizeof(event));
+			event.events=EPOLLIN|EPOLLRDHUP;
+			event.data.ptr=new_client;
+
+			if(epoll_ctl(_epoll,EPOLL_CTL_ADD,client.system_socket(),&event)!=0)
+				close_client(new_client);
+		}
+
+	private:
+		//Thread Function
+		static void* thread_func(void* worker)
+		{
+			msl::webserver_event_worker* self=reinterpret_cast<msl::webserver_event_worker*>(worker);
+			const int max_events=64;
+			epoll_event events[max_events];
+			unsigned long last_sweep=msl::millis();
+
+			while(self->_running)
+			{
+				int count=epoll_wait(self->_epoll,events,max_events,100);
+
+				for(int ii=0;ii<count;++ii)
+				{
+					event_client* client=reinterpret_cast<event_client*>(events[ii].data.ptr);
+
+					if(!self->service(*client))
+						self->close_client(client);
+				}
+
+				//Once a Second, Drop Clients That Stopped Taking Their Responses
+				if(msl::millis()-last_sweep>=1000)
+				{
+					self->close_stalled();
+					last_sweep=msl::millis();
+				}
+			}
+
+			return NULL;
+		}
+
+		//Watch Function (Switches client between waiting to read and waiting to write, returns false on error)
+		//	No EPOLLRDHUP while writing: a half closed client can still take our output, and as
+		//	level triggered it would wake us every wait until close_stalled gave up on it.
+		bool watch(event_client& client,const bool writing)
+		{
+			if(client.writing==writing)
+				return true;
+
+			epoll_event event;
+			memset(&event,0,sizeof(event));
+			event.events=(writing?EPOLLOUT:(EPOLLIN|EPOLLRDHUP));
+			event.data.ptr=&client;
+			client.writing=writing;
+
+			return (epoll_ctl(_epoll,EPOLL_CTL_MOD,client.socket.system_socket(),&event)==0);
+		}
+
+		//Close Stalled Function (Closes clients whose output hasn't moved in write_time_out)
+		void close_stalled()
+		{
+			std::vector<event_client*> stalled;
+			unsigned long now=msl::millis();
+
+			pthread_mutex_lock(&_lock);
+
+			for(std::set<event_client*>::iterator ii=_clients.begin();ii!=_clients.end();++ii)
+				if(!(*ii)->output.empty()&&now-(*ii)->output.last_progress()>=write_time_out)
+					stalled.push_back(*ii);
+
+			pthread_mutex_unlock(&_lock);
+
+			for(unsigned int ii=0;ii<stalled.size();++ii)
+				close_client(stalled[ii]);
+		}
+
+		//Service Function (Sends what's left, reads what's waiting, services every whole request, returns false to close)
+		bool service(event_client& client)
+		{
+			//Earlier responses go out before we look at more requests
+			if(!client.output.flush(client.socket))
+				return false;
+
+			if(!client.output.empty())
+				return true;
+
+			if(client.closing)
+				return false;
+
+			//Read everything waiting (a short read means we've emptied the socket)
+			char chunk[16384];
+			bool hung_up=false;
+
+			while(true)
+			{
+				int bytes_read=client.socket.read(chunk,sizeof(chunk),0,MSG_DONTWAIT);
+
+				if(bytes_read<0)
+					hung_up=true;
+
+				if(bytes_read<=0)
+					break;
+
+				client.buffer.append(chunk,bytes_read);
+
+				if(bytes_read<static_cast<int>(sizeof(chunk)))
+					break;
+			}
+
+			//Service every whole request (pipelined requests can arrive together)
+			size_t start=0;
+			bool keep_alive=true;
+
+			while(keep_alive&&client.socket.good()&&client.output.empty())
+			{
+				size_t header_end=client.buffer.find("\r\n\r\n",client.scanned);
+
+				//Headers not all here, remember where we looked (request could end split across reads)
+				if(header_end==std::string::npos)
+				{
+					if(client.buffer.size()>start+3)
+						client.scanned=client.buffer.size()-3;
+
+					//Too big, service what we have (like the thread per client mode does)
+					if(client.buffer.size()-start>=_max_upload_size)
+					{
+						service_client(client.socket,client.buffer.substr(start),_web_directory,_user_service_client,_file_cache,&client.output);
+						start=client.buffer.size();
+					}
+
+					break;
+				}
+
+				//Body (if any) not all here
+				size_t body_size=msl::to_int(header_value(client.buffer,start,header_end,"content-length"));
+				size_t request_size=header_end+4+body_size-start;
+
+				if(body_size>_max_upload_size)
+					return false;
+
+				if(client.buffer.size()-start<request_size)
+				{
+					client.scanned=header_end;
+					break;
+				}
+
+				//HTTP/1.1 keeps connections by default, HTTP/1.0 only if asked
+				std::string connection=header_value(client.buffer,start,header_end,"connection");
+				size_t request_line_end=client.buffer.find("\r\n",start);
+
+				if(client.buffer.substr(start,request_line_end-start).find("HTTP/1.0")!=std::string::npos)
+					keep_alive=(connection=="keep-alive");
+				else
+					keep_alive=(connection!="close");
+
+				std::string message=client.buffer.substr(start,request_size);
+				start+=request_size;
+				client.scanned=start;
+				service_client(client.socket,message,_web_directory,_user_service_client,_file_cache,&client.output,keep_alive);
+			}
+
+			//Drop serviced requests
+			client.buffer.erase(0,start);
+			client.scanned-=std::min(client.scanned,static_cast<unsigned int>(start));
+
+			if(hung_up||!client.socket.good())
+				return false;
+
+			//Response didn't all go, stop reading until it has (the rest of the buffer waits too)
+			if(!client.output.empty())
+			{
+				client.closing=!keep_alive;
+				return watch(client,true);
+			}
+
+			return (keep_alive&&watch(client,false));
+		}
+
+		//Close Client Function (The user may have closed the socket already)
+		void close_client(event_client* client)
+		{
+			if(client->socket.system_socket()!=static_cast<unsigned int>(SOCKET_ERROR))
+			{
+				epoll_ctl(_epoll,EPOLL_CTL_DEL,client->socket.system_socket(),NULL);
+				client->socket.close();
+			}
+
+			pthread_mutex_lock(&_lock);
+			_clients.erase(client);
+			pthread_mutex_unlock(&_lock);
+
+			delete client;
+		}
+
+		static const unsigned long write_time_out=120000;
+		std::string _web_directory;
+		bool(*_user_service_client)(msl::socket& client,const std::string& message);
+		msl::file_cache& _file_cache;
+		unsigned int _max_upload_size;
+		int _epoll;
+		pthread_t _thread;
+		volatile bool _running;
+		pthread_mutex_t _lock;
+		std::set<event_client*> _clients;
+};
+
+#else
+
+//Event Loop Worker Class (Not available here, update() falls back to a thread per client)
+class msl::webserver_event_worker
+{};
+
+#endif
+
 //Constructor (Default)
 msl::webserver_threaded::webserver_threaded(const std::string& address,bool(*user_service_client)(msl::socket& client,const std::string& message),
 	const std::string& web_directory):_user_service_client(user_service_client),_socket(address),_web_directory(web_directory),
-	_max_upload_size(2*1000000)
+	_max_upload_size(2*1000000),_event_workers(0),_next_worker(0)
 {}
 
+//Destructor (Stops event loop workers, if any)
+msl::webserver_threaded::~webserver_threaded()
+{
+	stop_event_workers();
+}
+
 //Boolean Operator (Tests if Server is Good)
 msl::webserver_threaded::operator bool() const
 {
@@ -206,6 +524,30 @@ void msl::webserver_threaded::setup()
 //Update Function (Connects Clients and Runs Server)
 void msl::webserver_threaded::update()
 {
+	//Event Loop Mode (Accept everybody waiting, hand them to workers round robin)
+	if(_event_workers>0&&_workers.empty())
+		start_event_workers();
+
+	#if(defined(__linux__))
+		if(!_workers.empty())
+		{
+			while(_socket.available()>0)
+			{
+				msl::socket client=_socket.accept();
+
+				if(!client.good())
+					break;
+
+				_workers[_next_worker]->add(client);
+				_next_worker=(_next_worker+1)%_workers.size();
+			}
+
+			//Give OS a Break
+			msl::nsleep(1000000);
+			return;
+		}
+	#endif
+
 	//Check for a Connecting Client
 	msl::socket client=_socket.accept();
 
@@ -219,6 +561,7 @@ void msl::webserver_threaded::update()
 		client_thread_arg* new_client_data=new client_thread_arg;
 		new_client_data->socket=client;
 		new_client_data->web_directory=_web_directory;
+		new_client_data->file_cache=&_file_cache;
 		new_client_data->user_service_client=_user_service_client;
 		new_client_data->max_upload_size=get_max_upload_size();
 
@@ -238,6 +581,7 @@ void msl::webserver_threaded::update()
 //Close Function (Closes Server) (Warning!!!  This doesn't close all the threads, there is no way to kill a running joined thread in C++11...yet...)
 void msl::webserver_threaded::close()
 {
+	stop_event_workers();
 	_socket.close();
 }
 
@@ -251,4 +595,52 @@ unsigned int msl::webserver_threaded::get_max_upload_size() const
 void msl::webserver_threaded::set_max_upload_size(const unsigned int size)
 {
 	_max_upload_size=size;
-}
\ No newline at end of file
+}
+
+//Event Workers Accessor (Number of event loop threads, 0 means a thread per client.)
+unsigned int msl::webserver_threaded::get_event_workers() const
+{
+	return _event_workers;
+}
+
+//Event Workers Mutator (Call before the first update, 0 means a thread per client.  Default is 0.)
+void msl::webserver_threaded::set_event_workers(const unsigned int workers)
+{
+	_event_workers=workers;
+}
+
+//File Cache Accessor (Static files served out of memory, default is 32 MB total and 1 MB per file.)
+msl::file_cache& msl::webserver_threaded::get_file_cache()
+{
+	return _file_cache;
+}
+
+//Start Event Workers Function (Leaves _workers empty if epoll isn't available)
+void msl::webserver_threaded::start_event_workers()
+{
+	#if(defined(__linux__))
+		for(unsigned int ii=0;ii<_event_workers;++ii)
+		{
+			msl::webserver_event_worker* worker=new msl::webserver_event_worker(_web_directory,_user_service_client,_file_cache,
+				get_max_upload_size());
+
+			if(!worker->good())
+			{
+				delete worker;
+				break;
+			}
+
+			_workers.push_back(worker);
+		}
+	#endif
+}
+
+//Stop Event Workers Function (Closes their clients)
+void msl::webserver_threaded::stop_event_workers()
+{
+	for(unsigned int ii=0;ii<_workers.size();++ii)
+		delete _workers[ii];
+
+	_workers.clear();
+	_next_worker=0;
+}
@@ -6,10 +6,25 @@
 // 	pthread
 //	Ws2_32 (windows only)
 
+//Event Loop Mode (Linux only, see set_event_workers):
+//	Instead of a thread per client, a fixed pool of worker threads each waits on
+//	its own epoll set.  Reads are buffered, requests are split out incrementally
+//	(headers plus any Content-Length body), and connections stay open for
+//	keep-alive and pipelined requests.  The same user_service_client is called
+//	once per request, and can still write to or close the client.  Files and
+//	error pages never make a worker wait: what a client won't take right away
+//	is kept and sent as its socket drains, the client's later requests wait
+//	their turn, and a client that takes nothing for 2 minutes is closed.
+//	user_service_client writes still block the worker they run on, so keep
+//	their time outs short.
+
 //Begin Define Guards
 #ifndef MSL_WEBSERVER_THREADED_H
 #define MSL_WEBSERVER_THREADED_H
 
+//File Cache Header
+#include "file_cache.hpp"
+
 //Socket Header
 #include "socket.hpp"
 
@@ -25,6 +40,9 @@
 //MSL Namespace
 namespace msl
 {
+	//Event Loop Worker Pre-Declaration (Defined in webserver_threaded.cpp)
+	class webserver_event_worker;
+
 	//Web Server Threaded Class Declaration
 	class webserver_threaded
 	{
@@ -33,6 +51,9 @@ namespace msl
 			webserver_threaded(const std::string& address,bool(*user_service_client)(msl::socket& client,const std::string& message)=NULL,
 				const std::string& web_directory="web");
 
+			//Destructor (Stops event loop workers, if any)
+			~webserver_threaded();
+
 			//Boolean Operator (Tests if Server is Good)
 			operator bool() const;
 
@@ -57,12 +78,35 @@ namespace msl
 			//Max Size Mutator (Changes max upload size, in bytes.  Default is 200 MB.)
 			void set_max_upload_size(const unsigned int size);
 
+			//Event Workers Accessor (Number of event loop threads, 0 means a thread per client.)
+			unsigned int get_event_workers() const;
+
+			//Event Workers Mutator (Call before the first update, 0 means a thread per client.  Default is 0.)
+			void set_event_workers(const unsigned int workers);
+
+			//File Cache Accessor (Static files served out of memory, default is 32 MB total and 1 MB per file.)
+			msl::file_cache& get_file_cache();
+
 		private:
+			//Copy Constructor (Deleted)
+			webserver_threaded(const msl::webserver_threaded& copy);
+
+			//Copy Assignment Operator (Deleted)
+			msl::webserver_threaded& operator=(const msl::webserver_threaded& copy);
+
+			//Event Loop Functions
+			void start_event_workers();
+			void stop_event_workers();
+
 			//Member Variables
 			bool(*_user_service_client)(msl::socket& client,const std::string& message);
 			msl::socket _socket;
 			std::string _web_directory;
+			msl::file_cache _file_cache;
 			unsigned long _max_upload_size;
+			unsigned int _event_workers;
+			std::vector<msl::webserver_event_worker*> _workers;
+			unsigned int _next_worker;
 	};
 }
 
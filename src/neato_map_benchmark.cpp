@@ -0,0 +1,268 @@
+//Neato Map Benchmark Source
+//	Times turning Neato sweeps into a 20 m x 20 m occupancy grid: a rover5
+//	drives in a circle through a simulated room (walls and a few boxes), each
+//	sweep is ray traced against the room, converted to world points, and
+//	added to the grid.  Reports the time per sweep for each step, and how
+//	much of one core that is at the Neato's 5 sweeps per second.
+//
+//	Then, against that map, times the scan matcher: once from a guess that's
+//	off by 18 cm and 4 degrees, and once as a pose_estimator tracking the
+//	robot with noisy bullseye camera fixes that arrive late, twice a second.
+//	Position errors are compared against trusting only the camera.
+//
+//	Usage: neato_map_benchmark [sweeps]
+
+//Cyberalaska Headers
+#include "cyberalaska/neato_map.h"
+#include "cyberalaska/scan_matcher.h"
+#include "cyberalaska/time.h"
+
+//MSL Headers
+#include <msl/string_util.hpp>
+
+//STL Headers
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using cyberalaska::vec3;
+
+//Box Struct (Axis-aligned obstacle, centimeters)
+struct box
+{
+	float x0,y0,x1,y1;
+};
+
+//Room (Walls 10 cm thick around 20 m x 20 m, plus boxes and posts)
+static const box room[]=
+{
+	{0,0,2000,10},{0,1990,2000,2000},{0,0,10,2000},{1990,0,2000,2000},
+	{500,500,600,600},{1400,700,1500,900},{900,1400,1100,1450},{700,900,760,960},{1250,1150,1310,1210},
+	{300,1000,350,1300},{1650,1100,1700,1500},{800,300,1200,350},{1000,1650,1300,1700},
+	{1560,1220,1590,1250},{1220,1560,1250,1590},{750,1560,780,1590},{410,1220,440,1250},
+	{410,750,440,780},{750,410,780,440},{1220,410,1250,440},{1560,750,1590,780}
+};
+static const int room_boxes=sizeof(room)/sizeof(room[0]);
+
+//Neato Range (Millimeters, farther than this reads as no return)
+static const float max_range_mm=6000;
+
+//Trace Function (Distance in cm along direction dx,dy to the nearest box, or -1)
+static float trace(const float x,const float y,const float dx,const float dy)
+{
+	float best=-1;
+
+	for(int ii=0;ii<room_boxes;++ii)
+	{
+		const box& b=room[ii];
+		float t_near=-1e30,t_far=1e30;
+		float origin[2]={x,y},direction[2]={dx,dy},lo[2]={b.x0,b.y0},hi[2]={b.x1,b.y1};
+		bool miss=false;
+
+		for(int axis=0;axis<2;++axis)
+		{
+			if(direction[axis]==0)
+			{
+				if(origin[axis]<lo[axis]||origin[axis]>hi[axis])
+					miss=true;
+
+				continue;
+			}
+
+			float t0=(lo[axis]-origin[axis])/direction[axis];
+			float t1=(hi[axis]-origin[axis])/direction[axis];
+
+			if(t0>t1)
+				std::swap(t0,t1);
+
+			t_near=std::max(t_near,t0);
+			t_far=std::min(t_far,t1);
+		}
+
+		if(!miss&&t_near<=t_far&&t_near>0&&(best<0||t_near<best))
+			best=t_near;
+	}
+
+	return best;
+}
+
+//Angle Difference Function (Degrees between two headings, 0 to 180)
+static double angle_difference(const double a,const double b)
+{
+	double difference=std::fmod(std::fabs(a-b),360.0);
+	return std::min(difference,360.0-difference);
+}
+
+//Sweep Function (What the Neato on this robot would see)
+static void simulate_sweep(const cyberalaska::robot& r,const cyberalaska::sensor_t& neato,cyberalaska::neato_scan_t& scan)
+{
+	double robot_rad=r.angle*M_PI/180.0;
+	float sx=r.location.x+cos(robot_rad)*neato.location.x-sin(robot_rad)*neato.location.y;
+	float sy=r.location.y+sin(robot_rad)*neato.location.x+cos(robot_rad)*neato.location.y;
+	NeatoLDSbatch batch;
+	batch.speed64=300*64;
+
+	for(int start=0;start<cyberalaska::neato_scan_t::ndir;start+=NeatoLDSbatch::size)
+	{
+		batch.index=start;
+
+		for(int ii=0;ii<NeatoLDSbatch::size;++ii)
+		{
+			double rad=robot_rad+(start+ii)*M_PI/180.0;
+			float mm=10*trace(sx,sy,cos(rad),sin(rad));
+			batch.dir[ii].distance=(mm>0&&mm<max_range_mm)?(unsigned short)mm:0;
+			batch.dir[ii].signal=(mm>0&&mm<max_range_mm)?3:0;
+		}
+
+		scan.add(batch,0.0);
+	}
+}
+
+//Main
+int main(int argc,char* argv[])
+{
+	int sweeps=3000;
+
+	if(argc>1)
+		sweeps=msl::to_int(argv[1]);
+
+	//Rover5 with a Neato 20 cm ahead of its center
+	cyberalaska::metadata_general meta_robot("benchmark robot","rover5","benchmark");
+	cyberalaska::metadata_sensor meta_neato("laser distance sensor","XV-11","benchmark","mm",360);
+	cyberalaska::robot r(meta_robot);
+	cyberalaska::sensor_t neato(meta_neato);
+	neato.set_location(vec3(20,0,0));
+	neato.set_direction(vec3(1,0,0));
+
+	//Simulate Every Sweep First (Not part of the timing)
+	std::vector<cyberalaska::neato_scan_t> scans(sweeps);
+	std::vector<vec3> locations(sweeps);
+	std::vector<double> angles(sweeps);
+
+	for(int ii=0;ii<sweeps;++ii)
+	{
+		double around=ii*2.0*M_PI/sweeps;
+		locations[ii]=vec3(1000+500*cos(around),1000+500*sin(around),0);
+		angles[ii]=around*180.0/M_PI+90.0;
+		r.location=locations[ii];
+		r.angle=angles[ii];
+		simulate_sweep(r,neato,scans[ii]);
+	}
+
+	//Time the Map (Cells offset half a cell, so box faces fall mid-cell like real walls do)
+	cyberalaska::occupancy_grid grid(vec3(-2.5,-2.5,0),2005,2005);
+	std::vector<cyberalaska::neato_points_t> points(sweeps);
+
+	//Timed in Seconds (msl::millis only counts whole milliseconds, and a sweep's points take microseconds)
+	double start=cyberalaska::time();
+
+	for(int ii=0;ii<sweeps;++ii)
+	{
+		r.location=locations[ii];
+		r.angle=angles[ii];
+		cyberalaska::neato_world_points(scans[ii],r,neato,points[ii]);
+	}
+
+	double points_seconds=cyberalaska::time()-start;
+	start=cyberalaska::time();
+
+	for(int ii=0;ii<sweeps;++ii)
+		grid.add_points(points[ii]);
+
+	double grid_seconds=cyberalaska::time()-start;
+
+	double total_us=(points_seconds+grid_seconds)*1000000.0/sweeps;
+	std::cout<<sweeps<<" sweeps into a "<<grid.cells_wide<<"x"<<grid.cells_high<<" grid of "
+		<<grid.cell_size<<" cm cells:"<<std::endl;
+	std::cout<<"\tpoints\t"<<points_seconds*1000000.0/sweeps<<" us/sweep"<<std::endl;
+	std::cout<<"\tgrid\t"<<grid_seconds*1000000.0/sweeps<<" us/sweep"<<std::endl;
+	std::cout<<"\ttotal\t"<<total_us<<" us/sweep, "<<total_us*5.0/10000.0<<"% of a core at 5 Hz"<<std::endl;
+
+	//The Map Should Show Walls and Boxes, and Open Floor Between
+	if(grid.probability(vec3(1991,1000,0))<=0.5||grid.probability(vec3(601,550,0))<=0.5||
+		grid.probability(vec3(1700,1000,0))>=0.5||grid.probability(vec3(1300,1300,0))>=0.5)
+	{
+		std::cout<<"FAIL: map doesn't match the room"<<std::endl;
+		return 1;
+	}
+
+	//Scan Matching from a Bad Guess (Every 10th sweep)
+	cyberalaska::scan_matcher matcher;
+	matcher.set_map(grid);
+	std::cout<<"scan matching ("<<matcher.stats.table_seconds*1000.0<<" ms to build tables):"<<std::endl;
+	double worst_cm=0,worst_deg=0;
+	int matched=0,tried=0;
+
+	for(int ii=0;ii<sweeps;ii+=10)
+	{
+		cyberalaska::pose2d guess(locations[ii].x+15,locations[ii].y-10,angles[ii]+4),found;
+		++tried;
+
+		if(matcher.match(scans[ii],neato,guess,found))
+		{
+			++matched;
+			worst_cm=std::max(worst_cm,hypot(found.x-locations[ii].x,found.y-locations[ii].y));
+			worst_deg=std::max(worst_deg,angle_difference(found.angle,angles[ii]));
+
+			if(found.angle<-180||found.angle>180)
+				worst_deg=1000; // matches come back wrapped
+		}
+	}
+
+	std::cout<<"	match	"<<matcher.stats.total_seconds*1000000.0/matcher.stats.matches<<" us/match ("
+		<<matcher.stats.max_seconds*1000000.0<<" us worst), "<<matched<<"/"<<tried<<" matched, worst error "
+		<<worst_cm<<" cm, "<<worst_deg<<" degrees"<<std::endl;
+
+	if(matched<tried*9/10||worst_cm>10||worst_deg>2)
+	{
+		std::cout<<"FAIL: scan matcher lost the robot"<<std::endl;
+		return 1;
+	}
+
+	//Tracking: Sweeps at 5 Hz, Camera Fixes at 2 Hz that are 5 cm and 2 Degrees Noisy and 200 ms Late
+	cyberalaska::pose_estimator estimator;
+	vec3 camera_pose;
+	double fused_error=0,camera_error=0,worst_track_deg=0;
+	int tracked=0;
+	srand(1);
+
+	for(int ii=1;ii<sweeps;++ii)
+	{
+		double now=ii*0.2;
+
+		if(ii%5==0)
+		{
+			double noise_x=5.0*(2.0*rand()/RAND_MAX-1.0),noise_y=5.0*(2.0*rand()/RAND_MAX-1.0);
+			double noise_angle=2.0*(2.0*rand()/RAND_MAX-1.0);
+			camera_pose=vec3(locations[ii-1].x+noise_x,locations[ii-1].y+noise_y,(angles[ii-1]+noise_angle)*M_PI/180.0);
+			estimator.camera_fix(camera_pose,now-0.2);
+		}
+
+		if(estimator.camera_fixes==0)
+			continue;
+
+		estimator.scan_update(matcher,scans[ii],neato,now);
+		fused_error+=hypot(estimator.pose.x-locations[ii].x,estimator.pose.y-locations[ii].y);
+		camera_error+=hypot(camera_pose.x-locations[ii].x,camera_pose.y-locations[ii].y);
+		worst_track_deg=std::max(worst_track_deg,angle_difference(estimator.pose.angle,angles[ii]));
+
+		if(estimator.pose.angle<-180||estimator.pose.angle>180)
+			worst_track_deg=1000;
+
+		++tracked;
+	}
+
+	std::cout<<"	track	"<<estimator.scan_updates<<" scan updates, "<<estimator.scan_rejects<<" rejected, "
+		<<estimator.camera_fixes<<" camera fixes"<<std::endl;
+	std::cout<<"	error	"<<fused_error/tracked<<" cm fused, "<<camera_error/tracked<<" cm camera only, worst heading "
+		<<worst_track_deg<<" degrees"<<std::endl;
+
+	if(worst_track_deg>5)
+	{
+		std::cout<<"FAIL: pose estimator heading drifted or left -180 to +180"<<std::endl;
+		return 1;
+	}
+
+	return 0;
+}
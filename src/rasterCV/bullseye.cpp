@@ -6,50 +6,335 @@ Dr. Orion Sky Lawlor, lawlor@alaska.edu, 2013-11-06 (Public Domain)
 #include "bullseye.h"
 #include <algorithm> /* for std::sort */
 
+#if defined(__AVX__)
+#include <immintrin.h> /* 8-wide float gradient threshold */
+#elif defined(__SSE2__)
+#include <emmintrin.h> /* 4-wide float gradient threshold */
+#endif
 
-typedef unsigned short accum_t;
+
+/**
+ Vote accumulator pixel types.  Each provides the pixel type, its OpenCV
+ type code, how to add one vote, and how to sum two threads' vote rows.
+*/
+/// 16-bit votes: compact, and stick at 65535 instead of wrapping to zero.
+class bullseyeVotes16 {
+public:
+	typedef unsigned short pixel_t;
+	enum {cvType=CV_16U};
+	
+	static inline void vote(pixel_t &p) { p+=(p!=0xffff); }
+	
+	static void merge(pixel_t *dst,const pixel_t *src,int n) {
+		int x=0;
+#if defined(__SSE2__)
+		for (;x+8<=n;x+=8) {
+			__m128i d=_mm_loadu_si128((const __m128i *)(dst+x));
+			__m128i s=_mm_loadu_si128((const __m128i *)(src+x));
+			_mm_storeu_si128((__m128i *)(dst+x),_mm_adds_epu16(d,s));
+		}
+#endif
+		for (;x<n;x++) dst[x]=(pixel_t)std::min(0xffff,dst[x]+src[x]);
+	}
+};
+
+/// 32-bit votes: twice the memory, but no image we'll ever see can overflow them.
+class bullseyeVotes32 {
+public:
+	typedef unsigned int pixel_t; // stored as CV_32S, but never near 2^31
+	enum {cvType=CV_32S};
+	
+	static inline void vote(pixel_t &p) { p++; }
+	
+	static void merge(pixel_t *dst,const pixel_t *src,int n) {
+		int x=0;
+#if defined(__SSE2__)
+		for (;x+4<=n;x+=4) {
+			__m128i d=_mm_loadu_si128((const __m128i *)(dst+x));
+			__m128i s=_mm_loadu_si128((const __m128i *)(src+x));
+			_mm_storeu_si128((__m128i *)(dst+x),_mm_add_epi32(d,s));
+		}
+#endif
+		for (;x<n;x++) dst[x]+=src[x];
+	}
+};
+
+/* Pick the accumulator at compile time: -DBULLSEYE_VOTE_BITS=32 for huge
+   frames or very long vote lines, where 16 bits would saturate. */
+#ifndef BULLSEYE_VOTE_BITS
+#  define BULLSEYE_VOTE_BITS 16
+#endif
+#if BULLSEYE_VOTE_BITS==32
+typedef bullseyeVotes32 bullseyeVotes;
+#else
+typedef bullseyeVotes16 bullseyeVotes;
+#endif
+
+typedef bullseyeVotes::pixel_t accum_t;
 inline accum_t fetchAccum(const cv::Mat &accum,int x,int y) {
 	return ((const accum_t *)accum.data)[y*accum.cols+x];
 }
 
-/* Increment pixels along this line. */
-static void accumulateLine(cv::Mat &accum,
+/**
+ A horizontal band of vote accumulator rows, used so each thread can vote
+ into its own private storage.  Row y0 of the full image is row 0 here.
+*/
+template <class ACCUM>
+struct accumBand {
+	typedef typename ACCUM::pixel_t pixel_t;
+	pixel_t *data; ///< first pixel of band
+	int cols; ///< pixels per row (same as full image)
+	int y0; ///< full-image row number of our first row
+	
+	inline pixel_t *at(int x,int y) const { return data+(y-y0)*cols+x; }
+};
+
+/* Increment pixels along this line, rounded to the nearest pixel
+   (exact halves round up).  imgSize is the full image, which we clip
+   against once up front; after that each vote is an integer DDA step:
+   one add and one compare, with no float-to-int conversions. */
+template <class ACCUM>
+static void accumulateLine(const accumBand<ACCUM> &accum,cv::Size imgSize,
 	cv::Point S,cv::Point E)
 {
-	accum_t *accumDat=(accum_t *)accum.data;
-	cv::Rect r(2,2,accum.cols-4,accum.rows-4);
+	cv::Rect r(2,2,imgSize.width-4,imgSize.height-4);
 	if (!cv::clipLine(r,S,E)) return;
 	
-	float rounding=0.49999; // compensates for rounding down
-	
-	int dx=E.x-S.x;
-	int dy=E.y-S.y;
-	if (abs(dx)>abs(dy)) 
+	int major, minor; // pointer step along the major and minor axes
+	int len, slope; // major and minor axis extents (len>0, |slope|<=len)
+	if (abs(E.x-S.x)>abs(E.y-S.y)) 
 	{ /* X-major line */
 		if (E.x<S.x) std::swap(S,E);
-		float m=(E.y-S.y)/float(E.x-S.x);
-		float b=S.y-m*S.x+rounding;
-		for (int x=S.x;x<=E.x;x++)
-		{
-			float y=m*x+b;
-			//if (y<0 || y>=accum.rows) abort();
-			accumDat[((int)y)*accum.cols+x]+=1.0;
-		}
+		len=E.x-S.x; slope=E.y-S.y;
+		major=1; minor=accum.cols;
 	}
 	else  /* dx<=dy */
 	{ /* Y-major line */
 		if (E.y==S.y) return; // start and end are equal
 		
 		if (E.y<S.y) std::swap(S,E);
-		float m=(E.x-S.x)/float(E.y-S.y);
-		float b=S.x-m*S.y+rounding;
-		for (int y=S.y;y<=E.y;y++)
+		len=E.y-S.y; slope=E.x-S.x;
+		major=accum.cols; minor=1;
+	}
+	
+	/* At step t the minor axis offset is floor((2*t*slope+len)/(2*len)),
+	   i.e., t*slope/len rounded.  err is that fraction's numerator. */
+	int twoLen=2*len, twoSlope=2*slope;
+	int err=len;
+	typename ACCUM::pixel_t *p=accum.at(S.x,S.y);
+	for (int t=0;t<=len;t++)
+	{
+		ACCUM::vote(*p);
+		p+=major;
+		err+=twoSlope;
+		if (err>=twoLen) { err-=twoLen; p+=minor; }
+		else if (err<0) { err+=twoLen; p-=minor; }
+	}
+}
+
+
+/// Gradient pixel type (matches grad_typecode in findBullseyes)
+typedef float grad_t;
+
+/* Draw the vote line for the steep gradient (dx,dy) of length mag at pixel (x,y). */
+template <class ACCUM>
+static inline void voteGradient(const accumBand<ACCUM> &accum,cv::Size imgSize,
+	int x,int y,float dx,float dy,float mag,double gradientVotePixels)
+{
+	float s=gradientVotePixels/mag; // scale factor from gradient to line length
+	accumulateLine(accum,imgSize,
+		cv::Point(x+dx*s,y+dy*s),
+		cv::Point(x-dx*s,y-dy*s));
+	
+	/* // cv::line doesn't support alpha blending (WHY NOT?!)
+	cv::line(annot,
+		cv::Point(x+dx*s,y+dy*s),
+		cv::Point(x-dx*s,y-dy*s),
+		cv::Scalar(255,0,0,10),0.1,CV_AA);
+	*/
+}
+
+/* Vote for every steep gradient along row y.
+   The SIMD path only speeds up the threshold test (most pixels fail it);
+   each surviving gradient is voted with exactly the scalar arithmetic. */
+template <class ACCUM>
+static void voteRow(const accumBand<ACCUM> &accum,cv::Size imgSize,int y,
+	const grad_t *gradXF,const grad_t *gradYF,
+	float minDiffSq,double gradientVotePixels,bool useSIMD)
+{
+	int x=0, w=imgSize.width;
+#if defined(__AVX__)
+	if (useSIMD) {
+		__m256 thresh=_mm256_set1_ps(minDiffSq);
+		for (;x+8<=w;x+=8) {
+			__m256 dx=_mm256_loadu_ps(gradXF+x), dy=_mm256_loadu_ps(gradYF+x);
+			__m256 magSq=_mm256_add_ps(_mm256_mul_ps(dx,dx),_mm256_mul_ps(dy,dy));
+			int steep=_mm256_movemask_ps(_mm256_cmp_ps(magSq,thresh,_CMP_GT_OQ));
+			if (steep==0) continue; // common case: flat region
+			float mag[8];
+			_mm256_storeu_ps(mag,_mm256_sqrt_ps(magSq));
+			for (int i=0;i<8;i++) if (steep&(1<<i))
+				voteGradient(accum,imgSize,x+i,y,gradXF[x+i],gradYF[x+i],mag[i],gradientVotePixels);
+		}
+	}
+#elif defined(__SSE2__)
+	if (useSIMD) {
+		__m128 thresh=_mm_set1_ps(minDiffSq);
+		for (;x+4<=w;x+=4) {
+			__m128 dx=_mm_loadu_ps(gradXF+x), dy=_mm_loadu_ps(gradYF+x);
+			__m128 magSq=_mm_add_ps(_mm_mul_ps(dx,dx),_mm_mul_ps(dy,dy));
+			int steep=_mm_movemask_ps(_mm_cmpgt_ps(magSq,thresh));
+			if (steep==0) continue; // common case: flat region
+			float mag[4];
+			_mm_storeu_ps(mag,_mm_sqrt_ps(magSq));
+			for (int i=0;i<4;i++) if (steep&(1<<i))
+				voteGradient(accum,imgSize,x+i,y,gradXF[x+i],gradYF[x+i],mag[i],gradientVotePixels);
+		}
+	}
+#endif
+	for (;x<w;x++) 
+	{ /* scalar fallback, and any leftover pixels at the end of the row */
+		float dx=gradXF[x], dy=gradYF[x];
+		float magSq=dx*dx+dy*dy; // squared magnitude of gradient vector
+		if (magSq>minDiffSq)  
+		{
+			float mag=sqrt(magSq); // now a length
+			voteGradient(accum,imgSize,x,y,dx,dy,mag,gradientVotePixels);
+		}
+	}
+}
+
+/**
+ Splits the image into horizontal stripes, and votes for each stripe's
+ gradients into that stripe's own accumulator band.  Bands overlap their
+ neighbors by the vote line length, so threads never share a pixel.
+*/
+template <class ACCUM>
+class bullseyeVoteStripes : public cv::ParallelLoopBody {
+public:
+	cv::Mat &accum;
+	const std::vector<cv::Mat> &bandStorage;
+	int nStripes;
+	int margin; ///< rows a vote line can reach outside its stripe
+	const grad_t *gradXF, *gradYF;
+	float minDiffSq;
+	double gradientVotePixels;
+	bool useSIMD;
+
+	bullseyeVoteStripes(cv::Mat &accum_,const std::vector<cv::Mat> &bandStorage_,
+		int nStripes_,int margin_,
+		const grad_t *gradXF_,const grad_t *gradYF_,
+		float minDiffSq_,double gradientVotePixels_,bool useSIMD_)
+		:accum(accum_), bandStorage(bandStorage_), nStripes(nStripes_), margin(margin_),
+		 gradXF(gradXF_), gradYF(gradYF_),
+		 minDiffSq(minDiffSq_), gradientVotePixels(gradientVotePixels_), useSIMD(useSIMD_)
+	{}
+
+	/// First image row of this stripe (stripe nStripes is one past the end)
+	int stripeStart(int stripe) const { return stripe*accum.rows/nStripes; }
+	
+	/// First image row of this stripe's band
+	int bandStart(int stripe) const { return std::max(0,stripeStart(stripe)-margin); }
+	/// Number of rows in this stripe's band
+	int bandRows(int stripe) const { 
+		return std::min(accum.rows,stripeStart(stripe+1)+margin)-bandStart(stripe); 
+	}
+	
+	/// Votes for this stripe go here
+	accumBand<ACCUM> band(int stripe) const {
+		accumBand<ACCUM> b;
+		b.cols=accum.cols;
+		if (nStripes==1) 
+		{ /* only one thread: vote straight into the output */
+			b.y0=0;
+			b.data=(typename ACCUM::pixel_t *)accum.data;
+		}
+		else 
 		{
-			float x=m*y+b;
-			//if (x<0 || x>=accum.cols) abort();
-			accumDat[y*accum.cols+(int)x]+=1.0;
+			b.y0=bandStart(stripe);
+			b.data=(typename ACCUM::pixel_t *)bandStorage[stripe].data;
+		}
+		return b;
+	}
+
+	virtual void operator()(const cv::Range &range) const {
+		for (int stripe=range.start;stripe<range.end;stripe++) {
+			accumBand<ACCUM> b=band(stripe);
+			for (int y=stripeStart(stripe);y<stripeStart(stripe+1);y++)
+			{
+				int i=y*accum.cols;
+				voteRow(b,accum.size(),y,gradXF+i,gradYF+i,
+					minDiffSq,gradientVotePixels,useSIMD);
+			}
 		}
 	}
+};
+
+
+/* To break ties, I'm putting a slight tilt along both axes:
+     a neighbor at offset (dx,dy) beats us if cur < her + dx/1057 + dy/8197.
+   Multiplying through by 1057*8197 makes that tilt exact and relative to
+   the image origin, so the test becomes tiltedVote(us) < tiltedVote(her).
+   Every tilted vote is an integer below 2^53 (for up to 10^9 votes per pixel,
+   which even 32-bit accumulators never see), so a double holds it exactly. */
+inline double tiltedVote(int votes,int x,int y) {
+	return votes*(1057.0*8197.0)+x*8197.0+y*1057.0;
+}
+
+/* Fill tilted with the tiltedVote of every accumulator pixel. */
+static void tiltedVotes(const cv::Mat &accum,cv::Mat &tilted)
+{
+	tilted.create(accum.rows,accum.cols,CV_64F);
+	for (int y=0;y<accum.rows;y++) {
+		const accum_t *src=(const accum_t *)accum.ptr(y);
+		double *dest=(double *)tilted.ptr(y);
+		for (int x=0;x<accum.cols;x++) dest[x]=tiltedVote(src[x],x,y);
+	}
+}
+
+/* Running maximum over every run of w values spaced stride apart
+   (van Herk/Gil-Werman): out[i*stride]=max(in[i*stride] .. in[(i+w-1)*stride])
+   for 0<=i<=n-w.  Prefix and suffix maxima within blocks of w values
+   make this cost 3 compares per value, no matter how big w is.
+   g and h are scratch space, laid out like in. */
+static void runningMax(const double *in,int n,int stride,int w,
+	double *out,double *g,double *h)
+{
+	for (int b=0;b<n;b+=w) { 
+		int e=std::min(n,b+w); // block is b..e-1
+		g[b*stride]=in[b*stride];
+		for (int i=b+1;i<e;i++) g[i*stride]=std::max(g[(i-1)*stride],in[i*stride]);
+		h[(e-1)*stride]=in[(e-1)*stride];
+		for (int i=e-2;i>=b;i--) h[i*stride]=std::max(h[(i+1)*stride],in[i*stride]);
+	}
+	for (int i=0;i+w<=n;i++) 
+		out[i*stride]=std::max(h[i*stride],g[(i+w-1)*stride]);
+}
+
+/* Find the maximum of every w x w window of this CV_64F image:
+     windowMax(y,x)=max of src rows y..y+w-1, columns x..x+w-1.
+   This is a separable dilation, so the cost doesn't depend on w. */
+static void neighborhoodMax(const cv::Mat &src,int w,cv::Mat &windowMax,
+	cv::Mat &colMax,cv::Mat &g,cv::Mat &h)
+{
+	colMax.create(src.rows-w+1,src.cols,CV_64F);
+	g.create(src.rows,src.cols,CV_64F);
+	h.create(src.rows,src.cols,CV_64F);
+	int colStride=src.step[0]/sizeof(double); // all our images are continuous
+	for (int x=0;x<src.cols;x++) // columns first, so rows can be reused below
+		runningMax((const double *)src.data+x,src.rows,colStride,w,
+			(double *)colMax.data+x,(double *)g.data+x,(double *)h.data+x);
+	
+	windowMax.create(src.rows-w+1,src.cols-w+1,CV_64F);
+	for (int y=0;y<colMax.rows;y++)
+		runningMax((const double *)colMax.ptr(y),src.cols,1,w,
+			(double *)windowMax.ptr(y),(double *)g.ptr(0),(double *)h.ptr(0));
+}
+
+
+/* Return the seconds since an arbitrary start time. */
+static double bullseyeSeconds(void) {
+	return cv::getTickCount()/cv::getTickFrequency();
 }
 
 
@@ -63,18 +348,55 @@ bullseyeList findBullseyes(const cv::Mat &grayImage, // source grayscale image,
 	int minimumEyeDistance // minimum distance between distinct bullseyes
 	)
 {
-	bullseyeList bulls;
+	bullseyeDetector detector(minimumGradientMagnitude,minimumVotesPerEye,
+		gradientVotePixels,minimumEyeDistance);
+	return detector.find(grayImage);
+}
+
+
+bullseyeDetector::bullseyeDetector(double minimumGradientMagnitude_,
+	double minimumVotesPerEye_,
+	double gradientVotePixels_,
+	int minimumEyeDistance_)
+	:minimumGradientMagnitude(minimumGradientMagnitude_),
+	 minimumVotesPerEye(minimumVotesPerEye_),
+	 gradientVotePixels(gradientVotePixels_),
+	 minimumEyeDistance(minimumEyeDistance_),
+	 allocationCount(0)
+{}
+
+cv::Rect bullseyeWindow(double x,double y,int size,const cv::Size &imageSize)
+{
+	if (size>imageSize.width || size>imageSize.height) return cv::Rect();
+	int left=(int)floor(x-0.5*size+0.5), top=(int)floor(y-0.5*size+0.5);
+	left=std::max(0,std::min(imageSize.width-size,left));
+	top=std::max(0,std::min(imageSize.height-size,top));
+	return cv::Rect(left,top,size,size);
+}
+
+void bullseyeDetector::reuse(cv::Mat &m,int rows,int cols,int type)
+{
+	if (m.empty() || m.rows!=rows || m.cols!=cols || m.type()!=type)
+		allocationCount++;
+	m.create(rows,cols,type);
+}
+
+const bullseyeList &bullseyeDetector::find(const cv::Mat &grayImage)
+{
+	double start=bullseyeSeconds();
+	size_t eyeCapacity=bulls.eyes.capacity();
+	bulls.eyes.clear();
 	
 	// Accumulator for gradient power.  
 	//  CV_8U doesn't have enough bits for typical vote counts.
-	cv::Mat accum=cv::Mat::zeros(grayImage.rows,grayImage.cols,CV_16U);
+	reuse(accum,grayImage.rows,grayImage.cols,bullseyeVotes::cvType);
+	accum.setTo(cv::Scalar(0));
 	
 /* Convert steep gradients to lines */
 	// Gradient estimate (with filtering)
 	int ksize=3; // pixel count for gradient filter+blur
 	// 22fps, 98% of CPU with float gradients:
 	const int grad_typecode=CV_32F;
-	typedef float grad_t;
 	
 	/* 
 	// 23fps, 98% of CPU with unsigned short gradients: 
@@ -82,38 +404,62 @@ bullseyeList findBullseyes(const cv::Mat &grayImage, // source grayscale image,
 	typedef signed short grad_t;
 	*/
 	
-	cv::Mat gradX,gradY;
+	reuse(gradX,grayImage.rows,grayImage.cols,grad_typecode);
+	reuse(gradY,grayImage.rows,grayImage.cols,grad_typecode);
 	cv::Sobel(grayImage,gradX,grad_typecode, 1,0, ksize);
 	cv::Sobel(grayImage,gradY,grad_typecode, 0,1, ksize);
+	double sobelDone=bullseyeSeconds();
 	
 	grad_t *gradXF=(grad_t *)gradX.data;
 	grad_t *gradYF=(grad_t *)gradY.data;
 	float minDiffSq=minimumGradientMagnitude*minimumGradientMagnitude;
-	for (int y=0;y<grayImage.rows;y++)
-	for (int x=0;x<grayImage.cols;x++)
-	{
-		int i=y*grayImage.cols+x;
-		float dx=gradXF[i], dy=gradYF[i];
-		float magSq=dx*dx+dy*dy; // squared magnitude of gradient vector
-		if (magSq>minDiffSq)  
-		{
-			float mag=sqrt(magSq); // now a length
-			float s=gradientVotePixels/mag; // scale factor from gradient to line length
-			accumulateLine(accum,
-				cv::Point(x+dx*s,y+dy*s),
-				cv::Point(x-dx*s,y-dy*s));
-			
-			/* // cv::line doesn't support alpha blending (WHY NOT?!)
-			cv::line(annot,
-				cv::Point(x+dx*s,y+dy*s),
-				cv::Point(x-dx*s,y-dy*s),
-				cv::Scalar(255,0,0,10),0.1,CV_AA);
-			*/
+	
+	// One stripe per thread, but keep stripes much taller than the vote lines,
+	//  or we spend all our time merging the overlapping bands.
+	int margin=(int)ceil(gradientVotePixels)+2; // rows a vote line can reach outside its stripe
+	int nStripes=std::min(cv::getNumThreads(),grayImage.rows/(4*margin));
+	if (nStripes<1) nStripes=1;
+	
+	if ((int)bandStorage.size()<nStripes) {
+		allocationCount++;
+		bandStorage.resize(nStripes);
+	}
+	bullseyeVoteStripes<bullseyeVotes> voter(accum,bandStorage,nStripes,margin,gradXF,gradYF,
+		minDiffSq,gradientVotePixels,cv::useOptimized());
+	if (nStripes>1) {
+		for (int stripe=0;stripe<nStripes;stripe++) {
+			reuse(bandStorage[stripe],voter.bandRows(stripe),accum.cols,bullseyeVotes::cvType);
+			bandStorage[stripe].setTo(cv::Scalar(0));
 		}
 	}
 	
+	cv::parallel_for_(cv::Range(0,nStripes),voter);
+	
+	if (nStripes>1) 
+	{ /* Merge each thread's band into the output */
+		for (int stripe=0;stripe<nStripes;stripe++) {
+			const cv::Mat &band=bandStorage[stripe];
+			for (int r=0;r<band.rows;r++)
+				bullseyeVotes::merge((accum_t *)accum.ptr(voter.bandStart(stripe)+r),
+					(const accum_t *)band.ptr(r),accum.cols);
+		}
+	}
+	
+	double voteDone=bullseyeSeconds();
+	
 // Circle areas where there's a high gradient *and* a local maximum.
 	int de=minimumEyeDistance; // must be maximum among neighborhood of this many pixels (==min distance between eyes)
+	// windowMax(y-de,x-de) is the biggest tilted vote in (x,y)'s neighborhood
+	bool checkNeighbors=(de>0 && accum.rows>=2*de && accum.cols>=2*de);
+	if (checkNeighbors) {
+		reuse(tilted,accum.rows,accum.cols,CV_64F);
+		reuse(scratchG,accum.rows,accum.cols,CV_64F);
+		reuse(scratchH,accum.rows,accum.cols,CV_64F);
+		reuse(colMax,accum.rows-2*de+1,accum.cols,CV_64F);
+		reuse(windowMax,accum.rows-2*de+1,accum.cols-2*de+1,CV_64F);
+		tiltedVotes(accum,tilted);
+		neighborhoodMax(tilted,2*de,windowMax,colMax,scratchG,scratchH);
+	}
 	for (int y=de;y<accum.rows-de;y++)
 	for (int x=de;x<accum.cols-de;x++)
 	{
@@ -121,18 +467,8 @@ bullseyeList findBullseyes(const cv::Mat &grayImage, // source grayscale image,
 		if (cur>=minimumVotesPerEye) 
 		{ /* it's big--but is there a bigger one nearby? */
 			bool biggest=true;
-			for (int dy=-de;dy<de && biggest;dy++)
-			for (int dx=-de;dx<de;dx++)
-			{
-				float her=fetchAccum(accum,x+dx,y+dy);
-				/* To break ties, I'm putting a slight tilt along both axes. */
-				her+=dx*(1.0/1057)+dy*(1.0/8197);
-				
-				if (cur<her) {
-					biggest=false;
-					break;
-				}
-			}
+			if (checkNeighbors)
+				biggest=tiltedVote(cur,x,y)>=windowMax.at<double>(y-de,x-de);
 			
 			if (biggest) 
 			{ /* This is a bullseye! */
@@ -155,7 +491,96 @@ bullseyeList findBullseyes(const cv::Mat &grayImage, // source grayscale image,
 	
 	// Sort by ascending size
 	std::sort(bulls.eyes.begin(),bulls.eyes.end());
+	if (bulls.eyes.capacity()!=eyeCapacity) allocationCount++;
+	
+	lastTiming.sobelSeconds=sobelDone-start;
+	lastTiming.voteSeconds=voteDone-sobelDone;
+	lastTiming.peakSeconds=bullseyeSeconds()-voteDone;
 	return bulls;
 }
 
 
+
+/**
+  Coarse-to-fine version of findBullseyes.
+*/
+bullseyeList findBullseyesPyramid(const cv::Mat &grayImage,
+	int pyramidLevels,
+	double minimumGradientMagnitude,
+	double minimumVotesPerEye,
+	double gradientVotePixels,
+	int minimumEyeDistance,
+	bullseyePyramidStats *stats)
+{
+	double start=bullseyeSeconds();
+	
+// Shrink the image, and scale every length (and vote count, which is
+//   proportional to an eye's perimeter) down to match.
+	cv::Mat coarse=grayImage;
+	for (int level=0;level<pyramidLevels;level++) {
+		cv::Mat smaller;
+		cv::pyrDown(coarse,smaller);
+		coarse=smaller;
+	}
+	int scale=1<<pyramidLevels; // full-resolution pixels per coarse pixel
+	bullseyeList candidates=findBullseyes(coarse,
+		minimumGradientMagnitude,
+		minimumVotesPerEye/scale,
+		gradientVotePixels/scale,
+		std::max(1,minimumEyeDistance/scale));
+	
+	double coarseDone=bullseyeSeconds();
+	
+// Polish each candidate at full resolution.  The window must hold the
+//   whole eye plus its vote lines, our coarse position error, and the
+//   neighborhood checked for the local maximum.
+	bullseyeList bulls;
+	bullseyeDetector fineDetector(minimumGradientMagnitude,minimumVotesPerEye,
+		gradientVotePixels,minimumEyeDistance);
+	int windowRadius=(int)ceil(2*gradientVotePixels)+scale+minimumEyeDistance;
+	cv::Rect imageRect(0,0,grayImage.cols,grayImage.rows);
+	for (unsigned int c=0;c<candidates.eyes.size();c++) {
+		const bullseyeInfo &coarseEye=candidates.eyes[c];
+		double fx=coarseEye.x*scale, fy=coarseEye.y*scale; // full-res estimate
+		
+		cv::Rect window((int)fx-windowRadius,(int)fy-windowRadius,
+			2*windowRadius+1,2*windowRadius+1);
+		window&=imageRect;
+		const bullseyeList &fine=fineDetector.find(grayImage(window));
+		
+		// Our refined candidate is the window's eye nearest the coarse
+		//  position--the window can also hold a stronger neighbor, which
+		//  has its own candidate.  If no full resolution eye is close, 
+		//  the coarse candidate was a false positive.
+		double wx=fx-window.x, wy=fy-window.y; // coarse estimate, in the window
+		double maxOffset=scale+minimumEyeDistance;
+		int nearest=-1;
+		double nearestDist2=maxOffset*maxOffset;
+		for (unsigned int f=0;f<fine.eyes.size();f++) {
+			double dx=fine.eyes[f].x-wx, dy=fine.eyes[f].y-wy;
+			double dist2=dx*dx+dy*dy;
+			if (dist2<=nearestDist2) { nearest=f; nearestDist2=dist2; }
+		}
+		if (nearest<0) continue;
+		
+		bullseyeInfo eye=fine.eyes[nearest];
+		eye.x+=window.x; eye.y+=window.y;
+		
+		// Skip eyes that an earlier (higher-voted) window already found
+		bool duplicate=false;
+		for (unsigned int e=0;e<bulls.eyes.size() && !duplicate;e++)
+			duplicate=fabs(bulls.eyes[e].x-eye.x)<minimumEyeDistance 
+			       && fabs(bulls.eyes[e].y-eye.y)<minimumEyeDistance;
+		if (!duplicate) bulls.eyes.push_back(eye);
+	}
+	
+	// Sort by ascending size
+	std::sort(bulls.eyes.begin(),bulls.eyes.end());
+	
+	if (stats) {
+		stats->coarseSeconds=coarseDone-start;
+		stats->refineSeconds=bullseyeSeconds()-coarseDone;
+		stats->coarseCandidates=candidates.eyes.size();
+	}
+	return bulls;
+}
@@ -34,6 +34,11 @@ public:
 
 /**
   Find a list of bullseyes in this grayscale (single channel) source image.
+  
+  Gradient voting is split across cv::getNumThreads() threads, and the
+  gradient threshold uses SSE/AVX where the compiler allows it; call
+  cv::setUseOptimized(false) to force the plain scalar loop.
+  The output is identical regardless of thread count or instruction set.
 */
 bullseyeList findBullseyes(const cv::Mat &grayImage, // source grayscale image, use cv::cvtColor(colorImg,grayImg,CV_BGR2GRAY);
 	double minimumGradientMagnitude=60, // gradient steepness required to draw line (low values slower but can detect weaker)
@@ -43,5 +48,101 @@ bullseyeList findBullseyes(const cv::Mat &grayImage, // source grayscale image,
 	);
 
 
+/**
+  Seconds spent in each stage of the last bullseyeDetector::find call.
+*/
+class bullseyeTiming {
+public:
+	double sobelSeconds; ///< Gradient estimation
+	double voteSeconds; ///< Drawing vote lines (and merging thread bands)
+	double peakSeconds; ///< Non-maximum suppression and peak polishing
+	
+	bullseyeTiming() :sobelSeconds(0.0), voteSeconds(0.0), peakSeconds(0.0) {}
+};
+
+/**
+  Finds bullseyes exactly like findBullseyes, but keeps its accumulator,
+  gradient, and peak-finding images between calls.  Keep one of these per
+  video stream: once it has seen a frame, later frames of the same size
+  need no new buffers.
+*/
+class bullseyeDetector {
+public:
+	double minimumGradientMagnitude; ///< gradient steepness required to draw line
+	double minimumVotesPerEye; ///< minimum vote count to be an eye
+	double gradientVotePixels; ///< number of pixels to extend gradient
+	int minimumEyeDistance; ///< minimum distance between distinct bullseyes
+
+	bullseyeDetector(double minimumGradientMagnitude_=60,
+		double minimumVotesPerEye_=80,
+		double gradientVotePixels_=20,
+		int minimumEyeDistance_=10);
+
+	/**
+	  Find bullseyes in this grayscale image.  The returned list is ours,
+	  and gets overwritten by the next call.
+	*/
+	const bullseyeList &find(const cv::Mat &grayImage);
+
+	/**
+	  Number of times we had to allocate or grow one of our buffers.
+	  This stops climbing after the first frame of a given size.
+	  (OpenCV's own temporaries inside cv::Sobel aren't counted.)
+	*/
+	unsigned long allocations() const { return allocationCount; }
+
+	/// Time taken by each stage of the last find call.
+	const bullseyeTiming &timing() const { return lastTiming; }
+
+private:
+	cv::Mat accum; ///< Vote accumulator (CV_16U, or CV_32S if built with -DBULLSEYE_VOTE_BITS=32)
+	cv::Mat gradX, gradY; ///< Sobel gradients
+	std::vector<cv::Mat> bandStorage; ///< Per-thread vote bands
+	cv::Mat tilted, colMax, windowMax, scratchG, scratchH; ///< Peak finding
+	bullseyeList bulls; ///< Our last result
+	unsigned long allocationCount;
+	bullseyeTiming lastTiming;
+
+	/// Make m this size and type, counting any new allocation.
+	void reuse(cv::Mat &m,int rows,int cols,int type);
+};
+
+/**
+  Time spent by findBullseyesPyramid, for tuning the pyramid depth.
+*/
+class bullseyePyramidStats {
+public:
+	double coarseSeconds; ///< Downsampling plus detection at the coarse level
+	double refineSeconds; ///< Full-resolution search around each coarse candidate
+	int coarseCandidates; ///< Number of bullseyes found at the coarse level
+	
+	bullseyePyramidStats() :coarseSeconds(0.0), refineSeconds(0.0), coarseCandidates(0) {}
+};
+
+/**
+  A size x size search window centered on x,y, slid (not clipped) to fit
+  inside an image of this size, so every window has the same shape and a
+  bullseyeDetector searching them never needs new buffers.
+  Returns an empty rectangle if the image is smaller than the window.
+*/
+cv::Rect bullseyeWindow(double x,double y,int size,const cv::Size &imageSize);
+
+/**
+  Coarse-to-fine version of findBullseyes: detects on an image downsampled
+  pyramidLevels times by 2x, then re-runs findBullseyes at full resolution
+  only in a small window around each coarse candidate.
+  gradientVotePixels is still in full-resolution pixels, so big eyes cost
+  about the same as small ones at the coarse level.
+*/
+bullseyeList findBullseyesPyramid(const cv::Mat &grayImage, // source grayscale image
+	int pyramidLevels=1, // number of 2x downsamplings before the coarse search
+	double minimumGradientMagnitude=60, // gradient steepness required to draw line
+	double minimumVotesPerEye=80, // minimum full-resolution vote count to be an eye
+	double gradientVotePixels=20, // full-resolution pixels to extend gradient
+	int minimumEyeDistance=10, // minimum full-resolution distance between distinct bullseyes
+	bullseyePyramidStats *stats=0 // if non-NULL, filled with timing for each stage
+	);
+
+
 #endif /* defined (this header) */
 
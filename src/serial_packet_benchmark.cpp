@@ -0,0 +1,358 @@
+//Serial Packet Benchmark Source
+//	Times A-packet decoding of serial captures (raw bytes as the PC saw them,
+//	for example "cat /dev/ttyACM0 > rover5.cap"): "old" is a copy of what
+//	A_packet_formatter::read_packet used to do (one byte per virtual read,
+//	realloc for every long packet, no resync), "byte" is the new formatter fed
+//	one byte at a time the same way, and "span" hands it the bytes in spans as big
+//	as msl::serial_thread's.  With no captures it makes one from rover5
+//	traffic (a motor reply and a Neato batch per request) with a noise start
+//	byte every 50 packets.  The old decoder loses the packets a noise byte's
+//	made up length swallows; the new one only loses them when the 4-bit
+//	checksum happens to pass (about 1 noise byte in 16).  "lost" counts
+//	packets of the generated capture that didn't come out intact.
+//
+//	Usage: serial_packet_benchmark [passes] [capture files...]
+
+//Cyberalaska Headers
+#include "cyberalaska/neato_serial.h"
+#include "cyberalaska/serial_packet.h"
+
+//MSL Headers
+#include <msl/serial.hpp>
+#include <msl/string_util.hpp>
+#include <msl/time_util.hpp>
+
+//STL Headers
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+//Memory Port Class (A capture played back through serial_port_abstract)
+class memory_port:public serial_port_abstract
+{
+	public:
+		memory_port(const std::vector<unsigned char>& bytes):_bytes(bytes),_index(0)
+		{}
+
+		int available()
+		{
+			return _index<_bytes.size();
+		}
+
+		int read()
+		{
+			if(_index>=_bytes.size())
+				return -1;
+
+			return _bytes[_index++];
+		}
+
+		void write(unsigned char data)
+		{}
+
+	private:
+		const std::vector<unsigned char>& _bytes;
+		unsigned int _index;
+};
+
+//Capture Port Class (Records written packets)
+class capture_port
+{
+	public:
+		void write(const unsigned char* data,int length)
+		{
+			bytes.insert(bytes.end(),data,data+length);
+		}
+
+		std::vector<unsigned char> bytes;
+};
+
+//Old Packet Reader Class (A_packet_formatter's receiver before span decoding)
+class old_packet_reader
+{
+	public:
+		old_packet_reader(serial_port_abstract& serial):_serial(serial),_state(0),_length(0),_index(0),_sumpay(0),
+			_data(NULL),_data_long(NULL)
+		{}
+
+		~old_packet_reader()
+		{
+			free(_data_long);
+		}
+
+		int read_packet(A_packet& p)
+		{
+			if(!_serial.available())
+				return 0;
+
+			int c=_serial.read();
+			p.valid=0;
+
+			switch(_state)
+			{
+				case 0:
+					if((c&0xf0)==0xa0)
+					{
+						_index=0;
+						_sumpay=0;
+						_length=c&0x0f;
+
+						if(_length>=15)
+						{
+							_state=1;
+						}
+						else if(_length>0)
+						{
+							_state=2;
+							_data=_data_short;
+						}
+						else
+						{
+							_state=3;
+						}
+					}
+					break;
+				case 1:
+					_length=c;
+					_data_long=(unsigned char*)realloc(_data_long,_length);
+					_data=_data_long;
+					_state=2;
+					break;
+				case 2:
+					_sumpay+=c;
+					_data[_index++]=c;
+
+					if(_index>=_length)
+						_state=3;
+					break;
+				default:
+					_state=0;
+					p.command=c>>4;
+
+					if((0xf&c)==(0xf&(_length+p.command+_sumpay+(_sumpay>>4))))
+					{
+						p.valid=1;
+						p.length=_length;
+						p.data=_data;
+					}
+
+					return 1;
+			}
+
+			return -1;
+		}
+
+	private:
+		serial_port_abstract& _serial;
+		int _state;
+		int _length;
+		int _index;
+		int _sumpay;
+		unsigned char _data_short[15];
+		unsigned char* _data;
+		unsigned char* _data_long;
+};
+
+//Span Size (What one msl::serial::fill can bring in)
+static const unsigned int span_size=MSL_SERIAL_RX_BUFFER;
+
+//Decode Counts Struct
+struct decode_counts
+{
+	unsigned int valid;
+	unsigned int bad;
+	unsigned int rover5;
+	unsigned int bytes;
+};
+
+//Packet Tally Function (Touches the payload so nothing gets optimized away)
+static void tally(const A_packet& p,decode_counts& counts)
+{
+	if(!p.valid)
+	{
+		++counts.bad;
+		return;
+	}
+
+	++counts.valid;
+
+	if((p.command==0x3&&p.length==2*(int)sizeof(unsigned short))||(p.command==0xD&&p.length==(int)sizeof(NeatoLDSbatch)))
+		++counts.rover5;
+
+	for(int ii=0;ii<p.length;++ii)
+		counts.bytes+=p.data[ii];
+}
+
+//Old Decode Function
+static decode_counts decode_old(const std::vector<unsigned char>& capture)
+{
+	decode_counts counts={0,0,0,0};
+	memory_port port(capture);
+	old_packet_reader reader(port);
+	A_packet p;
+	int r;
+
+	while((r=reader.read_packet(p))!=0)
+		if(r==1)
+			tally(p,counts);
+
+	return counts;
+}
+
+//Byte Decode Function
+static decode_counts decode_byte(const std::vector<unsigned char>& capture)
+{
+	decode_counts counts={0,0,0,0};
+	memory_port port(capture);
+	A_packet_formatter<serial_port_abstract> formatter(port);
+	A_packet p;
+	int r;
+
+	while((r=formatter.read_packet(p))!=0)
+		if(r==1)
+			tally(p,counts);
+
+	return counts;
+}
+
+//Span Decode Function
+static decode_counts decode_span(const std::vector<unsigned char>& capture)
+{
+	decode_counts counts={0,0,0,0};
+	memory_port port(capture);
+	A_packet_formatter<serial_port_abstract> formatter(port);
+	A_packet p;
+
+	for(unsigned int start=0;start<capture.size();start+=span_size)
+	{
+		const unsigned char* data=&capture[start];
+		const unsigned char* end=&capture[0]+std::min<unsigned int>(start+span_size,capture.size());
+
+		while(formatter.read_packet(p,data,end)==1)
+			tally(p,counts);
+	}
+
+	return counts;
+}
+
+//Time Function (Prints MB/s over all passes, returns the counts from the last)
+//	Expected is how many rover5 packets the capture holds, if we know.
+static decode_counts time_decoder(const std::string& name,decode_counts(*decoder)(const std::vector<unsigned char>&),
+	const std::vector<unsigned char>& capture,const unsigned int passes,const unsigned int expected=0)
+{
+	decode_counts counts={0,0,0,0};
+	double start=msl::millis();
+
+	for(unsigned int ii=0;ii<passes;++ii)
+		counts=decoder(capture);
+
+	double seconds=(msl::millis()-start)/1000.0;
+
+	std::cout<<"\t"<<name<<"\t"<<capture.size()*(double)passes/seconds/1000000.0<<" MB/s\t"
+		<<counts.valid<<" packets\t"<<counts.bad<<" bad";
+
+	if(expected>0)
+		std::cout<<"\t"<<expected-counts.rover5<<" lost";
+
+	std::cout<<std::endl;
+
+	return counts;
+}
+
+//Rover5 Capture Function (Motor replies and Neato batches, a noise start byte every 50 packets)
+static std::vector<unsigned char> rover5_capture(const unsigned int requests,unsigned int& expected)
+{
+	capture_port port;
+	A_packet_formatter<capture_port> formatter(port);
+	NeatoLDSbatch batch;
+	unsigned short encoders[2]={0,0};
+	expected=0;
+
+	for(unsigned int ii=0;ii<requests;++ii)
+	{
+		encoders[0]+=3;
+		encoders[1]+=5;
+		formatter.write_packet(0x3,sizeof(encoders),encoders);
+
+		batch.index=(ii*NeatoLDSbatch::size)%360;
+		batch.speed64=300*64;
+
+		for(int dir=0;dir<NeatoLDSbatch::size;++dir)
+			batch.dir[dir].distance=1000+ii+dir;
+
+		formatter.write_packet(0xD,sizeof(batch),&batch);
+		expected+=2;
+
+		if(ii%25==24)
+			port.bytes.push_back(0xAF);
+	}
+
+	return port.bytes;
+}
+
+//Main
+int main(int argc,char* argv[])
+{
+	unsigned int passes=100;
+	std::vector<std::string> files;
+
+	if(argc>1)
+		passes=msl::to_int(argv[1]);
+
+	for(int ii=2;ii<argc;++ii)
+		files.push_back(argv[ii]);
+
+	bool failed=false;
+
+	//Generated Rover5 Capture
+	if(files.size()==0)
+	{
+		unsigned int expected=0;
+		std::vector<unsigned char> capture=rover5_capture(10000,expected);
+		std::cout<<"rover5 traffic, "<<capture.size()<<" bytes, "<<expected<<" packets:"<<std::endl;
+
+		decode_counts old=time_decoder("old",decode_old,capture,passes,expected);
+		decode_counts byte=time_decoder("byte",decode_byte,capture,passes,expected);
+		decode_counts span=time_decoder("span",decode_span,capture,passes,expected);
+
+		if(byte.bytes!=span.bytes||span.rover5<old.rover5)
+		{
+			std::cout<<"FAIL: resync lost packets"<<std::endl;
+			failed=true;
+		}
+	}
+
+	//Recorded Captures
+	for(unsigned int ii=0;ii<files.size();++ii)
+	{
+		std::ifstream istr(files[ii].c_str(),std::ios_base::in|std::ios_base::binary);
+		std::vector<unsigned char> capture((std::istreambuf_iterator<char>(istr)),std::istreambuf_iterator<char>());
+
+		if(!istr&&!istr.eof())
+		{
+			std::cout<<"FAIL: can't read "<<files[ii]<<std::endl;
+			failed=true;
+			continue;
+		}
+
+		std::cout<<files[ii]<<", "<<capture.size()<<" bytes:"<<std::endl;
+
+		if(capture.size()==0)
+			continue;
+
+		time_decoder("old",decode_old,capture,passes);
+		decode_counts byte=time_decoder("byte",decode_byte,capture,passes);
+		decode_counts span=time_decoder("span",decode_span,capture,passes);
+
+		if(byte.valid!=span.valid||byte.bytes!=span.bytes)
+		{
+			std::cout<<"FAIL: byte and span decoding disagree"<<std::endl;
+			failed=true;
+		}
+	}
+
+	return failed?1:0;
+}
@@ -0,0 +1,129 @@
+//Socket Benchmark Source
+//	Counts socket system calls per simulated ardrone control tick: three
+//	connection checks (control, navdata, video) and one command datagram,
+//	all over loopback UDP so no drone is needed.  "before" checks with a copy
+//	of what good() used to do every call, "after" with good().
+//
+//	Usage: socket_benchmark [ticks] [port]
+
+//MSL Headers
+#include <msl/socket.hpp>
+#include <msl/string_util.hpp>
+#include <msl/time_util.hpp>
+
+//STL Headers
+#include <iostream>
+#include <string>
+
+//Tick Statistics
+struct tick_stats_t
+{
+	double syscalls_per_tick;
+	double microseconds_per_tick;
+};
+
+//Old Good Function (msl::socket::good() before it tracked state: two selects and maybe a peek)
+static bool old_good(const msl::socket& socket)
+{
+	SOCKET fd=socket.system_socket();
+
+	if(fd==static_cast<unsigned int>(SOCKET_ERROR)||fd==static_cast<unsigned int>(INVALID_SOCKET))
+		return false;
+
+	char temp;
+
+	if(socket_available(fd)>0&&socket_peek(fd,&temp,1)==0)
+		return false;
+
+	return (socket_available(fd)>=0);
+}
+
+//Run Ticks (check all three sockets, then send one command, like ardrone::manuever)
+static tick_stats_t run_ticks(msl::socket sockets[3],msl::socket& drain,const unsigned int ticks,const bool old)
+{
+	const std::string command="AT*PCMD=1,1,0,0,0,0\r";
+	char buffer[64];
+	unsigned long start_syscalls=socket_syscall_count();
+	double start_time=msl::millis();
+	unsigned long counted_syscalls=0;
+
+	for(unsigned int tick=0;tick<ticks;++tick)
+	{
+		bool good=true;
+
+		for(int ii=0;ii<3;++ii)
+		{
+			if(old)
+				good=old_good(sockets[ii])&&good;
+			else
+				good=sockets[ii].good()&&good;
+		}
+
+		if(good)
+			sockets[0].write(command);
+
+		//Keep the receive buffer empty, without counting the drain itself.
+		unsigned long before_drain=socket_syscall_count();
+
+		while(drain.available()>0)
+			drain.read(buffer,sizeof(buffer));
+
+		counted_syscalls+=before_drain-start_syscalls;
+		start_syscalls=socket_syscall_count();
+	}
+
+	tick_stats_t stats;
+	stats.syscalls_per_tick=counted_syscalls/static_cast<double>(ticks);
+	stats.microseconds_per_tick=(msl::millis()-start_time)*1000.0/ticks;
+	return stats;
+}
+
+//Main
+int main(int argc,char* argv[])
+{
+	unsigned int ticks=100000;
+	std::string port="18556";
+
+	if(argc>1)
+		ticks=msl::to_int(argv[1]);
+
+	if(argc>2)
+		port=argv[2];
+
+	if(ticks==0)
+	{
+		std::cout<<"Usage: "<<argv[0]<<" [ticks] [port]"<<std::endl;
+		return 2;
+	}
+
+	//Local "drone" and three connections to it.
+	msl::socket drone("127.0.0.1:"+port);
+	drone.create_udp(65536);
+
+	msl::socket sockets[3]={msl::socket("127.0.0.1:"+port),msl::socket("127.0.0.1:"+port),msl::socket("127.0.0.1:"+port)};
+
+	for(int ii=0;ii<3;++ii)
+		sockets[ii].connect_udp();
+
+	if(!drone.good()||!sockets[0].good()||!sockets[1].good()||!sockets[2].good())
+	{
+		std::cout<<"Could not open loopback sockets on port "<<port<<"!"<<std::endl;
+		return 2;
+	}
+
+	tick_stats_t before=run_ticks(sockets,drone,ticks,true);
+	tick_stats_t after=run_ticks(sockets,drone,ticks,false);
+
+	std::cout<<"Ticks: "<<ticks<<std::endl;
+	std::cout<<"before (old good):\t"<<before.syscalls_per_tick<<" syscalls/tick\t"
+		<<before.microseconds_per_tick<<" us/tick"<<std::endl;
+	std::cout<<"after (good):\t\t"<<after.syscalls_per_tick<<" syscalls/tick\t"
+		<<after.microseconds_per_tick<<" us/tick"<<std::endl;
+
+	drone.close();
+
+	for(int ii=0;ii<3;++ii)
+		sockets[ii].close();
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+//UAV Binary Benchmark Source
+//	Times UAV client/server exchanges over loopback: "json" is what
+//	uav_client does by default (a new HTTP connection per exchange, field
+//	JSON in the URL, sensor JSON back), "binary" is one persistent
+//	connection carrying uav_control_binary frames.  Both servers run in
+//	threads of this process and answer every field with the same sensors.
+//	Reports wall time and process CPU time (client plus server) per exchange.
+//
+//	Usage: uav_binary_benchmark [exchanges] [obstacles and hikers]
+
+//Cyberalaska Headers
+#include "cyberalaska/porthread.h"
+#include "cyberalaska/uav_control_binary.h"
+#include "cyberalaska/uav_control_JSON.h"
+
+//MSL Headers
+#include <msl/socket_util.hpp>
+#include <msl/string_util.hpp>
+#include <msl/time_util.hpp>
+
+//OSL Headers
+#include "osl/webserver.h"
+
+//STL Headers
+#include <ctime>
+#include <iostream>
+#include <string>
+
+//Benchmark Ports
+static unsigned int json_port=8090;
+static unsigned int binary_port=8091;
+
+//Exchange Count (Both servers quit after this many exchanges)
+static unsigned int exchanges=10000;
+
+//Server Sensors (What both servers answer with)
+static AK_uav_control_sensors server_sensors;
+
+//Field Count (Fields the servers have decoded, to make sure nothing was skipped)
+static unsigned int fields_received=0;
+
+//URL Escape Function (Same escaping as uav_client.cpp)
+static std::string url_escape(const std::string& src)
+{
+	std::string dest;
+	char buffer[4];
+
+	for(unsigned int ii=0;ii<src.size();++ii)
+	{
+		unsigned char c=src[ii];
+
+		if(isalpha(c)||isdigit(c))
+		{
+			dest+=c;
+		}
+		else
+		{
+			snprintf(buffer,sizeof(buffer),"%%%02X",(int)c);
+			dest+=buffer;
+		}
+	}
+
+	return dest;
+}
+
+//JSON Server Thread Function (One HTTP request per exchange, like the field server)
+static void json_server(void* arg)
+{
+	osl::http_server* server=(osl::http_server*)arg;
+	std::string prefix="/uav/0/pilot?cmd=";
+
+	for(unsigned int ii=0;ii<exchanges;++ii)
+	{
+		osl::http_served_client client=server->serve();
+		std::string path=client.get_path();
+
+		if(path.compare(0,prefix.size(),prefix)==0)
+		{
+			AK_uav_field field=AK_uav_field_from_JSON(msl::http_to_ascii(path.substr(prefix.size())));
+			fields_received+=(field.state=="mission");
+		}
+
+		client.send("application/json",JSON_from_AK_uav_control_sensors(server_sensors));
+	}
+}
+
+//Binary Server Thread Function (One persistent connection)
+static void binary_server(void* arg)
+{
+	SERVER_SOCKET server=*(SERVER_SOCKET*)arg;
+	AK_uav_binary_connection connection(skt_accept(server,NULL,NULL));
+	AK_uav_field field;
+
+	for(unsigned int ii=0;ii<exchanges;++ii)
+	{
+		connection.receive(field);
+		fields_received+=(field.state=="mission");
+		connection.send(server_sensors);
+	}
+}
+
+//Print Function (Times are for all exchanges)
+static void print_rate(const std::string& name,const double milliseconds,const double cpu_seconds)
+{
+	std::cout<<"\t"<<name<<"\t"<<milliseconds*1000.0/exchanges<<" us/exchange\t"
+		<<cpu_seconds*1000000.0/exchanges<<" us CPU/exchange"<<std::endl;
+}
+
+//Main
+int main(int argc,char* argv[])
+{
+	unsigned int points=10;
+
+	if(argc>1)
+		exchanges=msl::to_int(argv[1]);
+	if(argc>2)
+		points=msl::to_int(argv[2]);
+
+	skt_init();
+
+	//Typical Mid-Mission Field and Sensors
+	AK_uav_field field;
+	field.state="mission";
+	field.uav=vec2(2.5,3.25);
+
+	for(unsigned int ii=0;ii<points;++ii)
+	{
+		field.obstacles.push_back(vec2(0.5*ii,1.0+0.25*ii));
+		field.hikers.push_back(vec2(0.1*ii,4.0-0.5*ii));
+	}
+
+	server_sensors.state="mission";
+	server_sensors.x=2.4;
+	server_sensors.y=3.3;
+
+	for(int dir=0;dir<n_directions;++dir)
+	{
+		server_sensors.obstacle[dir]=0.5+dir;
+		server_sensors.hiker[dir]=1000.0;
+	}
+
+	AK_uav_control_sensors sensors;
+	std::cout<<exchanges<<" exchanges, "<<points<<" obstacles and hikers:"<<std::endl;
+
+	//JSON over HTTP
+	{
+		osl::http_server server(json_port);
+		porthread_t thread=porthread_create(json_server,&server);
+		osl::network_progress progress;
+		AK_uav_field_JSON_writer writer;
+		fields_received=0;
+
+		double start=msl::millis();
+		clock_t cpu_start=clock();
+
+		for(unsigned int ii=0;ii<exchanges;++ii)
+		{
+			osl::http_connection net("localhost",progress,json_port);
+			net.send_get("/uav/0/pilot?cmd="+url_escape(writer.write(field)));
+			sensors=AK_uav_control_sensors_from_JSON(net.receive());
+		}
+
+		print_rate("json",msl::millis()-start,(clock()-cpu_start)/(double)CLOCKS_PER_SEC);
+		porthread_wait(thread);
+
+		if(fields_received!=exchanges||sensors.obstacle[E]!=server_sensors.obstacle[E])
+		{
+			std::cout<<"FAIL: json exchange lost data"<<std::endl;
+			return 1;
+		}
+	}
+
+	//Binary Frames
+	{
+		SERVER_SOCKET server=skt_server(&binary_port);
+		porthread_t thread=porthread_create(binary_server,&server);
+		AK_uav_binary_client client("localhost",binary_port);
+		fields_received=0;
+
+		double start=msl::millis();
+		clock_t cpu_start=clock();
+
+		for(unsigned int ii=0;ii<exchanges;++ii)
+			client.exchange(field,sensors);
+
+		print_rate("binary",msl::millis()-start,(clock()-cpu_start)/(double)CLOCKS_PER_SEC);
+		porthread_wait(thread);
+		skt_close(server);
+
+		if(fields_received!=exchanges||sensors.obstacle[E]!=server_sensors.obstacle[E]||sensors.state!="mission")
+		{
+			std::cout<<"FAIL: binary exchange lost data"<<std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}